@@ -741,6 +741,45 @@ colorcomplement(
     }
 }
 
+/*
+ - singlechrs - record the one chr of each color that has exactly one
+ * Walks the non-fill, non-solid parts of the tree; map[co] is set for every
+ * real color with a single member and left alone for all others.
+ ^ static void singlechrs(struct colormap *, union tree *, int, uchr, chr *);
+ */
+static void
+singlechrs(
+    struct colormap *cm,
+    union tree *tree,
+    int level,			/* level number (top == 0) of this block */
+    uchr base,			/* chr bits selected by the levels above */
+    chr *map)			/* one entry per color */
+{
+    int i;
+    union tree *t;
+    struct colordesc *cd;
+
+    if (level == NBYTS-1) {
+	for (i=0 ; i<BYTTAB ; i++) {
+	    cd = &cm->cd[tree->tcolor[i]];
+	    if (cd->nchrs == 1 && !(cd->flags&PSEUDO)) {
+		map[tree->tcolor[i]] = (chr) ((base << BYTBITS) | i);
+	    }
+	}
+	return;
+    }
+    for (i=0 ; i<BYTTAB ; i++) {
+	t = tree->tptr[i];
+	if (t == &cm->tree[level+1]) {
+	    continue;		/* fill block, all WHITE */
+	}
+	if (level == NBYTS-2 && cm->cd[t->tcolor[0]].block == t) {
+	    continue;		/* solid block, BYTTAB chrs of one color */
+	}
+	singlechrs(cm, t, level+1, (base << BYTBITS) | i, map);
+    }
+}
+
 #ifdef REG_DEBUG
 /*
  ^ #ifdef REG_DEBUG
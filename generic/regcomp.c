@@ -42,6 +42,7 @@ int compile(regex_t *, const chr *, size_t, int);
 static void moresubs(struct vars *, size_t);
 static int freev(struct vars *, int);
 static void makesearch(struct vars *, struct nfa *);
+static void makeprefix(struct vars *, struct guts *);
 static struct subre *parse(struct vars *, int, int, struct state *, struct state *);
 static struct subre *parsebranch(struct vars *, int, int, struct state *, struct state *, int);
 static void parseqatom(struct vars *, int, int, struct state *, struct state *, struct subre *);
@@ -101,6 +102,7 @@ static void colorchain(struct colormap *, struct arc *);
 static void uncolorchain(struct colormap *, struct arc *);
 static void rainbow(struct nfa *, struct colormap *, int, pcolor, struct state *, struct state *);
 static void colorcomplement(struct nfa *, struct colormap *, int, struct state *, struct state *, struct state *);
+static void singlechrs(struct colormap *, union tree *, int, uchr, chr *);
 #ifdef REG_DEBUG
 static void dumpcolors(struct colormap *, FILE *);
 static void fillcheck(struct colormap *, union tree *, int, FILE *);
@@ -355,6 +357,9 @@ compile(
     v->cm = &g->cmap;
     g->lacons = NULL;
     g->nlacons = 0;
+    g->prefix = NULL;
+    g->nprefix = 0;
+    g->prefixskip = NULL;
     ZAPCNFA(g->search);
     v->nfa = newnfa(v, v->cm, NULL);
     CNOERR();
@@ -437,6 +442,7 @@ compile(
     CNOERR();
     compact(v->nfa, &g->search);
     CNOERR();
+    makeprefix(v, g);
 
     /*
      * Looks okay, package it up.
@@ -638,6 +644,106 @@ makesearch(
     }
 }
 
+/*
+ - makeprefix - find the literal string that every match must begin with
+ * The walk starts from the state the whole-RE NFA enters on leaving its
+ * pre state and stops at the first state that has anything other than one
+ * plain arc whose color stands for exactly one chr. exec() uses the result
+ * to skip to candidate starting points before running any DFA. It is purely
+ * an optimization, so running out of memory just leaves it unset.
+ ^ static void makeprefix(struct vars *, struct guts *);
+ */
+#define	MAXPREFIX	255	/* so that shifts fit in an unsigned char */
+#define	NOCHR		((chr) (CHR_MAX + 1))
+
+static void
+makeprefix(
+    struct vars *v,
+    struct guts *g)
+{
+    struct cnfa *cnfa = &v->tree->cnfa;
+    struct carc *ca;
+    color cols[MAXPREFIX];
+    color co;
+    chr *map;
+    size_t st, next, n, i;
+
+    if (NULLCNFA(*cnfa) || (v->cflags&REG_EXPECT)) {
+	return;			/* partial-match info needs a full scan */
+    }
+
+    /*
+     * Whatever precedes the match must lead to the same state.
+     */
+
+    next = cnfa->nstates;
+    for (ca = cnfa->states[cnfa->pre]; ca->co != COLORLESS; ca++) {
+	if (ca->co >= cnfa->ncolors ||
+		(next != cnfa->nstates && ca->to != next)) {
+	    return;
+	}
+	next = ca->to;
+    }
+
+    n = 0;
+    while (next != cnfa->nstates && n < MAXPREFIX) {
+	st = next;
+	next = cnfa->nstates;
+	co = COLORLESS;
+	for (ca = cnfa->states[st]; ca->co != COLORLESS; ca++) {
+	    if (ca->co == cnfa->bos[0] || ca->co == cnfa->bos[1]) {
+		continue;	/* can only happen at the very start */
+	    }
+	    if (co != COLORLESS || ca->co >= cnfa->ncolors || ca->to == st) {
+		co = COLORLESS;
+		break;
+	    }
+	    co = ca->co;
+	    next = ca->to;
+	}
+	if (co == COLORLESS) {
+	    break;
+	}
+	cols[n++] = co;
+    }
+    if (n == 0) {
+	return;
+    }
+
+    /*
+     * Turn the colors into chrs; pseudocolors and multi-chr colors (which
+     * includes anything case-folded) end the prefix.
+     */
+
+    map = (chr *) MALLOC(cnfa->ncolors * sizeof(chr));
+    if (map == NULL) {
+	return;
+    }
+    for (i = 0; i < (size_t) cnfa->ncolors; i++) {
+	map[i] = NOCHR;
+    }
+    singlechrs(v->cm, v->cm->tree, 0, 0, map);
+    for (i = 0; i < n && map[cols[i]] != NOCHR; i++) {
+	/* empty body */
+    }
+    n = i;
+    if (n > 0) {
+	g->prefix = (chr *) MALLOC(n * sizeof(chr) + BYTTAB);
+    }
+    if (g->prefix != NULL) {
+	g->nprefix = n;
+	g->prefixskip = (unsigned char *) (g->prefix + n);
+	memset(g->prefixskip, (int) n, BYTTAB);
+	for (i = 0; i < n; i++) {
+	    g->prefix[i] = map[cols[i]];
+	    if (i < n - 1) {
+		g->prefixskip[g->prefix[i] & BYTMASK] = (unsigned char) (n-1-i);
+	    }
+	}
+    }
+    FREE(map);
+}
+
 /*
  - parse - parse an RE
  * This is actually just the top level, which parses a bunch of branches tied
@@ -2032,6 +2138,9 @@ rfree(
 	if (!NULLCNFA(g->search)) {
 	    freecnfa(&g->search);
 	}
+	if (g->prefix != NULL) {
+	    FREE(g->prefix);
+	}
 	FREE(g);
     }
 }
@@ -320,7 +320,10 @@ newDFA(
     struct dfa *d;
     size_t nss = cnfa->nstates * 2;
     size_t wordsper = (cnfa->nstates + UBITS - 1) / UBITS;
+    size_t perss, want, nbuckets, outslen, size;
     struct smalldfa *smallwas = sml;
+    char *area;
+    int shift;
 
     assert(cnfa != NULL && cnfa->nstates != 0);
 
@@ -339,30 +342,57 @@ newDFA(
 	d->work = &d->statesarea[nss];
 	d->outsarea = sml->outsarea;
 	d->incarea = sml->incarea;
-	d->cptsmalloced = 0;
+	d->hashtab = NULL;
+	d->hashshift = 0;
 	d->mallocarea = (smallwas == NULL) ? (char *)sml : NULL;
     } else {
-	d = (struct dfa *) MALLOC(sizeof(struct dfa));
-	if (d == NULL) {
+	/*
+	 * Let the cache grow past twice the number of states, up to the
+	 * budget, when the string is long enough to visit that many state
+	 * sets. Each step along the string makes at most one.
+	 */
+
+	perss = sizeof(struct sset) + wordsper * sizeof(unsigned)
+		+ cnfa->ncolors * (sizeof(struct sset *) + sizeof(struct arcp))
+		+ 2 * sizeof(struct sset *);
+	want = (size_t)(v->stop - v->start) + 2;
+	if (v->dfasize / perss > nss && want > nss) {
+	    nss = (v->dfasize / perss < want) ? v->dfasize / perss : want;
+	}
+	for (nbuckets = 1, shift = 32; nbuckets < nss; nbuckets <<= 1) {
+	    shift--;
+	}
+
+	/*
+	 * Carve all the arrays out of one block, most strictly aligned
+	 * first.
+	 */
+
+	outslen = nss * cnfa->ncolors;
+	size = sizeof(struct dfa) + nss * sizeof(struct sset)
+		+ outslen * (sizeof(struct sset *) + sizeof(struct arcp))
+		+ nbuckets * sizeof(struct sset *)
+		+ (nss + WORK) * wordsper * sizeof(unsigned);
+	area = (char *) MALLOC(size);
+	if (area == NULL) {
 	    ERR(REG_ESPACE);
 	    return NULL;
 	}
-	d->ssets = (struct sset *) MALLOC(nss * sizeof(struct sset));
-	d->statesarea = (unsigned *)
-		MALLOC((nss+WORK) * wordsper * sizeof(unsigned));
+	d = (struct dfa *) area;
+	area += sizeof(struct dfa);
+	d->ssets = (struct sset *) area;
+	area += nss * sizeof(struct sset);
+	d->outsarea = (struct sset **) area;
+	area += outslen * sizeof(struct sset *);
+	d->incarea = (struct arcp *) area;
+	area += outslen * sizeof(struct arcp);
+	d->hashtab = (struct sset **) area;
+	area += nbuckets * sizeof(struct sset *);
+	d->statesarea = (unsigned *) area;
 	d->work = &d->statesarea[nss * wordsper];
-	d->outsarea = (struct sset **)
-		MALLOC(nss * cnfa->ncolors * sizeof(struct sset *));
-	d->incarea = (struct arcp *)
-		MALLOC(nss * cnfa->ncolors * sizeof(struct arcp));
-	d->cptsmalloced = 1;
+	memset(d->hashtab, 0, nbuckets * sizeof(struct sset *));
+	d->hashshift = shift;
 	d->mallocarea = (char *)d;
-	if (d->ssets == NULL || d->statesarea == NULL ||
-		d->outsarea == NULL || d->incarea == NULL) {
-	    freeDFA(d);
-	    ERR(REG_ESPACE);
-	    return NULL;
-	}
     }
 
     d->nssets = (v->eflags&REG_SMALL) ? 7 : nss;
@@ -391,21 +421,6 @@ static void
 freeDFA(
     struct dfa *const d)
 {
-    if (d->cptsmalloced) {
-	if (d->ssets != NULL) {
-	    FREE(d->ssets);
-	}
-	if (d->statesarea != NULL) {
-	    FREE(d->statesarea);
-	}
-	if (d->outsarea != NULL) {
-	    FREE(d->outsarea);
-	}
-	if (d->incarea != NULL) {
-	    FREE(d->incarea);
-	}
-    }
-
     if (d->mallocarea != NULL) {
 	FREE(d->mallocarea);
     }
@@ -430,6 +445,48 @@ hash(
     }
     return h;
 }
+
+/*
+ - hashSS - enter a state set in the DFA's hash index, if it has one
+ * The state set's bitvector and hash must already be filled in.
+ ^ static void hashSS(struct dfa *, struct sset *);
+ */
+static void
+hashSS(
+    struct dfa *const d,
+    struct sset *const ss)
+{
+    struct sset **bucket;
+
+    if (d->hashtab == NULL) {
+	return;
+    }
+    bucket = &d->hashtab[HASHSLOT(d, ss->hash)];
+    ss->hnext = *bucket;
+    *bucket = ss;
+    ss->flags |= HASHED;
+}
+
+/*
+ - unhashSS - remove a state set from the DFA's hash index
+ ^ static void unhashSS(struct dfa *, struct sset *);
+ */
+static void
+unhashSS(
+    struct dfa *const d,
+    struct sset *const ss)
+{
+    struct sset **pp;
+
+    for (pp = &d->hashtab[HASHSLOT(d, ss->hash)]; *pp != NULL;
+	    pp = &(*pp)->hnext) {
+	if (*pp == ss) {
+	    *pp = ss->hnext;
+	    break;
+	}
+    }
+    ss->flags &= ~HASHED;
+}
 
 /*
  - initialize - hand-craft a cache entry for startup, otherwise get ready
@@ -459,6 +516,7 @@ initialize(
 	ss->hash = HASH(ss->states, d->wordsper);
 	assert(d->cnfa->pre != d->cnfa->post);
 	ss->flags = STARTER|LOCKED|NOPROGRESS;
+	hashSS(d, ss);
 
 	/*
 	 * lastseen dealt with below
@@ -504,6 +562,7 @@ miss(
 	return css->outs[co];
     }
     FDEBUG(("miss\n"));
+    v->dfamisses++;
 
     /*
      * First, what set of states would we end up in?
@@ -571,13 +630,25 @@ miss(
      * Next, is that in the cache?
      */
 
-    for (p = d->ssets, i = d->nssused; i > 0; p++, i--) {
-	 if (HIT(h, d->work, p, d->wordsper)) {
-	     FDEBUG(("cached c%d\n", (int) (p - d->ssets)));
-	     break;			/* NOTE BREAK OUT */
-	 }
+    if (d->hashtab != NULL) {
+	for (p = d->hashtab[HASHSLOT(d, h)]; p != NULL; p = p->hnext) {
+	    if (HIT(h, d->work, p, d->wordsper)) {
+		FDEBUG(("cached c%d\n", (int) (p - d->ssets)));
+		break;			/* NOTE BREAK OUT */
+	    }
+	}
+    } else {
+	for (p = d->ssets, i = d->nssused; i > 0; p++, i--) {
+	    if (HIT(h, d->work, p, d->wordsper)) {
+		FDEBUG(("cached c%d\n", (int) (p - d->ssets)));
+		break;			/* NOTE BREAK OUT */
+	    }
+	}
+	if (i == 0) {
+	    p = NULL;
+	}
     }
-    if (i == 0) {		/* nope, need a new cache entry */
+    if (p == NULL) {		/* nope, need a new cache entry */
 	p = getVacantSS(v, d, cp, start);
 	assert(p != css);
 	for (i = 0; i < d->wordsper; i++) {
@@ -588,6 +659,7 @@ miss(
 	if (noProgress) {
 	    p->flags |= NOPROGRESS;
 	}
+	hashSS(d, p);
 
 	/*
 	 * lastseen to be dealt with by caller
@@ -657,6 +729,9 @@ getVacantSS(
 
     ss = pickNextSS(v, d, cp, start);
     assert(!(ss->flags&LOCKED));
+    if (ss->flags&HASHED) {
+	unhashSS(d, ss);
+    }
 
     /*
      * Clear out its inarcs, including self-referential ones.
@@ -765,6 +840,7 @@ pickNextSS(
      * Look for oldest, or old enough anyway.
      */
 
+    v->dfaflushes++;
     if ((size_t)(cp - start) > d->nssets*2/3) {	/* oldest 33% are expendable */
 	ancient = cp - d->nssets*2/3;
     } else {
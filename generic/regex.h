@@ -148,6 +148,10 @@ typedef struct {
 /* supplementary control and reporting */
 typedef struct {
     regmatch_t rm_extend;	/* see REG_EXPECT */
+    size_t rm_dfasize;		/* bytes a lazy DFA's state cache may grow
+				 * to; 0 means twice its number of states */
+    size_t rm_dfamisses;	/* DFA transitions computed (added to) */
+    size_t rm_dfaflushes;	/* DFA cache entries evicted (added to) */
 } rm_detail_t;
 
 /*
@@ -266,6 +270,9 @@ int regexec(regex_t *, const char *, size_t, regmatch_t [], int);
 #ifdef __REG_WIDE_T
 MODULE_SCOPE int __REG_WIDE_EXEC(regex_t *, const __REG_WIDE_T *, size_t, rm_detail_t *, size_t, regmatch_t [], int);
 #endif
+#ifdef __REG_WIDE_T
+MODULE_SCOPE size_t TclRePrefix(regex_t *, const __REG_WIDE_T **);
+#endif
 MODULE_SCOPE void regfree(regex_t *);
 MODULE_SCOPE size_t regerror(int, char *, size_t);
 /* automatically gathered by fwd; do not hand-edit */
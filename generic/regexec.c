@@ -50,10 +50,12 @@ struct sset {			/* state set */
 #define	POSTSTATE	02	/* includes the goal state */
 #define	LOCKED		04	/* locked in cache */
 #define	NOPROGRESS	010	/* zero-progress state set */
+#define	HASHED		020	/* entered in the hash index */
     struct arcp ins;		/* chain of inarcs pointing here */
     chr *lastseen;		/* last entered on arrival here */
     struct sset **outs;		/* outarc vector indexed by color */
     struct arcp *inchain;	/* chain-pointer vector for outarcs */
+    struct sset *hnext;		/* next in hash bucket */
 };
 
 struct dfa {
@@ -62,12 +64,13 @@ struct dfa {
     size_t nstates;		/* number of states */
     size_t wordsper;		/* length of state-set bitvectors */
     int ncolors;		/* length of outarc and inchain vectors */
-    int cptsmalloced;		/* were the areas individually malloced? */
     struct sset *ssets;		/* state-set cache */
     unsigned *statesarea;	/* bitvector storage */
     unsigned *work;		/* pointer to work area within statesarea */
     struct sset **outsarea;	/* outarc-vector storage */
     struct arcp *incarea;	/* inchain storage */
+    struct sset **hashtab;	/* hash index of the cache, or NULL */
+    int hashshift;		/* 32 - log2 of number of hash buckets */
     struct cnfa *cnfa;
     struct colormap *cm;
     chr *lastpost;		/* location of last cache-flushed success */
@@ -77,6 +80,7 @@ struct dfa {
 };
 
 #define	WORK	1		/* number of work bitvectors needed */
+#define	HASHSLOT(d, h)	(((h) * 0x9E3779B1U) >> (d)->hashshift)
 
 /*
  * Setup for non-malloc allocation for small cases.
@@ -107,6 +111,9 @@ struct vars {
     chr *stop;			/* just past end of string */
     int err;			/* error code if any (0 none) */
     struct dfa **subdfas;	/* per-subre DFAs */
+    size_t dfasize;		/* budget for each DFA's cache, in bytes */
+    size_t dfamisses;		/* DFA transitions computed */
+    size_t dfaflushes;		/* DFA cache entries evicted */
     struct smalldfa dfa1;
     struct smalldfa dfa2;
 };
@@ -126,6 +133,7 @@ struct vars {
 /* === regexec.c === */
 int exec(regex_t *, const chr *, size_t, rm_detail_t *, size_t, regmatch_t [], int);
 static struct dfa *getsubdfa(struct vars *, struct subre *);
+static chr *findprefix(struct vars *const, chr *);
 static int simpleFind(struct vars *const, struct cnfa *const, struct colormap *const);
 static int complicatedFind(struct vars *const, struct cnfa *const, struct colormap *const);
 static int complicatedFindLoop(struct vars *const, struct dfa *const, struct dfa *const, chr **const);
@@ -146,6 +154,8 @@ static chr *lastCold(struct vars *const, struct dfa *const);
 static struct dfa *newDFA(struct vars *const, struct cnfa *const, struct colormap *const, struct smalldfa *);
 static void freeDFA(struct dfa *const);
 static unsigned hash(unsigned *const, int);
+static void hashSS(struct dfa *const, struct sset *const);
+static void unhashSS(struct dfa *const, struct sset *const);
 static struct sset *initialize(struct vars *const, struct dfa *const, chr *const);
 static struct sset *miss(struct vars *const, struct dfa *const, struct sset *const, const pcolor, chr *const, chr *const);
 static int checkLAConstraint(struct vars *const, struct cnfa *const, chr *const, const pcolor);
@@ -227,6 +237,9 @@ exec(
 	v->pmatch = pmatch;
     }
     v->details = details;
+    v->dfasize = (details != NULL) ? details->rm_dfasize : 0;
+    v->dfamisses = 0;
+    v->dfaflushes = 0;
     v->start = (chr *)string;
     v->stop = (chr *)string + len;
     v->err = 0;
@@ -284,9 +297,35 @@ exec(
     if (v->subdfas != subdfas) {
 	FREE(v->subdfas);
     }
+    if (details != NULL) {
+	details->rm_dfamisses += v->dfamisses;
+	details->rm_dfaflushes += v->dfaflushes;
+    }
     FreeVars(v);
     return st;
 }
+
+/*
+ - TclRePrefix - report the literal prefix every match of an RE begins with
+ * Stores a pointer to the prefix characters (owned by the RE) in *prefixPtr
+ * and returns their number, which is 0 when the RE has no usable prefix.
+ ^ size_t TclRePrefix(regex_t *, const chr **);
+ */
+size_t
+TclRePrefix(
+    regex_t *re,
+    const chr **prefixPtr)
+{
+    struct guts *g;
+
+    *prefixPtr = NULL;
+    if (re == NULL || re->re_magic != REMAGIC) {
+	return 0;
+    }
+    g = (struct guts *) re->re_guts;
+    *prefixPtr = g->prefix;
+    return g->nprefix;
+}
 
 /*
  - getsubdfa - create or re-fetch the DFA for a subre node
@@ -306,6 +345,49 @@ getsubdfa(struct vars * v,
     return v->subdfas[t->id];
 }
 
+/*
+ - findprefix - find where the RE's literal prefix next occurs
+ * Returns "from" itself when the RE has no prefix, NULL when the prefix
+ * does not occur at or after "from". Longer prefixes use a Horspool scan
+ * whose shift table is indexed by the low byt of each chr.
+ ^ static chr *findprefix(struct vars *const, chr *);
+ */
+static chr *
+findprefix(
+    struct vars *const v,
+    chr *from)
+{
+    const chr *prefix = v->g->prefix;
+    const size_t n = v->g->nprefix;
+    size_t i;
+    chr c;
+
+    if (n == 0) {
+	return from;
+    }
+    if (n == 1) {
+	for (c = prefix[0]; from < v->stop; from++) {
+	    if (*from == c) {
+		return from;
+	    }
+	}
+	return NULL;
+    }
+    while ((size_t) (v->stop - from) >= n) {
+	c = from[n-1];
+	if (c == prefix[n-1]) {
+	    for (i = 0; i < n-1 && from[i] == prefix[i]; i++) {
+		/* empty body */
+	    }
+	    if (i == n-1) {
+		return from;
+	    }
+	}
+	from += v->g->prefixskip[c & BYTMASK];
+    }
+    return NULL;
+}
+
 /*
  - simpleFind - find a match for the main NFA (no-complications case)
  ^ static int simpleFind(struct vars *, struct cnfa *, struct colormap *);
@@ -318,12 +400,22 @@ simpleFind(
 {
     struct dfa *s, *d;
     chr *begin, *end = NULL;
-    chr *cold;
+    chr *first, *cold;
     chr *open, *close;		/* Open and close of range of possible
 				 * starts */
     int hitend;
     int shorter = (v->g->tree->flags&SHORTER) ? 1 : 0;
 
+    /*
+     * No match can begin before the first occurrence of the literal prefix,
+     * if there is one, so don't bother running any DFA over that stretch.
+     */
+
+    first = findprefix(v, v->start);
+    if (first == NULL) {
+	return REG_NOMATCH;
+    }
+
     /*
      * First, a shot with the search RE.
      */
@@ -331,9 +423,9 @@ simpleFind(
     s = newDFA(v, &v->g->search, cm, &v->dfa1);
     assert(!(ISERR() && s != NULL));
     NOERR();
-    MDEBUG(("\nsearch at %" TCL_Z_MODIFIER "u\n", LOFF(v->start)));
+    MDEBUG(("\nsearch at %" TCL_Z_MODIFIER "u\n", LOFF(first)));
     cold = NULL;
-    close = shortest(v, s, v->start, v->start, v->stop, &cold, NULL);
+    close = shortest(v, s, first, first, v->stop, &cold, NULL);
     freeDFA(s);
     NOERR();
     if (v->g->cflags&REG_EXPECT) {
@@ -475,6 +567,10 @@ complicatedFindLoop(
     cold = NULL;
     close = v->start;
     do {
+	close = findprefix(v, close);
+	if (close == NULL) {
+	    break;		/* NOTE BREAK */
+	}
 	MDEBUG(("\ncsearch at %" TCL_Z_MODIFIER "u\n", LOFF(close)));
 	close = shortest(v, s, close, close, v->stop, &cold, NULL);
 	if (close == NULL) {
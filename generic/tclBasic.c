@@ -1157,6 +1157,10 @@ Tcl_CreateInterp(void)
 	    Tcl_DisassembleObjCmd, INT2PTR(1), NULL);
     Tcl_CreateObjCommand(interp, "::tcl::unsupported::representation",
 	    Tcl_RepresentationCmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::interning",
+	    TclInterningObjCmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::regexpcache",
+	    TclRegexpCacheObjCmd, NULL, NULL);
 
     /* Adding the bytecode assembler command */
     cmdPtr = (Command *) Tcl_NRCreateCommand(interp,
@@ -1170,6 +1174,14 @@ Tcl_CreateInterp(void)
     Tcl_CreateObjCommand(interp, "::tcl::unsupported::corotype",
             CoroTypeObjCmd, NULL, NULL);
 
+    /* Event loop instrumentation */
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::eventstats",
+	    TclEventStatsObjCmd, NULL, NULL);
+
+    /* Memory instrumentation */
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::allocprofile",
+	    TclAllocProfileObjCmd, NULL, NULL);
+
     /* Export unsupported commands */
     nsPtr = Tcl_FindNamespace(interp, "::tcl::unsupported", NULL, 0);
     if (nsPtr) {
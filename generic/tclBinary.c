@@ -51,19 +51,62 @@
 
 #define BINARY_SCAN_MAX_CACHE	260
 
+/*
+ * The format strings of [binary format] and [binary scan] are compiled into
+ * programs of fields, cached as their internal rep, so that commands run
+ * with the same format again and again don't parse it each time. The program
+ * keeps a copy of the format string for error messages, and is reference
+ * counted because the command running it may make the format value shimmer
+ * to another type, e.g. when it is also one of the arguments.
+ */
+
+typedef struct FormatField {
+    char cmd;			/* The field specifier character. */
+    unsigned char flags;	/* BINARY_UNSIGNED if it has the 'u' flag. */
+    unsigned char size;		/* Size in bytes of each item of a numeric
+				 * field, 0 for other fields. */
+    Tcl_Size count;		/* The count, BINARY_ALL if it was '*' or
+				 * BINARY_NOCOUNT if there was none. */
+    Tcl_Size start;		/* Index in the format string where the field
+				 * starts, for error messages. */
+} FormatField;
+
+typedef struct FormatProgram {
+    size_t refCount;		/* Number of values and commands using it. */
+    char *string;		/* Copy of the format string. */
+    Tcl_Size numFields;		/* Number of fields... */
+    FormatField fields[TCLFLEXARRAY];
+				/* ...and the fields themselves, followed by
+				 * the format string. */
+} FormatProgram;
+
 /*
  * Prototypes for local procedures defined in this file:
  */
 
+static void		DupFormatProgramInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
 static void		DupProperByteArrayInternalRep(Tcl_Obj *srcPtr,
 			    Tcl_Obj *copyPtr);
+static int		FormatBinary(Tcl_Interp *interp,
+			    FormatProgram *progPtr, int objc,
+			    Tcl_Obj *const objv[]);
 static int		FormatNumber(Tcl_Interp *interp, int type,
 			    Tcl_Obj *src, unsigned char **cursorPtr);
+static void		FreeFormatProgramInternalRep(Tcl_Obj *objPtr);
 static void		FreeProperByteArrayInternalRep(Tcl_Obj *objPtr);
 static int		GetFormatSpec(const char **formatPtr, char *cmdPtr,
 			    Tcl_Size *countPtr, int *flagsPtr);
+static FormatProgram *	GetFormatProgramFromObj(Tcl_Obj *formatObj);
+static void		ReleaseFormatProgram(FormatProgram *progPtr);
+static int		ScanBinary(Tcl_Interp *interp,
+			    FormatProgram *progPtr, int objc,
+			    Tcl_Obj *const objv[]);
 static Tcl_Obj *	ScanNumber(unsigned char *buffer, int type,
 			    int flags, Tcl_HashTable **numberCachePtr);
+static void		ScanNumbers(unsigned char *buffer, int type,
+			    int flags, Tcl_Size size, Tcl_Size count,
+			    Tcl_Obj **objv, Tcl_HashTable **numberCachePtr);
 static int		SetByteArrayFromAny(Tcl_Interp *interp, Tcl_Size limit,
 			    Tcl_Obj *objPtr);
 static void		UpdateStringOfByteArray(Tcl_Obj *listPtr);
@@ -86,11 +129,6 @@ static Tcl_ObjCmdProc	BinaryDecodeUu;
  * The following tables are used by the binary encoders
  */
 
-static const char HexDigits[16] = {
-    '0', '1', '2', '3', '4', '5', '6', '7',
-    '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
-};
-
 static const char UueDigits[65] = {
     '`', '!', '"', '#', '$', '%', '&', '\'',
     '(', ')', '*', '+', ',', '-', '.', '/',
@@ -115,6 +153,83 @@ static const char B64Digits[65] = {
     '='
 };
 
+/*
+ * The following tables are used by the binary encoders and decoders to
+ * handle a whole byte at a time: the two hexadecimal digits of each byte
+ * value, and the value of each hexadecimal or base64 digit, with 16 and 64
+ * respectively standing for anything that is not one.
+ */
+
+static const char HexPairs[513] =
+    "000102030405060708090a0b0c0d0e0f"
+    "101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f"
+    "303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f"
+    "505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f"
+    "707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f"
+    "909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+    "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+    "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+    "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+static const unsigned char HexValues[256] = {
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 16, 16, 16, 16, 16, 16,
+    16, 10, 11, 12, 13, 14, 15, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 10, 11, 12, 13, 14, 15, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16
+};
+
+static const unsigned char B64Values[256] = {
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 62, 64, 64, 64, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 64, 64, 64, 64, 64, 64,
+    64,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 64, 64, 64, 64, 64,
+    64, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64
+};
+
+/*
+ * The compiled format strings of [binary format] and [binary scan], see
+ * GetFormatProgramFromObj, are cached as their internal rep.
+ */
+
+static const Tcl_ObjType formatProgramType = {
+    "binaryformat",		/* name */
+    FreeFormatProgramInternalRep, /* freeIntRepProc */
+    DupFormatProgramInternalRep, /* dupIntRepProc */
+    NULL,			/* updateStringProc */
+    NULL,			/* setFromAnyProc */
+    TCL_OBJTYPE_V0
+};
+
 /*
  * How to construct the ensembles.
  */
@@ -839,6 +954,43 @@ BinaryFormatCmd(
     Tcl_Interp *interp,		/* Current interpreter. */
     int objc,			/* Number of arguments. */
     Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    FormatProgram *progPtr;
+    int result;
+
+    if (objc < 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "formatString ?arg ...?");
+	return TCL_ERROR;
+    }
+    progPtr = GetFormatProgramFromObj(objv[1]);
+    progPtr->refCount++;
+    result = FormatBinary(interp, progPtr, objc, objv);
+    ReleaseFormatProgram(progPtr);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FormatBinary --
+ *
+ *	Run the compiled format string of a "binary format" command.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See the user documentation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+FormatBinary(
+    Tcl_Interp *interp,		/* Current interpreter. */
+    FormatProgram *progPtr,	/* The compiled format string. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
 {
     int arg;			/* Index of next argument to consume. */
     int value = 0;		/* Current integer value to be packed.
@@ -846,9 +998,8 @@ BinaryFormatCmd(
     char cmd;			/* Current format character. */
     Tcl_Size count;		/* Count associated with current format
 				 * character. */
-    int flags;			/* Format field flags */
-    const char *format;		/* Pointer to current position in format
-				 * string. */
+    const FormatField *fieldPtr;/* Current field of the format string. */
+    const FormatField *endPtr = progPtr->fields + progPtr->numFields;
     Tcl_Obj *resultPtr = NULL;	/* Object holding result buffer. */
     unsigned char *buffer;	/* Start of result buffer. */
     unsigned char *cursor;	/* Current position within result buffer. */
@@ -858,27 +1009,18 @@ BinaryFormatCmd(
     const char *errorValue, *str;
     Tcl_Size offset, size, length;
 
-    if (objc < 2) {
-	Tcl_WrongNumArgs(interp, 1, objv, "formatString ?arg ...?");
-	return TCL_ERROR;
-    }
-
     /*
      * To avoid copying the data, we format the string in two passes. The
      * first pass computes the size of the output buffer. The second pass
      * places the formatted data into the buffer.
      */
 
-    format = TclGetString(objv[1]);
     arg = 2;
     offset = 0;
     length = 0;
-    while (*format != '\0') {
-	str = format;
-	flags = 0;
-	if (!GetFormatSpec(&format, &cmd, &count, &flags)) {
-	    break;
-	}
+    for (fieldPtr = progPtr->fields; fieldPtr < endPtr; fieldPtr++) {
+	cmd = fieldPtr->cmd;
+	count = fieldPtr->count;
 	switch (cmd) {
 	case 'a':
 	case 'A':
@@ -911,34 +1053,22 @@ BinaryFormatCmd(
 	    }
 	    break;
 	case 'c':
-	    size = 1;
-	    goto doNumbers;
 	case 't':
 	case 's':
 	case 'S':
-	    size = 2;
-	    goto doNumbers;
 	case 'n':
 	case 'i':
 	case 'I':
-	    size = 4;
-	    goto doNumbers;
 	case 'm':
 	case 'w':
 	case 'W':
-	    size = 8;
-	    goto doNumbers;
 	case 'r':
 	case 'R':
 	case 'f':
-	    size = sizeof(float);
-	    goto doNumbers;
 	case 'q':
 	case 'Q':
 	case 'd':
-	    size = sizeof(double);
-
-	doNumbers:
+	    size = fieldPtr->size;
 	    if (arg >= objc) {
 		goto badIndex;
 	    }
@@ -1017,7 +1147,7 @@ BinaryFormatCmd(
 	    }
 	    break;
 	default:
-	    errorString = str;
+	    errorString = progPtr->string + fieldPtr->start;
 	    goto badField;
 	}
     }
@@ -1044,16 +1174,13 @@ BinaryFormatCmd(
      */
 
     arg = 2;
-    format = TclGetString(objv[1]);
     cursor = buffer;
     maxPos = cursor;
-    while (*format != 0) {
-	flags = 0;
-	if (!GetFormatSpec(&format, &cmd, &count, &flags)) {
-	    break;
-	}
+    for (fieldPtr = progPtr->fields; fieldPtr < endPtr; fieldPtr++) {
+	cmd = fieldPtr->cmd;
+	count = fieldPtr->count;
 	if ((count == 0) && (cmd != '@')) {
-	    if (cmd != 'x') {
+	    if ((cmd != 'x') && (cmd != 'X')) {
 		arg++;
 	    }
 	    continue;
@@ -1351,6 +1478,44 @@ BinaryScanCmd(
     Tcl_Interp *interp,		/* Current interpreter. */
     int objc,			/* Number of arguments. */
     Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    FormatProgram *progPtr;
+    int result;
+
+    if (objc < 3) {
+	Tcl_WrongNumArgs(interp, 1, objv,
+		"value formatString ?varName ...?");
+	return TCL_ERROR;
+    }
+    progPtr = GetFormatProgramFromObj(objv[2]);
+    progPtr->refCount++;
+    result = ScanBinary(interp, progPtr, objc, objv);
+    ReleaseFormatProgram(progPtr);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ScanBinary --
+ *
+ *	Run the compiled format string of a "binary scan" command.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See the user documentation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ScanBinary(
+    Tcl_Interp *interp,		/* Current interpreter. */
+    FormatProgram *progPtr,	/* The compiled format string. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
 {
     int arg;			/* Index of next argument to consume. */
     int value = 0;		/* Current integer value to be packed.
@@ -1359,38 +1524,29 @@ BinaryScanCmd(
     Tcl_Size count;		/* Count associated with current format
 				 * character. */
     int flags;			/* Format field flags */
-    const char *format;		/* Pointer to current position in format
-				 * string. */
+    const FormatField *fieldPtr;/* Current field of the format string. */
+    const FormatField *endPtr = progPtr->fields + progPtr->numFields;
     Tcl_Obj *resultPtr = NULL;	/* Object holding result buffer. */
     unsigned char *buffer;	/* Start of result buffer. */
     const char *errorString;
-    const char *str;
     Tcl_Size offset, size, length = 0, i;
 
-    Tcl_Obj *valuePtr, *elementPtr;
+    Tcl_Obj *valuePtr;
     Tcl_HashTable numberCacheHash;
     Tcl_HashTable *numberCachePtr;
 
-    if (objc < 3) {
-	Tcl_WrongNumArgs(interp, 1, objv,
-		"value formatString ?varName ...?");
-	return TCL_ERROR;
-    }
     buffer = Tcl_GetBytesFromObj(interp, objv[1], &length);
     if (buffer == NULL) {
 	return TCL_ERROR;
     }
     numberCachePtr = &numberCacheHash;
     Tcl_InitHashTable(numberCachePtr, TCL_ONE_WORD_KEYS);
-    format = TclGetString(objv[2]);
     arg = 3;
     offset = 0;
-    while (*format != '\0') {
-	str = format;
-	flags = 0;
-	if (!GetFormatSpec(&format, &cmd, &count, &flags)) {
-	    goto done;
-	}
+    for (fieldPtr = progPtr->fields; fieldPtr < endPtr; fieldPtr++) {
+	cmd = fieldPtr->cmd;
+	count = fieldPtr->count;
+	flags = fieldPtr->flags;
 	switch (cmd) {
 	case 'a':
 	case 'A':
@@ -1569,37 +1725,22 @@ BinaryScanCmd(
 	    break;
 	}
 	case 'c':
-	    size = 1;
-	    goto scanNumber;
 	case 't':
 	case 's':
 	case 'S':
-	    size = 2;
-	    goto scanNumber;
 	case 'n':
 	case 'i':
 	case 'I':
-	    size = 4;
-	    goto scanNumber;
 	case 'm':
 	case 'w':
 	case 'W':
-	    size = 8;
-	    goto scanNumber;
 	case 'r':
 	case 'R':
 	case 'f':
-	    size = sizeof(float);
-	    goto scanNumber;
 	case 'q':
 	case 'Q':
-	case 'd': {
-	    unsigned char *src;
-
-	    size = sizeof(double);
-	    /* fall through */
-
-	scanNumber:
+	case 'd':
+	    size = fieldPtr->size;
 	    if (arg >= objc) {
 		DeleteScanNumberCache(numberCachePtr);
 		goto badIndex;
@@ -1618,12 +1759,29 @@ BinaryScanCmd(
 		if ((length - offset) < (count * size)) {
 		    goto done;
 		}
-		TclNewObj(valuePtr);
-		src = buffer + offset;
-		for (i = 0; i < count; i++) {
-		    elementPtr = ScanNumber(src, cmd, flags, &numberCachePtr);
-		    src += size;
-		    Tcl_ListObjAppendElement(NULL, valuePtr, elementPtr);
+
+		/*
+		 * Make the list big enough for all the values up front, and
+		 * store them in it directly, as [lrepeat] does.
+		 */
+
+		valuePtr = Tcl_NewListObj(count, NULL);
+		if (count > 0) {
+		    ListRep listRep;
+		    Tcl_Obj **elements;
+
+		    ListObjGetRep(valuePtr, &listRep);
+		    elements = ListRepElementsBase(&listRep);
+		    ScanNumbers(buffer + offset, cmd, flags, size, count,
+			    elements, &numberCachePtr);
+		    for (i = 0; i < count; i++) {
+			Tcl_IncrRefCount(elements[i]);
+		    }
+		    listRep.storePtr->numUsed = count;
+		    if (listRep.spanPtr) {
+			listRep.spanPtr->spanStart = listRep.storePtr->firstUsed;
+			listRep.spanPtr->spanLength = count;
+		    }
 		}
 		offset += count * size;
 	    }
@@ -1636,7 +1794,6 @@ BinaryScanCmd(
 		return TCL_ERROR;
 	    }
 	    break;
-	}
 	case 'x':
 	    if (count == BINARY_NOCOUNT) {
 		count = 1;
@@ -1670,7 +1827,7 @@ BinaryScanCmd(
 	    break;
 	default:
 	    DeleteScanNumberCache(numberCachePtr);
-	    errorString = str;
+	    errorString = progPtr->string + fieldPtr->start;
 	    goto badField;
 	}
     }
@@ -1710,6 +1867,157 @@ BinaryScanCmd(
     return TCL_ERROR;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetFormatProgramFromObj --
+ *
+ *	Get the compiled form of a "binary format" or "binary scan" format
+ *	string, compiling it with GetFormatSpec if the value does not hold it
+ *	already. Field specifiers are not checked here, so that errors are
+ *	reported in the same order as the fields are processed.
+ *
+ * Results:
+ *	The compiled format string.
+ *
+ * Side effects:
+ *	Changes the internal rep of formatObj.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static FormatProgram *
+GetFormatProgramFromObj(
+    Tcl_Obj *formatObj)		/* The format string. */
+{
+    const Tcl_ObjInternalRep *irPtr;
+    Tcl_ObjInternalRep ir;
+    FormatProgram *progPtr;
+    FormatField *fieldPtr;
+    const char *format, *p;
+    Tcl_Size length, numFields = 0, count;
+    char cmd;
+    int flags = 0;
+
+    irPtr = TclFetchInternalRep(formatObj, &formatProgramType);
+    if (irPtr != NULL) {
+	return (FormatProgram *) irPtr->twoPtrValue.ptr1;
+    }
+
+    format = TclGetStringFromObj(formatObj, &length);
+    for (p = format; GetFormatSpec(&p, &cmd, &count, &flags); ) {
+	numFields++;
+    }
+    progPtr = (FormatProgram *) Tcl_Alloc(offsetof(FormatProgram, fields)
+	    + numFields * sizeof(FormatField) + length + 1);
+    progPtr->refCount = 1;
+    progPtr->numFields = numFields;
+    progPtr->string = (char *) (progPtr->fields + numFields);
+    memcpy(progPtr->string, format, length + 1);
+
+    p = progPtr->string;
+    for (fieldPtr = progPtr->fields; fieldPtr < progPtr->fields + numFields;
+	    fieldPtr++) {
+	while (*p == ' ') {
+	    p++;
+	}
+	fieldPtr->start = p - progPtr->string;
+	flags = 0;
+	GetFormatSpec(&p, &fieldPtr->cmd, &fieldPtr->count, &flags);
+	fieldPtr->flags = (unsigned char) flags;
+	switch (fieldPtr->cmd) {
+	case 'c':
+	    fieldPtr->size = 1;
+	    break;
+	case 't':
+	case 's':
+	case 'S':
+	    fieldPtr->size = 2;
+	    break;
+	case 'n':
+	case 'i':
+	case 'I':
+	    fieldPtr->size = 4;
+	    break;
+	case 'm':
+	case 'w':
+	case 'W':
+	    fieldPtr->size = 8;
+	    break;
+	case 'r':
+	case 'R':
+	case 'f':
+	    fieldPtr->size = sizeof(float);
+	    break;
+	case 'q':
+	case 'Q':
+	case 'd':
+	    fieldPtr->size = sizeof(double);
+	    break;
+	default:
+	    fieldPtr->size = 0;
+	    break;
+	}
+    }
+
+    ir.twoPtrValue.ptr1 = progPtr;
+    ir.twoPtrValue.ptr2 = NULL;
+    Tcl_StoreInternalRep(formatObj, &formatProgramType, &ir);
+    return progPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleaseFormatProgram, FreeFormatProgramInternalRep,
+ * DupFormatProgramInternalRep --
+ *
+ *	Manage the references to a compiled format string.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The program is freed when its last reference goes.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ReleaseFormatProgram(
+    FormatProgram *progPtr)
+{
+    if (progPtr->refCount-- <= 1) {
+	Tcl_Free(progPtr);
+    }
+}
+
+static void
+FreeFormatProgramInternalRep(
+    Tcl_Obj *objPtr)
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(objPtr, &formatProgramType);
+
+    ReleaseFormatProgram((FormatProgram *) irPtr->twoPtrValue.ptr1);
+}
+
+static void
+DupFormatProgramInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(srcPtr, &formatProgramType);
+    FormatProgram *progPtr = (FormatProgram *) irPtr->twoPtrValue.ptr1;
+    Tcl_ObjInternalRep ir;
+
+    progPtr->refCount++;
+    ir.twoPtrValue.ptr1 = progPtr;
+    ir.twoPtrValue.ptr2 = NULL;
+    Tcl_StoreInternalRep(copyPtr, &formatProgramType, &ir);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2353,6 +2661,116 @@ ScanNumber(
     return NULL;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ScanNumbers --
+ *
+ *	This routine is called by Tcl_BinaryObjCmd to scan a run of numbers
+ *	of the same type out of a buffer. Floating point numbers and wide
+ *	integers, which never go in the number cache, are copied out in a
+ *	loop that only decides once whether their bytes need reordering.
+ *	Other numbers are scanned one by one with ScanNumber.
+ *
+ * Results:
+ *	Stores the newly created objects in objv.
+ *
+ * Side effects:
+ *	As for ScanNumber.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ScanNumbers(
+    unsigned char *buffer,	/* Buffer to scan numbers from. */
+    int type,			/* Format character from "binary scan" */
+    int flags,			/* Format field flags */
+    Tcl_Size size,		/* Size of each number in bytes. */
+    Tcl_Size count,		/* How many numbers to scan. */
+    Tcl_Obj **objv,		/* Where to store them. */
+    Tcl_HashTable **numberCachePtrPtr)
+				/* Place to look for cache of scanned value
+				 * objects, or NULL if too many different
+				 * numbers have been scanned. */
+{
+    Tcl_Size i;
+    float fvalue;
+    double dvalue;
+    Tcl_WideUInt uwvalue;
+
+    switch (type) {
+    case 'f':
+    case 'R':
+    case 'r':
+	if (NeedReversing(type)) {
+	    for (i = 0; i < count; i++, buffer += sizeof(float)) {
+		CopyNumber(buffer, &fvalue, sizeof(float), type);
+		TclNewDoubleObj(objv[i], fvalue);
+	    }
+	} else {
+	    for (i = 0; i < count; i++, buffer += sizeof(float)) {
+		memcpy(&fvalue, buffer, sizeof(float));
+		TclNewDoubleObj(objv[i], fvalue);
+	    }
+	}
+	return;
+
+    case 'd':
+    case 'Q':
+    case 'q':
+	if (NeedReversing(type)) {
+	    for (i = 0; i < count; i++, buffer += sizeof(double)) {
+		CopyNumber(buffer, &dvalue, sizeof(double), type);
+		TclNewDoubleObj(objv[i], dvalue);
+	    }
+	} else {
+	    for (i = 0; i < count; i++, buffer += sizeof(double)) {
+		memcpy(&dvalue, buffer, sizeof(double));
+		TclNewDoubleObj(objv[i], dvalue);
+	    }
+	}
+	return;
+
+    case 'w':
+    case 'W':
+    case 'm':
+	if (flags & BINARY_UNSIGNED) {
+	    break;
+	}
+	if (NeedReversing(type)) {
+	    for (i = 0; i < count; i++, buffer += 8) {
+		uwvalue = ((Tcl_WideUInt) buffer[0])
+			| (((Tcl_WideUInt) buffer[1]) << 8)
+			| (((Tcl_WideUInt) buffer[2]) << 16)
+			| (((Tcl_WideUInt) buffer[3]) << 24)
+			| (((Tcl_WideUInt) buffer[4]) << 32)
+			| (((Tcl_WideUInt) buffer[5]) << 40)
+			| (((Tcl_WideUInt) buffer[6]) << 48)
+			| (((Tcl_WideUInt) buffer[7]) << 56);
+		TclNewIntObj(objv[i], (Tcl_WideInt) uwvalue);
+	    }
+	} else {
+	    for (i = 0; i < count; i++, buffer += 8) {
+		uwvalue = ((Tcl_WideUInt) buffer[7])
+			| (((Tcl_WideUInt) buffer[6]) << 8)
+			| (((Tcl_WideUInt) buffer[5]) << 16)
+			| (((Tcl_WideUInt) buffer[4]) << 24)
+			| (((Tcl_WideUInt) buffer[3]) << 32)
+			| (((Tcl_WideUInt) buffer[2]) << 40)
+			| (((Tcl_WideUInt) buffer[1]) << 48)
+			| (((Tcl_WideUInt) buffer[0]) << 56);
+		TclNewIntObj(objv[i], (Tcl_WideInt) uwvalue);
+	    }
+	}
+	return;
+    }
+
+    for (i = 0; i < count; i++, buffer += size) {
+	objv[i] = ScanNumber(buffer, type, flags, numberCachePtrPtr);
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2404,12 +2822,16 @@ DeleteScanNumberCache(
  *	uuencode and base64 value encoding than to calculate the output (at
  *	least on intel P4 arch).
  *
- *	Conversely using a lookup table for the decoding is slower than just
- *	calculating the values. We therefore use the fastest of each method.
+ *	Conversely using a lookup table for the uuencode decoding is slower
+ *	than just calculating the values. We therefore use the fastest of each
+ *	method.
  *
- *	Presumably this has to do with the size of the tables. The base64
- *	decode table is 255 bytes while the encode table is only 65 bytes. The
- *	choice likely depends on CPU memory cache sizes.
+ *	The hexadecimal and base64 codecs handle the bulk of their input a
+ *	whole group at a time, in loops without per-character option checks
+ *	that compilers can unroll and vectorize, and only fall back to the
+ *	general loops for the groups with whitespace, padding, invalid
+ *	characters or line breaks. Their decoding tables are small enough to
+ *	stay cached.
  */
 
 /*
@@ -2454,8 +2876,8 @@ BinaryEncodeHex(
     TclNewObj(resultObj);
     cursor = Tcl_SetByteArrayLength(resultObj, count * 2);
     for (offset = 0; offset < count; ++offset) {
-	*cursor++ = HexDigits[(data[offset] >> 4) & 0x0F];
-	*cursor++ = HexDigits[data[offset] & 0x0F];
+	memcpy(cursor, HexPairs + 2 * data[offset], 2);
+	cursor += 2;
     }
     Tcl_SetObjResult(interp, resultObj);
     return TCL_OK;
@@ -2520,6 +2942,23 @@ BinaryDecodeHex(
     size = (count + 1) / 2;
     begin = cursor = Tcl_SetByteArrayLength(resultObj, size);
     while (data < dataend) {
+	/*
+	 * Decode pairs of digits directly, until something else turns up.
+	 */
+
+	while (data + 1 < dataend) {
+	    int hi = HexValues[data[0]], lo = HexValues[data[1]];
+
+	    if ((hi | lo) & 0x10) {
+		break;
+	    }
+	    *cursor++ = UCHAR((hi << 4) | lo);
+	    data += 2;
+	}
+	if (data >= dataend) {
+	    break;
+	}
+
 	value = 0;
 	for (i = 0 ; i < 2 ; i++) {
 	    if (data >= dataend) {
@@ -2528,7 +2967,7 @@ BinaryDecodeHex(
 	    }
 
 	    c = *data++;
-	    if (!isxdigit(UCHAR(c))) {
+	    if (HexValues[c] & 0x10) {
 		if (strict || !TclIsSpaceProc(c)) {
 		    goto badChar;
 		}
@@ -2536,15 +2975,7 @@ BinaryDecodeHex(
 		continue;
 	    }
 
-	    value <<= 4;
-	    c -= '0';
-	    if (c > 9) {
-		c += ('0' - 'A') + 10;
-	    }
-	    if (c > 16) {
-		c += ('A' - 'a');
-	    }
-	    value |= c & 0xF;
+	    value = (value << 4) | HexValues[c];
 	}
 	if (i < 2) {
 	    cut++;
@@ -2687,6 +3118,38 @@ BinaryEncode64(
 	for (offset = 0; offset < count; offset += 3) {
 	    unsigned char d[3] = {0, 0, 0};
 
+	    /*
+	     * Encode whole groups directly while no line break is due within
+	     * them.
+	     */
+
+	    if (maxlen == 0) {
+		for (; offset + 2 < count; offset += 3) {
+		    cursor[0] = B64Digits[data[offset] >> 2];
+		    cursor[1] = B64Digits[((data[offset] & 0x03) << 4)
+			    | (data[offset + 1] >> 4)];
+		    cursor[2] = B64Digits[((data[offset + 1] & 0x0F) << 2)
+			    | (data[offset + 2] >> 6)];
+		    cursor[3] = B64Digits[data[offset + 2] & 0x3F];
+		    cursor += 4;
+		}
+	    } else {
+		for (; offset + 2 < count && outindex + 4 < maxlen;
+			offset += 3) {
+		    cursor[0] = B64Digits[data[offset] >> 2];
+		    cursor[1] = B64Digits[((data[offset] & 0x03) << 4)
+			    | (data[offset + 1] >> 4)];
+		    cursor[2] = B64Digits[((data[offset + 1] & 0x0F) << 2)
+			    | (data[offset + 2] >> 6)];
+		    cursor[3] = B64Digits[data[offset + 2] & 0x3F];
+		    cursor += 4;
+		    outindex += 4;
+		}
+	    }
+	    if (offset >= count) {
+		break;
+	    }
+
 	    for (i = 0; i < 3 && offset + i < count; ++i) {
 		d[i] = data[offset + i];
 	    }
@@ -3101,6 +3564,30 @@ BinaryDecode64(
     while (data < dataend) {
 	unsigned long value = 0;
 
+	/*
+	 * Decode blocks of four base64 digits directly, until whitespace,
+	 * padding or anything else turns up.
+	 */
+
+	while (!cut && data + 3 < dataend) {
+	    unsigned v0 = B64Values[data[0]], v1 = B64Values[data[1]];
+	    unsigned v2 = B64Values[data[2]], v3 = B64Values[data[3]];
+
+	    if ((v0 | v1 | v2 | v3) & 0x40) {
+		break;
+	    }
+	    value = (v0 << 18) | (v1 << 12) | (v2 << 6) | v3;
+	    cursor[0] = UCHAR(value >> 16);
+	    cursor[1] = UCHAR(value >> 8);
+	    cursor[2] = UCHAR(value);
+	    cursor += 3;
+	    data += 4;
+	}
+	if (data >= dataend) {
+	    break;
+	}
+	value = 0;
+
 	/*
 	 * Decode the current block. Each base64 block consists of four input
 	 * characters A-Z, a-z, 0-9, +, or /. Each character supplies six bits
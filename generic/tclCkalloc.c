@@ -1019,6 +1019,17 @@ Tcl_InitMemory(
 #undef Tcl_DumpActiveMemory
 #undef Tcl_ValidateAllMemory
 
+/*
+ * Hooks for the allocation profiler, see TclAllocProfileObjCmd.
+ */
+
+#define PROFILE_ALLOC(ptr, size) \
+    if (tclAllocProfiling) TclAllocProfileAlloc((ptr), (size))
+#define PROFILE_REALLOC(oldPtr, newPtr, size) \
+    if (tclAllocProfiling) TclAllocProfileRealloc((oldPtr), (newPtr), (size))
+#define PROFILE_FREE(ptr) \
+    if (tclAllocProfiling) TclAllocProfileFree(ptr)
+
 
 /*
  *----------------------------------------------------------------------
@@ -1050,6 +1061,7 @@ Tcl_Alloc(
     if ((result == NULL) && size) {
 	Tcl_Panic("unable to alloc %" TCL_Z_MODIFIER "u bytes", size);
     }
+    PROFILE_ALLOC(result, size);
     return result;
 }
 
@@ -1066,6 +1078,7 @@ Tcl_DbCkalloc(
 	Tcl_Panic("unable to alloc %" TCL_Z_MODIFIER "u bytes, %s line %d",
 		size, file, line);
     }
+    PROFILE_ALLOC(result, size);
     return result;
 }
 
@@ -1084,7 +1097,10 @@ void *
 Tcl_AttemptAlloc(
     size_t size)
 {
-    return (char *)TclpAlloc(size);
+    void *result = TclpAlloc(size);
+
+    PROFILE_ALLOC(result, size);
+    return result;
 }
 
 void *
@@ -1093,7 +1109,10 @@ Tcl_AttemptDbCkalloc(
     TCL_UNUSED(const char *) /*file*/,
     TCL_UNUSED(int) /*line*/)
 {
-    return (char *)TclpAlloc(size);
+    void *result = TclpAlloc(size);
+
+    PROFILE_ALLOC(result, size);
+    return result;
 }
 
 /*
@@ -1117,6 +1136,7 @@ Tcl_Realloc(
     if ((result == NULL) && size) {
 	Tcl_Panic("unable to realloc %" TCL_Z_MODIFIER "u bytes", size);
     }
+    PROFILE_REALLOC(ptr, result, size);
     return result;
 }
 
@@ -1134,6 +1154,7 @@ Tcl_DbCkrealloc(
 	Tcl_Panic("unable to realloc %" TCL_Z_MODIFIER "u bytes, %s line %d",
 		size, file, line);
     }
+    PROFILE_REALLOC(ptr, result, size);
     return result;
 }
 
@@ -1153,7 +1174,10 @@ Tcl_AttemptRealloc(
     void *ptr,
     size_t size)
 {
-    return (char *)TclpRealloc(ptr, size);
+    void *result = TclpRealloc(ptr, size);
+
+    PROFILE_REALLOC(ptr, result, size);
+    return result;
 }
 
 void *
@@ -1163,7 +1187,10 @@ Tcl_AttemptDbCkrealloc(
     TCL_UNUSED(const char *) /*file*/,
     TCL_UNUSED(int) /*line*/)
 {
-    return (char *)TclpRealloc(ptr, size);
+    void *result = TclpRealloc(ptr, size);
+
+    PROFILE_REALLOC(ptr, result, size);
+    return result;
 }
 
 /*
@@ -1182,6 +1209,7 @@ void
 Tcl_Free(
     void *ptr)
 {
+    PROFILE_FREE(ptr);
     TclpFree(ptr);
 }
 
@@ -1191,6 +1219,7 @@ Tcl_DbCkfree(
     TCL_UNUSED(const char *) /*file*/,
     TCL_UNUSED(int) /*line*/)
 {
+    PROFILE_FREE(ptr);
     TclpFree(ptr);
 }
 
@@ -1421,6 +1450,720 @@ TclFinalizeMemorySubsystem(void)
 #endif
 }
 
+/*
+ * The following structures hold the state of the sampling allocation
+ * profiler behind [::tcl::unsupported::allocprofile]. Profiling is per
+ * thread: the thread that starts it counts the bytes it allocates through
+ * Tcl_Alloc and friends and through the Tcl_Obj allocator, and every
+ * "interval" bytes it records the Tcl call stack of the interpreter that
+ * started the profile. Sampled blocks are remembered until they are freed,
+ * so that the report can tell how much memory each call stack still
+ * retains. Nothing here takes a lock; a block freed by another thread than
+ * the one that allocated it stays counted as live.
+ */
+
+typedef struct AllocSite {
+    Tcl_WideInt samples;	/* Number of samples taken at this site. */
+    Tcl_WideInt weight;		/* Number of intervals those samples stand
+				 * for. */
+    Tcl_WideInt liveSamples;	/* Samples not freed yet. */
+    Tcl_WideInt liveWeight;	/* Intervals those live samples stand for. */
+} AllocSite;
+
+typedef struct LiveSample {
+    AllocSite *sitePtr;		/* Site the block was allocated at. */
+    Tcl_WideInt weight;		/* Number of intervals the sample stands
+				 * for. */
+} LiveSample;
+
+typedef struct {
+    Tcl_Interp *interp;		/* Interpreter whose call stacks are recorded,
+				 * or NULL when this thread does not
+				 * profile. */
+    int busy;			/* Set while the profiler itself runs, so
+				 * that its own allocations are not
+				 * sampled. */
+    Tcl_WideInt interval;	/* Bytes between two samples. */
+    Tcl_WideInt countdown;	/* Bytes left until the next sample. */
+    Tcl_WideInt allocated;	/* Total bytes allocated since start. */
+    long long start;		/* Time profiling started, in µs. */
+    Tcl_HashTable sites;	/* Call stack (string key) -> AllocSite. */
+    Tcl_HashTable live;		/* Sampled block -> LiveSample. */
+} ProfileData;
+
+static Tcl_ThreadDataKey profileKey;
+
+/*
+ * Number of threads that currently profile. The allocation hooks only look
+ * any further while this is non-zero.
+ */
+
+int tclAllocProfiling = 0;
+TCL_DECLARE_MUTEX(profileMutex)
+
+#define PROFILE_DEFAULT_INTERVAL	(512 * 1024)
+#define PROFILE_MAX_DEPTH		32
+#define PROFILE_MAX_STACK		2048
+
+static void		ProfileAppend(char *buf, size_t *lenPtr,
+			    const char *str);
+static void		ProfileCaptureStack(Interp *iPtr, char *buf);
+static void		ProfileForget(ProfileData *dataPtr, void *ptr);
+static void		ProfileInterpDeleted(void *clientData,
+			    Tcl_Interp *interp);
+static Tcl_Obj *	ProfileStackObj(const char *stack);
+static void		ProfileStop(ProfileData *dataPtr, int interpDeleted);
+static void		ProfileThreadExit(void *clientData);
+static int		SiteCompare(const void *a, const void *b);
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclAllocProfileAlloc, TclAllocProfileFree, TclAllocProfileRealloc --
+ *
+ *	Hooks called by the allocation routines whenever tclAllocProfiling
+ *	is non-zero. TclAllocProfileAlloc counts the bytes allocated by the
+ *	current thread and takes a sample of the Tcl call stack each time
+ *	another interval has been used up. TclAllocProfileFree drops a
+ *	sampled block from the live set. TclAllocProfileRealloc counts a
+ *	reallocated block like a new one, unless it was sampled already.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May update the profile of the current thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclAllocProfileAlloc(
+    void *ptr,			/* Block just allocated. */
+    size_t size)		/* Its size in bytes. */
+{
+    ProfileData *dataPtr = (ProfileData *)TclThreadDataKeyGet(&profileKey);
+    Tcl_WideInt weight;
+    Tcl_HashEntry *hPtr;
+    AllocSite *sitePtr;
+    LiveSample *samplePtr;
+    char stack[PROFILE_MAX_STACK];
+    int isNew;
+
+    if ((dataPtr == NULL) || (dataPtr->interp == NULL) || dataPtr->busy
+	    || (ptr == NULL)) {
+	return;
+    }
+    dataPtr->busy = 1;
+
+    /*
+     * A block at this address that is still in the live set must have been
+     * released in a way the hooks did not see; forget about it.
+     */
+
+    if (dataPtr->live.numEntries > 0) {
+	ProfileForget(dataPtr, ptr);
+    }
+
+    dataPtr->allocated += size;
+    dataPtr->countdown -= size;
+    if (dataPtr->countdown > 0) {
+	dataPtr->busy = 0;
+	return;
+    }
+
+    /*
+     * Large blocks may span several intervals; the sample stands for all of
+     * them.
+     */
+
+    weight = 1 + (-dataPtr->countdown) / dataPtr->interval;
+    dataPtr->countdown += weight * dataPtr->interval;
+
+    ProfileCaptureStack((Interp *) dataPtr->interp, stack);
+    hPtr = Tcl_CreateHashEntry(&dataPtr->sites, stack, &isNew);
+    if (isNew) {
+	sitePtr = (AllocSite *)Tcl_Alloc(sizeof(AllocSite));
+	memset(sitePtr, 0, sizeof(AllocSite));
+	Tcl_SetHashValue(hPtr, sitePtr);
+    } else {
+	sitePtr = (AllocSite *)Tcl_GetHashValue(hPtr);
+    }
+    sitePtr->samples++;
+    sitePtr->weight += weight;
+    sitePtr->liveSamples++;
+    sitePtr->liveWeight += weight;
+
+    samplePtr = (LiveSample *)Tcl_Alloc(sizeof(LiveSample));
+    samplePtr->sitePtr = sitePtr;
+    samplePtr->weight = weight;
+    hPtr = Tcl_CreateHashEntry(&dataPtr->live, ptr, &isNew);
+    Tcl_SetHashValue(hPtr, samplePtr);
+    dataPtr->busy = 0;
+}
+
+void
+TclAllocProfileFree(
+    void *ptr)			/* Block about to be freed. */
+{
+    ProfileData *dataPtr = (ProfileData *)TclThreadDataKeyGet(&profileKey);
+
+    if ((dataPtr == NULL) || (dataPtr->interp == NULL) || dataPtr->busy
+	    || (dataPtr->live.numEntries == 0)) {
+	return;
+    }
+    dataPtr->busy = 1;
+    ProfileForget(dataPtr, ptr);
+    dataPtr->busy = 0;
+}
+
+void
+TclAllocProfileRealloc(
+    void *oldPtr,		/* Block that was reallocated. */
+    void *newPtr,		/* Block now holding its contents. */
+    size_t size)		/* Its new size in bytes. */
+{
+    ProfileData *dataPtr = (ProfileData *)TclThreadDataKeyGet(&profileKey);
+    Tcl_HashEntry *hPtr;
+    void *samplePtr;
+    int isNew;
+
+    if ((dataPtr == NULL) || (dataPtr->interp == NULL) || dataPtr->busy
+	    || (newPtr == NULL)) {
+	return;
+    }
+    hPtr = (oldPtr && dataPtr->live.numEntries > 0)
+	    ? Tcl_FindHashEntry(&dataPtr->live, oldPtr) : NULL;
+    if (hPtr == NULL) {
+	TclAllocProfileAlloc(newPtr, size);
+	return;
+    }
+
+    /*
+     * A sampled block stays attributed to the call stack that allocated it
+     * when it grows or moves.
+     */
+
+    dataPtr->busy = 1;
+    dataPtr->allocated += size;
+    dataPtr->countdown -= size;
+    if (dataPtr->countdown <= 0) {
+	dataPtr->countdown = dataPtr->interval;
+    }
+    if (newPtr != oldPtr) {
+	samplePtr = Tcl_GetHashValue(hPtr);
+	Tcl_DeleteHashEntry(hPtr);
+	ProfileForget(dataPtr, newPtr);
+	hPtr = Tcl_CreateHashEntry(&dataPtr->live, newPtr, &isNew);
+	Tcl_SetHashValue(hPtr, samplePtr);
+    }
+    dataPtr->busy = 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ProfileForget --
+ *
+ *	Removes a block from the live set of a profile, if it is there.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Updates the live counters of the site the block was sampled at.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ProfileForget(
+    ProfileData *dataPtr,
+    void *ptr)
+{
+    Tcl_HashEntry *hPtr = Tcl_FindHashEntry(&dataPtr->live, ptr);
+    LiveSample *samplePtr;
+
+    if (hPtr == NULL) {
+	return;
+    }
+    samplePtr = (LiveSample *)Tcl_GetHashValue(hPtr);
+    samplePtr->sitePtr->liveSamples--;
+    samplePtr->sitePtr->liveWeight -= samplePtr->weight;
+    Tcl_Free(samplePtr);
+    Tcl_DeleteHashEntry(hPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ProfileCaptureStack --
+ *
+ *	Describes the current Tcl call stack of an interpreter as a string,
+ *	innermost call frame first, one "name line" pair per line. The name
+ *	is that of the procedure (or "apply" for lambdas), or of the
+ *	namespace for frames that do not belong to one; the line is that of
+ *	the command running in the frame, or 0 when unknown. This runs inside
+ *	the allocator, so it must not allocate memory itself.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Fills buf, which must hold PROFILE_MAX_STACK bytes.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ProfileAppend(
+    char *buf,
+    size_t *lenPtr,
+    const char *str)
+{
+    size_t n = strlen(str);
+
+    if (*lenPtr + n >= PROFILE_MAX_STACK) {
+	n = PROFILE_MAX_STACK - 1 - *lenPtr;
+    }
+    memcpy(buf + *lenPtr, str, n);
+    *lenPtr += n;
+    buf[*lenPtr] = '\0';
+}
+
+static void
+ProfileCaptureStack(
+    Interp *iPtr,
+    char *buf)
+{
+    CallFrame *framePtr;
+    CmdFrame *cfPtr = iPtr->cmdFramePtr, *cmdFramePtr;
+    CmdFrame *bcFramePtr = iPtr->execEnvPtr->tebcFramePtr;
+    size_t len = 0;
+    int depth = 0;
+    char lineBuf[TCL_INTEGER_SPACE + 2];
+
+    /*
+     * The frame of the executing bytecode is only of use here while it is
+     * not linked in, that is, while the bytecode is not calling out.
+     */
+
+    for (cmdFramePtr = cfPtr; cmdFramePtr != NULL;
+	    cmdFramePtr = cmdFramePtr->nextPtr) {
+	if (cmdFramePtr == bcFramePtr) {
+	    bcFramePtr = NULL;
+	    break;
+	}
+    }
+
+    buf[0] = '\0';
+    for (framePtr = iPtr->framePtr; (framePtr != NULL)
+	    && (depth < PROFILE_MAX_DEPTH);
+	    framePtr = framePtr->callerPtr, depth++) {
+	Proc *procPtr = framePtr->procPtr;
+	Tcl_Size line = 0;
+
+	if (depth > 0) {
+	    ProfileAppend(buf, &len, "\n");
+	}
+	if (procPtr == NULL) {
+	    ProfileAppend(buf, &len, framePtr->nsPtr->fullName);
+	} else if ((framePtr->isProcCallFrame & FRAME_IS_PROC)
+		&& !(framePtr->isProcCallFrame & (FRAME_IS_LAMBDA|FRAME_IS_METHOD))
+		&& (framePtr->objc > 0) && (framePtr->objv[0]->bytes != NULL)) {
+	    /*
+	     * Name procedures after the word they were called by, qualified
+	     * with their namespace. Their command may be gone already while
+	     * they run, e.g. in a suspended coroutine, so procPtr->cmdPtr is
+	     * not safe to look at. The string rep is only used when present;
+	     * generating one may be what allocates right now.
+	     */
+
+	    const char *name = framePtr->objv[0]->bytes;
+	    const char *p = name + framePtr->objv[0]->length;
+
+	    while (--p > name) {
+		if ((p[0] == ':') && (p[-1] == ':')) {
+		    p++;		/* Just after the last "::" */
+		    break;
+		}
+	    }
+	    if (framePtr->nsPtr != iPtr->globalNsPtr) {
+		ProfileAppend(buf, &len, framePtr->nsPtr->fullName);
+	    }
+	    ProfileAppend(buf, &len, "::");
+	    if (p >= name) {
+		ProfileAppend(buf, &len, p);
+	    }
+	} else {
+	    ProfileAppend(buf, &len, "apply");
+	}
+
+	/*
+	 * The line comes from the command frame running in this call frame,
+	 * if any. Bytecode only links its command frame in while it invokes a
+	 * command, so for the innermost procedure it is usually the frame of
+	 * the bytecode executing right now, kept by the execution environment.
+	 */
+
+	for (cmdFramePtr = cfPtr; cmdFramePtr != NULL;
+		cmdFramePtr = cmdFramePtr->nextPtr) {
+	    if (cmdFramePtr->framePtr == framePtr) {
+		break;
+	    }
+	}
+	if (cmdFramePtr != NULL) {
+	    cfPtr = cmdFramePtr->nextPtr;
+	}
+	if ((bcFramePtr != NULL) && (bcFramePtr->framePtr == framePtr)) {
+	    cmdFramePtr = bcFramePtr;
+	    bcFramePtr = NULL;
+	}
+	if (cmdFramePtr != NULL) {
+	    switch (cmdFramePtr->type) {
+	    case TCL_LOCATION_BC:
+		if (cmdFramePtr->data.tebc.pc != NULL) {
+		    CmdFrame frame = *cmdFramePtr;
+
+		    /*
+		     * Same as [info frame]: let the bytecode engine map the pc
+		     * to the command and its line.
+		     */
+
+		    TclGetSrcInfoForPc(&frame);
+		    if (frame.line != NULL) {
+			line = frame.line[0];
+		    }
+		    if (frame.type == TCL_LOCATION_SOURCE) {
+			Tcl_DecrRefCount(frame.data.eval.path);
+		    }
+		}
+		break;
+	    case TCL_LOCATION_EVAL:
+	    case TCL_LOCATION_SOURCE:
+		if (cmdFramePtr->line != NULL) {
+		    line = cmdFramePtr->line[0];
+		}
+		break;
+	    }
+	}
+	snprintf(lineBuf, sizeof(lineBuf), " %" TCL_SIZE_MODIFIER "d", line);
+	ProfileAppend(buf, &len, lineBuf);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ProfileStackObj --
+ *
+ *	Turns a call stack recorded by ProfileCaptureStack into a list of
+ *	{name line} pairs.
+ *
+ * Results:
+ *	A new list object.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Obj *
+ProfileStackObj(
+    const char *stack)
+{
+    Tcl_Obj *listPtr, *framePtr[2];
+    const char *end, *space;
+
+    TclNewObj(listPtr);
+    while (*stack != '\0') {
+	end = strchr(stack, '\n');
+	if (end == NULL) {
+	    end = stack + strlen(stack);
+	}
+	for (space = end; (space > stack) && (space[-1] != ' '); space--) {
+	    /* Empty loop body. */
+	}
+	if (space > stack) {
+	    framePtr[0] = Tcl_NewStringObj(stack, space - 1 - stack);
+	} else {
+	    TclNewObj(framePtr[0]);
+	}
+	framePtr[1] = Tcl_NewStringObj(space, end - space);
+	Tcl_ListObjAppendElement(NULL, listPtr, Tcl_NewListObj(2, framePtr));
+	stack = (*end == '\n') ? end + 1 : end;
+    }
+    return listPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ProfileStop --
+ *
+ *	Ends profiling in the current thread and discards what it recorded.
+ *	When called because the interpreter is being deleted, its deletion
+ *	callback is already being run and must not be removed here.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees the tables of the profile.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ProfileStop(
+    ProfileData *dataPtr,
+    int interpDeleted)		/* Whether the profiled interpreter is being
+				 * deleted. */
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    if (dataPtr->interp == NULL) {
+	return;
+    }
+    if (!interpDeleted) {
+	Tcl_DontCallWhenDeleted(dataPtr->interp, ProfileInterpDeleted, NULL);
+    }
+    Tcl_DeleteThreadExitHandler(ProfileThreadExit, NULL);
+    dataPtr->interp = NULL;
+    Tcl_MutexLock(&profileMutex);
+    tclAllocProfiling--;
+    Tcl_MutexUnlock(&profileMutex);
+
+    dataPtr->busy = 1;
+    for (hPtr = Tcl_FirstHashEntry(&dataPtr->live, &search); hPtr != NULL;
+	    hPtr = Tcl_NextHashEntry(&search)) {
+	Tcl_Free(Tcl_GetHashValue(hPtr));
+    }
+    Tcl_DeleteHashTable(&dataPtr->live);
+    for (hPtr = Tcl_FirstHashEntry(&dataPtr->sites, &search); hPtr != NULL;
+	    hPtr = Tcl_NextHashEntry(&search)) {
+	Tcl_Free(Tcl_GetHashValue(hPtr));
+    }
+    Tcl_DeleteHashTable(&dataPtr->sites);
+    dataPtr->busy = 0;
+}
+
+static void
+ProfileInterpDeleted(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp)
+{
+    ProfileData *dataPtr = (ProfileData *)TclThreadDataKeyGet(&profileKey);
+
+    if ((dataPtr != NULL) && (dataPtr->interp == interp)) {
+	ProfileStop(dataPtr, 1);
+    }
+}
+
+static void
+ProfileThreadExit(
+    TCL_UNUSED(void *))
+{
+    ProfileData *dataPtr = (ProfileData *)TclThreadDataKeyGet(&profileKey);
+
+    if (dataPtr != NULL) {
+	ProfileStop(dataPtr, 0);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclAllocProfileObjCmd --
+ *
+ *	Implements [::tcl::unsupported::allocprofile start ?interval?],
+ *	[... stop] and [... report]. "start" (re)starts sampling the current
+ *	thread every interval bytes allocated, recording the call stacks of
+ *	the current interpreter; "stop" ends it. "report" returns what was
+ *	recorded as a dictionary, with one entry per call stack in "sites",
+ *	largest retained size first. Byte counts of sites are estimates: the
+ *	number of intervals their samples stand for times the interval.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See above.
+ *
+ *----------------------------------------------------------------------
+ */
+
+typedef struct {
+    const char *stack;
+    AllocSite site;
+} SiteReport;
+
+static int
+SiteCompare(
+    const void *a,
+    const void *b)
+{
+    const SiteReport *r1 = (const SiteReport *)a;
+    const SiteReport *r2 = (const SiteReport *)b;
+
+    if (r1->site.liveWeight != r2->site.liveWeight) {
+	return (r1->site.liveWeight < r2->site.liveWeight) ? 1 : -1;
+    }
+    if (r1->site.weight != r2->site.weight) {
+	return (r1->site.weight < r2->site.weight) ? 1 : -1;
+    }
+    return strcmp(r1->stack, r2->stack);
+}
+
+int
+TclAllocProfileObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    static const char *const options[] = {
+	"report", "start", "stop", NULL
+    };
+    enum options {
+	PROF_REPORT, PROF_START, PROF_STOP
+    } index;
+    ProfileData *dataPtr;
+    Tcl_WideInt interval = PROFILE_DEFAULT_INTERVAL, liveWeight = 0;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    SiteReport *reports;
+    Tcl_Obj *dictPtr, *sitesPtr, *sitePtr;
+    Tcl_Size i, n;
+
+    if (objc < 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "option ?arg?");
+	return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], options, "option", 0,
+	    &index) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    dataPtr = (ProfileData *)Tcl_GetThreadData(&profileKey,
+	    sizeof(ProfileData));
+
+    switch (index) {
+    case PROF_START:
+#ifdef TCL_MEM_DEBUG
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"allocation profiling is not available with TCL_MEM_DEBUG",
+		-1));
+	Tcl_SetErrorCode(interp, "TCL", "UNSUPPORTED", (char *)NULL);
+	return TCL_ERROR;
+#else
+	if (objc > 3) {
+	    Tcl_WrongNumArgs(interp, 2, objv, "?interval?");
+	    return TCL_ERROR;
+	}
+	if ((objc == 3) && (Tcl_GetWideIntFromObj(interp, objv[2],
+		&interval) != TCL_OK)) {
+	    return TCL_ERROR;
+	}
+	if (interval < 1) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "bad interval \"%s\": must be a positive integer",
+		    TclGetString(objv[2])));
+	    Tcl_SetErrorCode(interp, "TCL", "VALUE", "INTERVAL", (char *)NULL);
+	    return TCL_ERROR;
+	}
+	ProfileStop(dataPtr, 0);
+	dataPtr->busy = 1;
+	Tcl_InitHashTable(&dataPtr->sites, TCL_STRING_KEYS);
+	Tcl_InitHashTable(&dataPtr->live, TCL_ONE_WORD_KEYS);
+	dataPtr->interval = interval;
+	dataPtr->countdown = interval;
+	dataPtr->allocated = 0;
+	dataPtr->start = TclpGetMicroseconds();
+	Tcl_CallWhenDeleted(interp, ProfileInterpDeleted, NULL);
+	Tcl_CreateThreadExitHandler(ProfileThreadExit, NULL);
+	dataPtr->interp = interp;
+	dataPtr->busy = 0;
+	Tcl_MutexLock(&profileMutex);
+	tclAllocProfiling++;
+	Tcl_MutexUnlock(&profileMutex);
+	return TCL_OK;
+#endif /* TCL_MEM_DEBUG */
+
+    case PROF_STOP:
+	if (objc != 2) {
+	    Tcl_WrongNumArgs(interp, 2, objv, NULL);
+	    return TCL_ERROR;
+	}
+	ProfileStop(dataPtr, 0);
+	return TCL_OK;
+
+    case PROF_REPORT:
+	break;
+    }
+
+    if (objc != 2) {
+	Tcl_WrongNumArgs(interp, 2, objv, NULL);
+	return TCL_ERROR;
+    }
+    TclNewObj(dictPtr);
+    if (dataPtr->interp == NULL) {
+	Tcl_SetObjResult(interp, dictPtr);
+	return TCL_OK;
+    }
+
+    /*
+     * Building the result allocates; keep the profiler out of it and sort a
+     * snapshot of the sites.
+     */
+
+    dataPtr->busy = 1;
+    n = dataPtr->sites.numEntries;
+    reports = (SiteReport *)Tcl_Alloc((n + 1) * sizeof(SiteReport));
+    i = 0;
+    for (hPtr = Tcl_FirstHashEntry(&dataPtr->sites, &search); hPtr != NULL;
+	    hPtr = Tcl_NextHashEntry(&search)) {
+	reports[i].stack = (const char *)Tcl_GetHashKey(&dataPtr->sites,
+		hPtr);
+	reports[i].site = *(AllocSite *)Tcl_GetHashValue(hPtr);
+	liveWeight += reports[i].site.liveWeight;
+	i++;
+    }
+    qsort(reports, n, sizeof(SiteReport), SiteCompare);
+    interval = dataPtr->interval;
+
+#define REPORT_PUT(dict, name, valuePtr) \
+    Tcl_DictObjPut(NULL, (dict), Tcl_NewStringObj(name, -1), (valuePtr))
+
+    REPORT_PUT(dictPtr, "interval", Tcl_NewWideIntObj(interval));
+    REPORT_PUT(dictPtr, "elapsed",
+	    Tcl_NewWideIntObj(TclpGetMicroseconds() - dataPtr->start));
+    REPORT_PUT(dictPtr, "allocated", Tcl_NewWideIntObj(dataPtr->allocated));
+    REPORT_PUT(dictPtr, "live", Tcl_NewWideIntObj(liveWeight * interval));
+    TclNewObj(sitesPtr);
+    for (i = 0; i < n; i++) {
+	TclNewObj(sitePtr);
+	REPORT_PUT(sitePtr, "stack", ProfileStackObj(reports[i].stack));
+	REPORT_PUT(sitePtr, "samples",
+		Tcl_NewWideIntObj(reports[i].site.samples));
+	REPORT_PUT(sitePtr, "bytes",
+		Tcl_NewWideIntObj(reports[i].site.weight * interval));
+	REPORT_PUT(sitePtr, "liveSamples",
+		Tcl_NewWideIntObj(reports[i].site.liveSamples));
+	REPORT_PUT(sitePtr, "liveBytes",
+		Tcl_NewWideIntObj(reports[i].site.liveWeight * interval));
+	Tcl_ListObjAppendElement(NULL, sitesPtr, sitePtr);
+    }
+    REPORT_PUT(dictPtr, "sites", sitesPtr);
+#undef REPORT_PUT
+
+    Tcl_Free(reports);
+    dataPtr->busy = 0;
+    Tcl_SetObjResult(interp, dictPtr);
+    return TCL_OK;
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -24,6 +24,8 @@
 
 static inline Tcl_Obj *	During(Tcl_Interp *interp, int resultCode,
 			    Tcl_Obj *oldOptions, Tcl_Obj *errorInfo);
+static Tcl_Obj *	NewRegsubResult(const Tcl_UniChar *wstring,
+			    Tcl_DString *dsPtr);
 static Tcl_NRPostProc	SwitchPostProc;
 static Tcl_NRPostProc	TryPostBody;
 static Tcl_NRPostProc	TryPostFinal;
@@ -132,19 +134,21 @@ Tcl_RegexpObjCmd(
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
     Tcl_Size offset, stringLength, matchLength, cflags, eflags;
-    int i, indices, match, about, all, doinline, numMatchesSaved;
+    int i, indices, match, about, all, doinline, multi, numMatchesSaved;
     Tcl_RegExp regExpr;
     Tcl_Obj *objPtr, *startIndex = NULL, *resultPtr = NULL;
     Tcl_RegExpInfo info;
+    Tcl_DString ds;
+    const Tcl_UniChar *chars = NULL;
     static const char *const options[] = {
 	"-all",		"-about",	"-indices",	"-inline",
 	"-expanded",	"-line",	"-linestop",	"-lineanchor",
-	"-nocase",	"-start",	"--",		NULL
+	"-multi",	"-nocase",	"-start",	"--",		NULL
     };
     enum regexpoptions {
 	REGEXP_ALL,	REGEXP_ABOUT,	REGEXP_INDICES,	REGEXP_INLINE,
 	REGEXP_EXPANDED,REGEXP_LINE,	REGEXP_LINESTOP,REGEXP_LINEANCHOR,
-	REGEXP_NOCASE,	REGEXP_START,	REGEXP_LAST
+	REGEXP_MULTI,	REGEXP_NOCASE,	REGEXP_START,	REGEXP_LAST
     } index;
 
     indices = 0;
@@ -153,6 +157,7 @@ Tcl_RegexpObjCmd(
     offset = TCL_INDEX_START;
     all = 0;
     doinline = 0;
+    multi = 0;
 
     for (i = 1; i < objc; i++) {
 	const char *name;
@@ -193,6 +198,9 @@ Tcl_RegexpObjCmd(
 	case REGEXP_LINEANCHOR:
 	    cflags |= TCL_REG_NLANCH;
 	    break;
+	case REGEXP_MULTI:
+	    multi = 1;
+	    break;
 	case REGEXP_START: {
 	    Tcl_Size temp;
 	    if (++i >= objc) {
@@ -236,6 +244,23 @@ Tcl_RegexpObjCmd(
 	goto optionError;
     }
 
+    /*
+     * With -multi, exp is a list of patterns and the result says which of
+     * them match; the options that deal with a single match make no sense.
+     */
+
+    if (multi) {
+	if (about || all || indices || doinline || startIndex || objc != 2) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "regexp -multi cannot be used with -about, -all, -indices,"
+		    " -inline, -start or match variables", -1));
+	    Tcl_SetErrorCode(interp, "TCL", "OPERATION", "REGEXP",
+		    "MULTI", (void *)NULL);
+	    goto optionError;
+	}
+	return TclRegExpMatchSet(interp, objv[0], objv[1], (int) cflags);
+    }
+
     /*
      * Handle the odd about case separately.
      */
@@ -274,6 +299,18 @@ Tcl_RegexpObjCmd(
 	return TCL_ERROR;
     }
 
+    /*
+     * A large value that is not already held as Unicode is converted just
+     * once into a private copy, which all matches and match ranges are taken
+     * from. The value's own Unicode rep cannot be used like that, since it
+     * might be lost to shimmering by traces on the match variables.
+     */
+
+    chars = TclGetRegExpSubject(objPtr, &ds, &stringLength);
+    if (Tcl_DStringLength(&ds) == 0) {
+	chars = NULL;
+    }
+
     objc -= 2;
     objv += 2;
 
@@ -313,15 +350,22 @@ Tcl_RegexpObjCmd(
 	    eflags = 0;
 	} else if (offset > stringLength) {
 	    eflags = TCL_REG_NOTBOL;
-	} else if (Tcl_GetUniChar(objPtr, offset-1) == '\n') {
+	} else if ((chars ? chars[offset-1]
+		: Tcl_GetUniChar(objPtr, offset-1)) == '\n') {
 	    eflags = 0;
 	} else {
 	    eflags = TCL_REG_NOTBOL;
 	}
 
-	match = Tcl_RegExpExecObj(interp, regExpr, objPtr, offset,
-		numMatchesSaved, eflags);
+	if (chars != NULL) {
+	    match = TclRegExpExecChars(interp, regExpr, objPtr, chars,
+		    stringLength, offset, numMatchesSaved, eflags);
+	} else {
+	    match = Tcl_RegExpExecObj(interp, regExpr, objPtr, offset,
+		    numMatchesSaved, eflags);
+	}
 	if (match < 0) {
+	    Tcl_DStringFree(&ds);
 	    return TCL_ERROR;
 	}
 
@@ -341,6 +385,7 @@ Tcl_RegexpObjCmd(
 		if (!doinline) {
 		    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(0));
 		}
+		Tcl_DStringFree(&ds);
 		return TCL_OK;
 	    }
 	    break;
@@ -398,9 +443,16 @@ Tcl_RegexpObjCmd(
 		newPtr = Tcl_NewListObj(2, objs);
 	    } else {
 		if ((i <= (int)info.nsubs) && (info.matches[i].end > 0)) {
-		    newPtr = Tcl_GetRange(objPtr,
-			    offset + info.matches[i].start,
-			    offset + info.matches[i].end - 1);
+		    if (chars != NULL) {
+			TclNewObj(newPtr);
+			Tcl_AppendUnicodeToObj(newPtr,
+				chars + offset + info.matches[i].start,
+				info.matches[i].end - info.matches[i].start);
+		    } else {
+			newPtr = Tcl_GetRange(objPtr,
+				offset + info.matches[i].start,
+				offset + info.matches[i].end - 1);
+		    }
 		} else {
 		    TclNewObj(newPtr);
 		}
@@ -410,11 +462,13 @@ Tcl_RegexpObjCmd(
 			!= TCL_OK) {
 		    Tcl_DecrRefCount(newPtr);
 		    Tcl_DecrRefCount(resultPtr);
+		    Tcl_DStringFree(&ds);
 		    return TCL_ERROR;
 		}
 	    } else {
 		if (Tcl_ObjSetVar2(interp, objv[i], NULL, newPtr,
 			TCL_LEAVE_ERR_MSG) == NULL) {
+		    Tcl_DStringFree(&ds);
 		    return TCL_ERROR;
 		}
 	    }
@@ -458,6 +512,7 @@ Tcl_RegexpObjCmd(
      * through the while - 1).
      */
 
+    Tcl_DStringFree(&ds);
     if (doinline) {
 	Tcl_SetObjResult(interp, resultPtr);
     } else {
@@ -497,6 +552,7 @@ Tcl_RegsubObjCmd(
     Tcl_RegExpInfo info;
     Tcl_Obj *resultPtr, *subPtr, *objPtr, *startIndex = NULL;
     Tcl_UniChar ch, *wsrc, *wfirstChar, *wstring, *wsubspec = 0, *wend;
+    Tcl_DString ds;
 
     static const char *const options[] = {
 	"-all",		"-command",	"-expanded",	"-line",
@@ -514,6 +570,7 @@ Tcl_RegsubObjCmd(
     offset = TCL_INDEX_START;
     command = 0;
     resultPtr = NULL;
+    Tcl_DStringInit(&ds);
 
     for (idx = 1; idx < objc; idx++) {
 	const char *name;
@@ -611,7 +668,7 @@ Tcl_RegsubObjCmd(
 	strCmpFn = nocase ? TclUniCharNcasecmp : TclUniCharNcmp;
 
 	wsrc = Tcl_GetUnicodeFromObj(objv[0], &slen);
-	wstring = Tcl_GetUnicodeFromObj(objv[1], &wlen);
+	wstring = (Tcl_UniChar *) TclGetRegExpSubject(objv[1], &ds, &wlen);
 	wsubspec = Tcl_GetUnicodeFromObj(objv[2], &wsublen);
 	wend = wstring + wlen - (slen ? slen - 1 : 0);
 	result = TCL_OK;
@@ -623,7 +680,7 @@ Tcl_RegsubObjCmd(
 	     */
 
 	    if (wstring < wend) {
-		resultPtr = Tcl_NewUnicodeObj(wstring, 0);
+		resultPtr = NewRegsubResult(wstring, &ds);
 		Tcl_IncrRefCount(resultPtr);
 		for (; wstring < wend; wstring++) {
 		    Tcl_AppendUnicodeToObj(resultPtr, wsubspec, wsublen);
@@ -639,7 +696,7 @@ Tcl_RegsubObjCmd(
 			(nocase && Tcl_UniCharToLower(*wstring)==wsrclc)) &&
 			(slen==1 || (strCmpFn(wstring, wsrc, slen) == 0))) {
 		    if (numMatches == 0) {
-			resultPtr = Tcl_NewUnicodeObj(wstring, 0);
+			resultPtr = NewRegsubResult(wstring, &ds);
 			Tcl_IncrRefCount(resultPtr);
 		    }
 		    if (p != wstring) {
@@ -702,7 +759,7 @@ Tcl_RegsubObjCmd(
     } else {
 	objPtr = objv[1];
     }
-    wstring = Tcl_GetUnicodeFromObj(objPtr, &wlen);
+    wstring = (Tcl_UniChar *) TclGetRegExpSubject(objPtr, &ds, &wlen);
     if (objv[2] == objv[0]) {
 	subPtr = Tcl_DuplicateObj(objv[2]);
     } else {
@@ -732,8 +789,8 @@ Tcl_RegsubObjCmd(
 	 * that "^" won't match.
 	 */
 
-	match = Tcl_RegExpExecObj(interp, regExpr, objPtr, offset,
-		10 /* matches */, ((offset > 0 &&
+	match = TclRegExpExecChars(interp, regExpr, objPtr, wstring, wlen,
+		offset, 10 /* matches */, ((offset > 0 &&
 		(wstring[offset-1] != (Tcl_UniChar)'\n'))
 		? TCL_REG_NOTBOL : 0));
 
@@ -745,7 +802,7 @@ Tcl_RegsubObjCmd(
 	    break;
 	}
 	if (numMatches == 0) {
-	    resultPtr = Tcl_NewUnicodeObj(wstring, 0);
+	    resultPtr = NewRegsubResult(wstring, &ds);
 	    Tcl_IncrRefCount(resultPtr);
 	    if (offset > TCL_INDEX_START) {
 		/*
@@ -826,10 +883,12 @@ Tcl_RegsubObjCmd(
 
 	    /*
 	     * Refetch the unicode, in case the representation was smashed by
-	     * the user code.
+	     * the user code. A private copy is safe from that.
 	     */
 
-	    wstring = Tcl_GetUnicodeFromObj(objPtr, &wlen);
+	    if (Tcl_DStringLength(&ds) == 0) {
+		wstring = Tcl_GetUnicodeFromObj(objPtr, &wlen);
+	    }
 
 	    offset += end;
 	    if (end == 0 || start == end) {
@@ -974,6 +1033,7 @@ Tcl_RegsubObjCmd(
     }
 
   done:
+    Tcl_DStringFree(&ds);
     if (objPtr && (objv[1] == objv[0])) {
 	Tcl_DecrRefCount(objPtr);
     }
@@ -986,6 +1046,39 @@ Tcl_RegsubObjCmd(
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * NewRegsubResult --
+ *
+ *	Creates the value that [regsub] builds its result in. When the
+ *	subject was converted into a private copy because it is large, the
+ *	result is built as UTF-8 so that it does not get a Unicode rep the
+ *	subject was spared.
+ *
+ * Results:
+ *	A new, empty value.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Obj *
+NewRegsubResult(
+    const Tcl_UniChar *wstring,	/* Characters of the subject. */
+    Tcl_DString *dsPtr)		/* Holds them, if they are a private copy. */
+{
+    Tcl_Obj *resultPtr;
+
+    if (Tcl_DStringLength(dsPtr) > 0) {
+	TclNewObj(resultPtr);
+	return resultPtr;
+    }
+    return Tcl_NewUnicodeObj(wstring, 0);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1954,11 +2047,9 @@ StringMapCmd(
     int objc,			/* Number of arguments. */
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
-    Tcl_Size length1, length2,  mapElemc, index;
-    int nocase = 0, mapWithDict = 0, copySource = 0;
-    Tcl_Obj **mapElemv, *sourceObj, *resultPtr;
-    Tcl_UniChar *ustring1, *ustring2, *p, *end;
-    int (*strCmpFn)(const Tcl_UniChar*, const Tcl_UniChar*, size_t);
+    Tcl_Size length2;
+    int nocase = 0;
+    Tcl_Obj *resultPtr;
 
     if (objc < 3 || objc > 4) {
 	Tcl_WrongNumArgs(interp, 1, objv, "?-nocase? charMap string");
@@ -1980,231 +2071,14 @@ StringMapCmd(
 	}
     }
 
-    /*
-     * This test is tricky, but has to be that way or you get other strange
-     * inconsistencies (see test string-10.20.1 for illustration why!)
-     */
-
-    if (!TclHasStringRep(objv[objc-2])
-	    && TclHasInternalRep(objv[objc-2], &tclDictType)) {
-	Tcl_Size i;
-	int done;
-	Tcl_DictSearch search;
-
-	/*
-	 * We know the type exactly, so all dict operations will succeed for
-	 * sure. This shortens this code quite a bit.
-	 */
-
-	Tcl_DictObjSize(interp, objv[objc-2], &i);
-	if (i == 0) {
-	    /*
-	     * Empty charMap, just return whatever string was given.
-	     */
-
-	    Tcl_SetObjResult(interp, objv[objc-1]);
-	    return TCL_OK;
-	}
-
-	mapElemc = 2 * i;
-	mapWithDict = 1;
-
-	/*
-	 * Copy the dictionary out into an array; that's the easiest way to
-	 * adapt this code...
-	 */
-
-	mapElemv = (Tcl_Obj **)TclStackAlloc(interp, sizeof(Tcl_Obj *) * mapElemc);
-	Tcl_DictObjFirst(interp, objv[objc-2], &search, mapElemv+0,
-		mapElemv+1, &done);
-	for (index=2 ; index<mapElemc ; index+=2) {
-	    Tcl_DictObjNext(&search, mapElemv+index, mapElemv+index+1, &done);
-	}
-	Tcl_DictObjDone(&search);
-    } else {
-	Tcl_Size i;
-	if (TclListObjGetElements(interp, objv[objc-2], &i,
-		&mapElemv) != TCL_OK) {
-	    return TCL_ERROR;
-	}
-	mapElemc = i;
-	if (mapElemc == 0) {
-	    /*
-	     * empty charMap, just return whatever string was given.
-	     */
-
-	    Tcl_SetObjResult(interp, objv[objc-1]);
-	    return TCL_OK;
-	} else if (mapElemc & 1) {
-	    /*
-	     * The charMap must be an even number of key/value items.
-	     */
-
-	    Tcl_SetObjResult(interp,
-		    Tcl_NewStringObj("char map list unbalanced", -1));
-	    Tcl_SetErrorCode(interp, "TCL", "OPERATION", "MAP",
-		    "UNBALANCED", (void *)NULL);
-	    return TCL_ERROR;
-	}
-    }
-
-    /*
-     * Take a copy of the source string object if it is the same as the map
-     * string to cut out nasty sharing crashes. [Bug 1018562]
-     */
-
-    if (objv[objc-2] == objv[objc-1]) {
-	sourceObj = Tcl_DuplicateObj(objv[objc-1]);
-	copySource = 1;
-    } else {
-	sourceObj = objv[objc-1];
-    }
-    ustring1 = Tcl_GetUnicodeFromObj(sourceObj, &length1);
-    if (length1 == 0) {
-	/*
-	 * Empty input string, just stop now.
-	 */
-
-	goto done;
-    }
-    end = ustring1 + length1;
-
-    strCmpFn = nocase ? TclUniCharNcasecmp : TclUniCharNcmp;
-
-    /*
-     * Force result to be Unicode
-     */
-
-    resultPtr = Tcl_NewUnicodeObj(ustring1, 0);
-
-    if (mapElemc == 2) {
-	/*
-	 * Special case for one map pair which avoids the extra for loop and
-	 * extra calls to get Unicode data. The algorithm is otherwise
-	 * identical to the multi-pair case. This will be >30% faster on
-	 * larger strings.
-	 */
-
-	Tcl_Size mapLen;
-	int u2lc;
-	Tcl_UniChar *mapString;
-
-	ustring2 = Tcl_GetUnicodeFromObj(mapElemv[0], &length2);
-	p = ustring1;
-	if ((length2 > length1) || (length2 == 0)) {
-	    /*
-	     * Match string is either longer than input or empty.
-	     */
-
-	    ustring1 = end;
-	} else {
-	    mapString = Tcl_GetUnicodeFromObj(mapElemv[1], &mapLen);
-	    u2lc = (nocase ? Tcl_UniCharToLower(*ustring2) : 0);
-	    for (; ustring1 < end; ustring1++) {
-		if (((*ustring1 == *ustring2) ||
-			(nocase&&Tcl_UniCharToLower(*ustring1)==u2lc)) &&
-			(length2==1 || strCmpFn(ustring1, ustring2,
-				length2) == 0)) {
-		    if (p != ustring1) {
-			Tcl_AppendUnicodeToObj(resultPtr, p, ustring1-p);
-			p = ustring1 + length2;
-		    } else {
-			p += length2;
-		    }
-		    ustring1 = p - 1;
-
-		    Tcl_AppendUnicodeToObj(resultPtr, mapString, mapLen);
-		}
-	    }
-	}
-    } else {
-	Tcl_UniChar **mapStrings;
-	Tcl_Size *mapLens;
-	int *u2lc = 0;
-
-	/*
-	 * Precompute pointers to the Unicode string and length. This saves us
-	 * repeated function calls later, significantly speeding up the
-	 * algorithm. We only need the lowercase first char in the nocase
-	 * case.
-	 */
-
-	mapStrings = (Tcl_UniChar **)TclStackAlloc(interp, mapElemc*sizeof(Tcl_UniChar *)*2);
-	mapLens = (Tcl_Size *)TclStackAlloc(interp, mapElemc * sizeof(Tcl_Size) * 2);
-	if (nocase) {
-	    u2lc = (int *)TclStackAlloc(interp, mapElemc * sizeof(int));
-	}
-	for (index = 0; index < mapElemc; index++) {
-	    mapStrings[index] = Tcl_GetUnicodeFromObj(mapElemv[index],
-		    mapLens+index);
-	    if (nocase && ((index % 2) == 0)) {
-		u2lc[index/2] = Tcl_UniCharToLower(*mapStrings[index]);
-	    }
-	}
-	for (p = ustring1; ustring1 < end; ustring1++) {
-	    for (index = 0; index < mapElemc; index += 2) {
-		/*
-		 * Get the key string to match on.
-		 */
-
-		ustring2 = mapStrings[index];
-		length2 = mapLens[index];
-		if ((length2 > 0) && ((*ustring1 == *ustring2) || (nocase &&
-			(Tcl_UniCharToLower(*ustring1) == u2lc[index/2]))) &&
-			/* Restrict max compare length. */
-			((end-ustring1) >= length2) && ((length2 == 1) ||
-			!strCmpFn(ustring2, ustring1, length2))) {
-		    if (p != ustring1) {
-			/*
-			 * Put the skipped chars onto the result first.
-			 */
-
-			Tcl_AppendUnicodeToObj(resultPtr, p, ustring1-p);
-			p = ustring1 + length2;
-		    } else {
-			p += length2;
-		    }
-
-		    /*
-		     * Adjust len to be full length of matched string.
-		     */
-
-		    ustring1 = p - 1;
-
-		    /*
-		     * Append the map value to the Unicode string.
-		     */
-
-		    Tcl_AppendUnicodeToObj(resultPtr,
-			    mapStrings[index+1], mapLens[index+1]);
-		    break;
-		}
-	    }
-	}
-	if (nocase) {
-	    TclStackFree(interp, u2lc);
-	}
-	TclStackFree(interp, mapLens);
-	TclStackFree(interp, mapStrings);
-    }
-    if (p != ustring1) {
-	/*
-	 * Put the rest of the unmapped chars onto result.
-	 */
-
-	Tcl_AppendUnicodeToObj(resultPtr, p, ustring1 - p);
+    resultPtr = TclStringMap(interp, objv[objc-2], objv[objc-1], nocase);
+    if (resultPtr == NULL) {
+	return TCL_ERROR;
     }
     Tcl_SetObjResult(interp, resultPtr);
-  done:
-    if (mapWithDict) {
-	TclStackFree(interp, mapElemv);
-    }
-    if (copySource) {
-	Tcl_DecrRefCount(sourceObj);
-    }
     return TCL_OK;
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
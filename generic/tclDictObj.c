@@ -669,7 +669,11 @@ SetDictFromAny(
 	    }
 
 	    if (literal) {
-		TclNewStringObj(keyPtr, elemStart, elemSize);
+		if (!tclInterning
+			|| !(keyPtr = TclInternObj(elemStart, elemSize))
+			|| (keyPtr == objPtr)) {
+		    TclNewStringObj(keyPtr, elemStart, elemSize);
+		}
 	    } else {
 		/* Avoid double copy */
 		char *dst;
@@ -684,12 +688,16 @@ SetDictFromAny(
 
 	    if (TclFindDictElement(interp, nextElem, (limit - nextElem),
 		    &elemStart, &nextElem, &elemSize, &literal) != TCL_OK) {
-		TclDecrRefCount(keyPtr);
+		Tcl_BounceRefCount(keyPtr);
 		goto errorInFindDictElement;
 	    }
 
 	    if (literal) {
-		TclNewStringObj(valuePtr, elemStart, elemSize);
+		if (!tclInterning
+			|| !(valuePtr = TclInternObj(elemStart, elemSize))
+			|| (valuePtr == objPtr)) {
+		    TclNewStringObj(valuePtr, elemStart, elemSize);
+		}
 	    } else {
 		/* Avoid double copy */
 		char *dst;
@@ -707,7 +715,8 @@ SetDictFromAny(
 	    if (!isNew) {
 		Tcl_Obj *discardedValue = (Tcl_Obj *)Tcl_GetHashValue(hPtr);
 
-		TclDecrRefCount(keyPtr);
+		/* The key may be interned, and so referenced elsewhere. */
+		Tcl_BounceRefCount(keyPtr);
 		TclDecrRefCount(discardedValue);
 	    }
 	    Tcl_SetHashValue(hPtr, valuePtr);
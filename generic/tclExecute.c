@@ -808,6 +808,7 @@ TclCreateExecEnv(
     eePtr->callbackPtr = NULL;
     eePtr->corPtr = NULL;
     eePtr->rewind = 0;
+    eePtr->tebcFramePtr = NULL;
 
     esPtr->prevPtr = NULL;
     esPtr->nextPtr = NULL;
@@ -2061,6 +2062,7 @@ TEBCresume(
 #endif
 
     TEBC_DATA_DIG();
+    iPtr->execEnvPtr->tebcFramePtr = bcFramePtr;
 
 #ifdef TCL_COMPILE_DEBUG
     if (!pc && (tclTraceExec >= 2)) {
@@ -2290,6 +2292,7 @@ TEBCresume(
 	 */
 
 	iPtr->cmdCount += TclGetUInt4AtPtr(pc + 5);
+	bcFramePtr->data.tebc.pc = (char *) pc;
 	if (checkInterp) {
 	    if (((codePtr->compileEpoch != iPtr->compileEpoch) ||
 		    (codePtr->nsEpoch != iPtr->varFramePtr->nsPtr->resolverEpoch)) &&
@@ -7755,6 +7758,7 @@ TEBCresume(
     }
 
     iPtr->cmdFramePtr = bcFramePtr->nextPtr;
+    iPtr->execEnvPtr->tebcFramePtr = NULL;
     TclReleaseByteCode(codePtr);
     TclStackFree(interp, TD);	/* free my stack */
 
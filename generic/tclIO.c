@@ -108,6 +108,21 @@ typedef struct CopyState {
 				 * field. */
 } CopyState;
 
+/*
+ * Channel buffers of the common sizes are not returned to the allocator when
+ * released but kept in a per-thread pool, from which AllocChannelBuffer takes
+ * them again. The size classes are the powers of two from the default buffer
+ * size up to CHANNELBUFFER_ADAPTIVE_MAX, which are the sizes the adaptive
+ * buffer sizing mode uses. Each class keeps at most BUFFER_POOL_CLASS_BYTES
+ * worth of buffers, i.e. 16 of the default size down to a single 64 KiB one,
+ * so the pool never holds more than 320 KiB per thread.
+ */
+
+#define BUFFER_POOL_CLASSES	5
+#define BUFFER_POOL_CLASS_BYTES	(1024 * 64)
+#define BUFFER_POOL_DEPTH(poolClass) \
+    (BUFFER_POOL_CLASS_BYTES / (CHANNELBUFFER_DEFAULT_SIZE << (poolClass)))
+
 /*
  * All static variables used in this file are collected into a single instance
  * of the following structure. For multi-threaded implementations, there is
@@ -132,6 +147,14 @@ typedef struct {
     int stdinInitialized;
     int stdoutInitialized;
     int stderrInitialized;
+    ChannelBuffer *bufferPool[BUFFER_POOL_CLASSES];
+				/* Released channel buffers kept for reuse,
+				 * one list per size class. */
+    int bufferPoolCount[BUFFER_POOL_CLASSES];
+				/* Number of buffers in each list. */
+    int bufferPoolClosed;	/* Set once the IO subsystem of this thread
+				 * has been finalized; from then on buffers
+				 * go straight back to the allocator. */
 } ThreadSpecificData;
 
 static Tcl_ThreadDataKey dataKey;
@@ -154,6 +177,21 @@ typedef struct CloseCallback {
  */
 
 static ChannelBuffer *	AllocChannelBuffer(Tcl_Size length);
+static inline int	AsciiRunLength(const char *src, int srcLen);
+static void		CheckAsciiEncoding(ChannelState *statePtr);
+static int		ChanExternalToUtf(ChannelState *statePtr,
+			    Tcl_Encoding encoding, const char *src,
+			    int srcLen, int flags, char *dst, int dstLen,
+			    int *srcReadPtr, int *dstWrotePtr,
+			    int *dstCharsPtr);
+static int		ChanUtfToExternal(ChannelState *statePtr,
+			    Tcl_Encoding encoding, const char *src,
+			    Tcl_Size srcLen, char *dst, int dstLen,
+			    int *srcReadPtr, int *dstWrotePtr);
+static void		AdaptBufferSize(ChannelState *statePtr,
+			    int nread, int toRead);
+static inline int	BufferPoolClass(Tcl_Size length);
+static void		FinalizeBufferPool(void);
 static void		PreserveChannelBuffer(ChannelBuffer *bufPtr);
 static void		ReleaseChannelBuffer(ChannelBuffer *bufPtr);
 static int		IsShared(ChannelBuffer *bufPtr);
@@ -221,6 +259,7 @@ static void		RecycleBuffer(ChannelState *statePtr,
 static int		StackSetBlockMode(Channel *chanPtr, int mode);
 static int		SetBlockMode(Tcl_Interp *interp, Channel *chanPtr,
 			    int mode);
+static void		StatsFlushed(ChannelState *statePtr, long long start);
 static void		StopCopy(CopyState *csPtr);
 static void		TranslateInputEOL(ChannelState *statePtr, char *dst,
 			    const char *src, int *dstLenPtr, int *srcLenPtr);
@@ -237,6 +276,35 @@ static int	      WillRead(Channel *chanPtr);
 #define WriteBytes(chanPtr, src, srcLen) \
 			Write(chanPtr, src, srcLen, tclIdentityEncoding)
 
+/*
+ * Maintenance of the optional [chan stats] counters. When statistics are not
+ * being collected for a channel this costs a single test of statsPtr.
+ */
+
+#ifdef TCL_WIDE_CLICKS
+#   define StatsClock()		TclpGetWideClicks()
+#   define StatsClockToMicroseconds(clicks) \
+	(TclpWideClicksToNanoseconds(clicks) / 1000.0)
+#else
+#   define StatsClock()		TclpGetMicroseconds()
+#   define StatsClockToMicroseconds(clicks) ((double) (clicks))
+#endif
+
+#define StatsIncr(statePtr, field, n) \
+    do {								\
+	if ((statePtr)->statsPtr != NULL) {				\
+	    (statePtr)->statsPtr->field += (n);				\
+	}								\
+    } while (0)
+#define StatsStart(statePtr) \
+    (((statePtr)->statsPtr != NULL) ? StatsClock() : 0)
+#define StatsStop(statePtr, field, start) \
+    do {								\
+	if (((statePtr)->statsPtr != NULL) && ((start) != 0)) {	\
+	    (statePtr)->statsPtr->field += StatsClock() - (start);	\
+	}								\
+    } while (0)
+
 /*
  * Simplifying helper macros. All may use their argument(s) multiple times.
  * The ANSI C "prototypes" for the macros are listed below, together with a
@@ -441,6 +509,7 @@ ChanRead(
 
     bytesRead = chanPtr->typePtr->inputProc(chanPtr->instanceData,
 	    dst, dstSize, &result);
+    StatsIncr(chanPtr->state, inputCalls, 1);
 
     /*
      * Stop any flag leakage through stacked channel levels.
@@ -454,6 +523,7 @@ ChanRead(
     if (bytesRead == -1) {
 	if ((result == EWOULDBLOCK) || (result == EAGAIN)) {
 	    SetFlag(chanPtr->state, CHANNEL_BLOCKED);
+	    StatsIncr(chanPtr->state, inputAgain, 1);
 	    result = EAGAIN;
 	}
 	Tcl_SetErrno(result);
@@ -461,6 +531,15 @@ ChanRead(
 	SetFlag(chanPtr->state, CHANNEL_EOF);
 	chanPtr->state->inputEncodingFlags |= TCL_ENCODING_END;
     } else {
+	/*
+	 * Only data entering the channel buffers is counted, not what the
+	 * transformations of a stack read from the channels below them.
+	 */
+
+	if (chanPtr == chanPtr->state->topChanPtr) {
+	    StatsIncr(chanPtr->state, bytesIn, bytesRead);
+	}
+
 	/*
 	 * If we get a short read, signal up that we may be BLOCKED. We should
 	 * avoid calling the driver because on some platforms we will block in
@@ -492,6 +571,7 @@ ChanSeek(
 	return TCL_INDEX_NONE;
     }
 
+	StatsIncr(chanPtr->state, seekCalls, 1);
 	return Tcl_ChannelWideSeekProc(chanPtr->typePtr)(chanPtr->instanceData,
 		offset, mode, errnoPtr);
 }
@@ -514,6 +594,7 @@ ChanWatch(
     Channel *chanPtr,
     int mask)
 {
+    StatsIncr(chanPtr->state, watchCalls, 1);
     chanPtr->typePtr->watchProc(chanPtr->instanceData, mask);
 }
 
@@ -524,8 +605,21 @@ ChanWrite(
     int srcLen,
     int *errnoPtr)
 {
-    return chanPtr->typePtr->outputProc(chanPtr->instanceData, src, srcLen,
-	    errnoPtr);
+    int written = chanPtr->typePtr->outputProc(chanPtr->instanceData, src,
+	    srcLen, errnoPtr);
+    ChannelStats *statsPtr = chanPtr->state->statsPtr;
+
+    if (statsPtr != NULL) {
+	statsPtr->outputCalls++;
+	if (written < 0) {
+	    if ((*errnoPtr == EWOULDBLOCK) || (*errnoPtr == EAGAIN)) {
+		statsPtr->outputAgain++;
+	    }
+	} else if (chanPtr == chanPtr->state->topChanPtr) {
+	    statsPtr->bytesOut += written;
+	}
+    }
+    return written;
 }
 
 /*
@@ -698,6 +792,7 @@ TclFinalizeIOSubsystem(void)
     }
 
     FreeBinaryEncoding();
+    FinalizeBufferPool();
     TclpFinalizeSockets();
     TclpFinalizePipes();
 }
@@ -1675,6 +1770,7 @@ Tcl_CreateChannel(
 
     name = Tcl_GetEncodingName(NULL);
     statePtr->encoding = Tcl_GetEncoding(NULL, name);
+    CheckAsciiEncoding(statePtr);
     statePtr->inputEncodingState  = NULL;
     statePtr->inputEncodingFlags  = TCL_ENCODING_START;
     statePtr->outputEncodingState = NULL;
@@ -1731,6 +1827,8 @@ Tcl_CreateChannel(
     statePtr->unreportedMsg	= NULL;
 
     statePtr->epoch		= 0;
+    statePtr->statsPtr		= NULL;
+    statePtr->adaptCount	= 0;
 
     /*
      * Link the channel into the list of all channels; create an on-exit
@@ -2503,11 +2601,24 @@ static ChannelBuffer *
 AllocChannelBuffer(
     Tcl_Size length)			/* Desired length of channel buffer. */
 {
-    ChannelBuffer *bufPtr;
+    ChannelBuffer *bufPtr = NULL;
+    int poolClass = BufferPoolClass(length);
     Tcl_Size n;
 
-    n = length + CHANNELBUFFER_HEADER_SIZE + BUFFER_PADDING + BUFFER_PADDING;
-    bufPtr = (ChannelBuffer *)Tcl_Alloc(n);
+    if (poolClass >= 0) {
+	ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+
+	bufPtr = tsdPtr->bufferPool[poolClass];
+	if (bufPtr != NULL) {
+	    tsdPtr->bufferPool[poolClass] = bufPtr->nextPtr;
+	    tsdPtr->bufferPoolCount[poolClass]--;
+	}
+    }
+    if (bufPtr == NULL) {
+	n = length + CHANNELBUFFER_HEADER_SIZE + BUFFER_PADDING
+		+ BUFFER_PADDING;
+	bufPtr = (ChannelBuffer *)Tcl_Alloc(n);
+    }
     bufPtr->nextAdded	= BUFFER_PADDING;
     bufPtr->nextRemoved	= BUFFER_PADDING;
     bufPtr->bufLength	= length + BUFFER_PADDING;
@@ -2530,11 +2641,95 @@ static void
 ReleaseChannelBuffer(
     ChannelBuffer *bufPtr)
 {
+    int poolClass;
+
     if (--bufPtr->refCount) {
 	return;
     }
+    poolClass = BufferPoolClass(bufPtr->bufLength - BUFFER_PADDING);
+    if (poolClass >= 0) {
+	ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+
+	if (!tsdPtr->bufferPoolClosed
+		&& (tsdPtr->bufferPoolCount[poolClass]
+			< BUFFER_POOL_DEPTH(poolClass))) {
+	    bufPtr->nextPtr = tsdPtr->bufferPool[poolClass];
+	    tsdPtr->bufferPool[poolClass] = bufPtr;
+	    tsdPtr->bufferPoolCount[poolClass]++;
+	    return;
+	}
+    }
     Tcl_Free(bufPtr);
 }
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * BufferPoolClass --
+ *
+ *	Maps the length of a channel buffer to its size class in the buffer
+ *	pool.
+ *
+ * Results:
+ *	The index of the size class, or -1 if buffers of this length are not
+ *	pooled.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static inline int
+BufferPoolClass(
+    Tcl_Size length)		/* Length of the buffer, without padding. */
+{
+    int poolClass;
+
+    for (poolClass = 0; poolClass < BUFFER_POOL_CLASSES; poolClass++) {
+	Tcl_Size classSize = (Tcl_Size) CHANNELBUFFER_DEFAULT_SIZE << poolClass;
+
+	if (length <= classSize) {
+	    return (length == classSize) ? poolClass : -1;
+	}
+    }
+    return -1;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FinalizeBufferPool --
+ *
+ *	Returns the channel buffers pooled by the current thread to the
+ *	allocator, as part of that thread's finalization.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees memory. Buffers released later on are freed immediately.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static void
+FinalizeBufferPool(void)
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    int poolClass;
+
+    for (poolClass = 0; poolClass < BUFFER_POOL_CLASSES; poolClass++) {
+	while (tsdPtr->bufferPool[poolClass] != NULL) {
+	    ChannelBuffer *bufPtr = tsdPtr->bufferPool[poolClass];
+
+	    tsdPtr->bufferPool[poolClass] = bufPtr->nextPtr;
+	    Tcl_Free(bufPtr);
+	}
+	tsdPtr->bufferPoolCount[poolClass] = 0;
+    }
+    tsdPtr->bufferPoolClosed = 1;
+}
 
 static int
 IsShared(
@@ -2551,7 +2746,8 @@ IsShared(
  *	Helper function to recycle input and output buffers. Ensures that two
  *	input buffers are saved (one in the input queue and another in the
  *	saveInBufPtr field) and that curOutPtr is set to a buffer. Only if
- *	these conditions are met is the buffer freed to the OS.
+ *	these conditions are met is the buffer freed to the OS (or the buffer
+ *	pool). Channels in adaptive buffer sizing mode keep no spare buffers.
  *
  * Results:
  *	None.
@@ -2578,6 +2774,7 @@ RecycleBuffer(
     }
 
     if (mustDiscard) {
+	StatsIncr(statePtr, buffersFreed, 1);
 	ReleaseChannelBuffer(bufPtr);
 	return;
     }
@@ -2588,6 +2785,19 @@ RecycleBuffer(
      */
 
     if ((bufPtr->bufLength) != statePtr->bufSize + BUFFER_PADDING) {
+	StatsIncr(statePtr, buffersFreed, 1);
+	ReleaseChannelBuffer(bufPtr);
+	return;
+    }
+
+    /*
+     * Channels with adaptive buffer sizing keep no spare buffers of their
+     * own; they get them from the buffer pool as needed, so that idle
+     * channels do not tie up memory.
+     */
+
+    if (GotFlag(statePtr, CHANNEL_ADAPTIVE)) {
+	StatsIncr(statePtr, buffersFreed, 1);
 	ReleaseChannelBuffer(bufPtr);
 	return;
     }
@@ -2623,10 +2833,12 @@ RecycleBuffer(
      * If we reached this code we return the buffer to the OS.
      */
 
+    StatsIncr(statePtr, buffersFreed, 1);
     ReleaseChannelBuffer(bufPtr);
     return;
 
   keepBuffer:
+    StatsIncr(statePtr, buffersRecycled, 1);
     bufPtr->nextRemoved = BUFFER_PADDING;
     bufPtr->nextAdded = BUFFER_PADDING;
     bufPtr->nextPtr = NULL;
@@ -2739,6 +2951,7 @@ FlushChannel(
 				 * driver operations. */
     int wroteSome = 0;		/* Set to one if any data was written to the
 				 * driver. */
+    long long start = 0;	/* When the flush started, for [chan stats]. */
 
     int bufExists;
     /*
@@ -2802,6 +3015,9 @@ FlushChannel(
      */
 
     TclChannelPreserve((Tcl_Channel)chanPtr);
+    if (statePtr->outQueueHead != NULL) {
+	start = StatsStart(statePtr);
+    }
     while (statePtr->outQueueHead) {
 	bufPtr = statePtr->outQueueHead;
 
@@ -2949,6 +3165,10 @@ FlushChannel(
 
     }	/* Closes "while". */
 
+    if (start != 0) {
+	StatsFlushed(statePtr, start);
+    }
+
     /*
      * If we wrote some data while flushing in the background, we are done.
      * We can't finish the background flush until we run out of data and the
@@ -3116,6 +3336,10 @@ CloseChannel(
 	    Tcl_Free(statePtr->channelName);
 	    statePtr->channelName = NULL;
 	}
+	if (statePtr->statsPtr != NULL) {
+	    Tcl_Free(statePtr->statsPtr);
+	    statePtr->statsPtr = NULL;
+	}
 
 	Tcl_FreeEncoding(statePtr->encoding);
     }
@@ -4341,9 +4565,14 @@ Write(
     Tcl_Size saved = 0, total = 0, flushed = 0;
     char safe[BUFFER_PADDING];
     int encodingError = 0;
+    long long start;
 
     if (srcLen) {
 	WillWrite(chanPtr);
+	if (statePtr->statsPtr != NULL) {
+	    statePtr->statsPtr->charsOut += (encoding == tclIdentityEncoding)
+		    ? srcLen : Tcl_NumUtfChars(src, srcLen);
+	}
     }
 
     /*
@@ -4370,6 +4599,7 @@ Write(
 	bufPtr = statePtr->curOutPtr;
 	if (bufPtr == NULL) {
 	    bufPtr = AllocChannelBuffer(statePtr->bufSize);
+	    StatsIncr(statePtr, buffersAllocated, 1);
 	    statePtr->curOutPtr = bufPtr;
 	}
 	if (saved) {
@@ -4385,10 +4615,10 @@ Write(
 	dst = InsertPoint(bufPtr);
 	dstLen = SpaceLeft(bufPtr);
 
-	result = Tcl_UtfToExternal(NULL, encoding, src, srcLimit,
-		statePtr->outputEncodingFlags,
-		&statePtr->outputEncodingState, dst,
-		dstLen + BUFFER_PADDING, &srcRead, &dstWrote, NULL);
+	start = StatsStart(statePtr);
+	result = ChanUtfToExternal(statePtr, encoding, src, srcLimit, dst,
+		dstLen + BUFFER_PADDING, &srcRead, &dstWrote);
+	StatsStop(statePtr, outputEncodingTime, start);
 
 	/*
 	 * See chan-io-1.[89]. Tcl Bug 506297.
@@ -4998,6 +5228,9 @@ Tcl_GetsObj(
 	copiedTotal = -1;
     }
     ResetFlag(statePtr, CHANNEL_ENCODING_ERROR);
+    if (copiedTotal > 0) {
+	StatsIncr(statePtr, charsIn, copiedTotal);
+    }
     return copiedTotal;
 }
 
@@ -5277,9 +5510,540 @@ TclGetsObjBinary(
 	    == (CHANNEL_EOF|CHANNEL_BLOCKED)));
     UpdateInterest(chanPtr);
     TclChannelRelease((Tcl_Channel)chanPtr);
+    if (copiedTotal > 0) {
+	StatsIncr(statePtr, charsIn, copiedTotal);
+    }
     return copiedTotal;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TclReadLines --
+ *
+ *	Reads up to maxLines complete lines from the channel and appends them
+ *	as separate elements to listPtr. This is the engine of [chan
+ *	readlines]; it produces the same lines that repeated calls to
+ *	Tcl_GetsObj would produce, but when the channel's encoding is
+ *	ASCII-compatible and the input translation uses a single EOL
+ *	character it scans the channel buffers in place (using memchr) and
+ *	only converts the bytes of each line, rather than paying the setup
+ *	of a full gets operation for every line.
+ *
+ * Results:
+ *	Number of lines appended to listPtr or TCL_INDEX_NONE if no line could
+ *	be read because of an error, EOF or because the channel blocked. If
+ *	TCL_INDEX_NONE, use Tcl_GetErrno() to retrieve the POSIX error code
+ *	for the error or condition that occurred.
+ *
+ * Side effects:
+ *	Consumes input from the channel. A trailing incomplete line is left
+ *	in the channel buffers unless EOF has been reached.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+Tcl_Size
+TclReadLines(
+    Tcl_Channel chan,		/* Channel from which to read. */
+    Tcl_Obj *listPtr,		/* Unshared list to which the lines read are
+				 * appended. */
+    Tcl_Size maxLines)		/* Maximum number of lines to read, or
+				 * negative to read until EOF or blocked. */
+{
+    Channel *chanPtr = (Channel *) chan;
+    ChannelState *statePtr = chanPtr->state;
+				/* State info for channel */
+    ChannelBuffer *bufPtr, *endBufPtr;
+    Tcl_Encoding encoding = statePtr->encoding;
+    Tcl_Size lineCount = 0, length;
+    Tcl_Obj *lineObj;
+    Tcl_DString ds;
+    const char *name;
+    char *p, *end, *eol, *eofPtr, *crPtr, *lineStart;
+    int binary, asciiSafe, eolChar, skip, lfInNext, pos, code;
+    int inEofChar = statePtr->inEofChar;
+
+    if (maxLines == 0) {
+	return 0;
+    }
+
+    /*
+     * Only ASCII-compatible, stateless encodings have the property that an
+     * EOL byte in the raw input is always an EOL character. For the others,
+     * and for CRLF translation which may need to look across a buffer
+     * boundary, fall back to reading line by line.
+     */
+
+    binary = (encoding == GetBinaryEncoding());
+    name = Tcl_GetEncodingName(encoding);
+    if ((!binary && ((Tcl_GetEncodingNulLength(encoding) != 1)
+	    || (strncmp(name, "iso2022", 7) == 0)))
+	    || (statePtr->inputTranslation == TCL_TRANSLATE_CRLF)) {
+	while ((maxLines < 0) || (lineCount < maxLines)) {
+	    TclNewObj(lineObj);
+	    if (Tcl_GetsObj(chan, lineObj) == TCL_IO_FAILURE) {
+		Tcl_DecrRefCount(lineObj);
+		break;
+	    }
+	    Tcl_ListObjAppendElement(NULL, listPtr, lineObj);
+	    lineCount++;
+	}
+	return (lineCount ? lineCount : TCL_INDEX_NONE);
+    }
+
+    /*
+     * Encodings in which the ASCII range maps onto itself allow pure ASCII
+     * lines to be used without any conversion at all.
+     */
+
+    asciiSafe = GotFlag(statePtr, CHANNEL_ASCII_ENCODING);
+
+    if (GotFlag(statePtr, CHANNEL_ENCODING_ERROR)) {
+	UpdateInterest(chanPtr);
+	ResetFlag(statePtr, CHANNEL_EOF|CHANNEL_ENCODING_ERROR);
+	Tcl_SetErrno(EILSEQ);
+	return TCL_INDEX_NONE;
+    }
+    if (CheckChannelErrors(statePtr, TCL_READABLE) != 0) {
+	return TCL_INDEX_NONE;
+    }
+    if (GotFlag(statePtr, CHANNEL_STICKY_EOF)) {
+	SetFlag(statePtr, CHANNEL_EOF);
+	UpdateInterest(chanPtr);
+	return TCL_INDEX_NONE;
+    }
+
+    /*
+     * This operation should occur at the top of a channel stack.
+     */
+
+    chanPtr = statePtr->topChanPtr;
+    TclChannelPreserve((Tcl_Channel)chanPtr);
+
+    eolChar = (statePtr->inputTranslation == TCL_TRANSLATE_CR) ? '\r' : '\n';
+    ResetFlag(statePtr, CHANNEL_BLOCKED);
+
+    while ((maxLines < 0) || (lineCount < maxLines)) {
+	/*
+	 * Everything before the current line has been consumed, so the line
+	 * starts at the remove point of the first buffer holding data. Scan
+	 * forward, through as many buffers as needed, for its end.
+	 */
+
+	bufPtr = statePtr->inQueueHead;
+	pos = (bufPtr ? bufPtr->nextRemoved : 0);
+	crPtr = NULL;
+	eofPtr = NULL;
+	skip = 0;
+	lfInNext = 0;
+	while (1) {
+	    if ((bufPtr == NULL) || (pos >= bufPtr->nextAdded)) {
+		if ((bufPtr != NULL) && (bufPtr->nextPtr != NULL)) {
+		    bufPtr = bufPtr->nextPtr;
+		    pos = bufPtr->nextRemoved;
+		    crPtr = NULL;
+		    continue;
+		}
+		if (GotFlag(statePtr, CHANNEL_BLOCKED|CHANNEL_NONBLOCKING)
+			== (CHANNEL_BLOCKED|CHANNEL_NONBLOCKING)) {
+		    goto blocked;
+		}
+
+		/*
+		 * All channel buffers were exhausted without seeing EOL. Need
+		 * to read more bytes from the channel device; they go either
+		 * to the end of the last buffer or into a new one.
+		 */
+
+		if (GetInput(chanPtr) != 0) {
+		    goto blocked;
+		}
+		if (bufPtr == NULL) {
+		    bufPtr = statePtr->inQueueHead;
+		    if (bufPtr == NULL) {
+			goto blocked;
+		    }
+		    pos = bufPtr->nextRemoved;
+		}
+		crPtr = NULL;
+		if ((pos >= bufPtr->nextAdded) && (bufPtr->nextPtr == NULL)) {
+		    if (GotFlag(statePtr, CHANNEL_EOF)) {
+			eol = bufPtr->buf + pos;
+			endBufPtr = bufPtr;
+			goto gotEOF;
+		    }
+		    continue;
+		}
+		continue;
+	    }
+
+	    p = bufPtr->buf + pos;
+	    end = bufPtr->buf + bufPtr->nextAdded;
+
+	    /*
+	     * The LF completing a CR seen at the very end of the data handed
+	     * out by an earlier read in auto mode is dropped here.
+	     */
+
+	    if (GotFlag(statePtr, INPUT_SAW_CR)) {
+		ResetFlag(statePtr, INPUT_SAW_CR);
+		if (*p == '\n') {
+		    bufPtr->nextRemoved = ++pos;
+		    continue;
+		}
+	    }
+
+	    if (inEofChar != '\0') {
+		eofPtr = (char *)memchr(p, inEofChar, end - p);
+		if (eofPtr != NULL) {
+		    end = eofPtr;
+		}
+	    }
+
+	    if (statePtr->inputTranslation == TCL_TRANSLATE_AUTO) {
+		if ((crPtr == NULL) || (crPtr < p)) {
+		    crPtr = (char *)memchr(p, '\r', end - p);
+		    if (crPtr == NULL) {
+			crPtr = end;
+		    }
+		}
+		eol = (char *)memchr(p, '\n', crPtr - p);
+		if ((eol == NULL) && (crPtr < end)) {
+		    eol = crPtr;
+		}
+	    } else {
+		eol = (char *)memchr(p, eolChar, end - p);
+	    }
+
+	    if (eol != NULL) {
+		skip = 1;
+		if ((*eol == '\r') && (eolChar == '\n')) {
+		    /*
+		     * Auto mode: CR, LF and CRLF all end a line. A CR ending
+		     * the buffered data is handled as gets does, by noting it
+		     * and dropping a following LF on the next read.
+		     */
+
+		    if (eol + 1 < end) {
+			if (eol[1] == '\n') {
+			    skip = 2;
+			}
+		    } else if (eol + 1 == bufPtr->buf + bufPtr->nextAdded) {
+			if ((bufPtr->nextPtr != NULL)
+				&& IsBufferReady(bufPtr->nextPtr)) {
+			    lfInNext = (*RemovePoint(bufPtr->nextPtr) == '\n');
+			} else {
+			    SetFlag(statePtr, INPUT_SAW_CR);
+			}
+		    }
+		}
+		endBufPtr = bufPtr;
+		goto gotEOL;
+	    }
+	    if (eofPtr != NULL) {
+		/*
+		 * EOF character was seen. Leave the channel pointing at it,
+		 * but don't store it in the output.
+		 */
+
+		SetFlag(statePtr, CHANNEL_EOF | CHANNEL_STICKY_EOF);
+		statePtr->inputEncodingFlags |= TCL_ENCODING_END;
+		ResetFlag(statePtr, CHANNEL_BLOCKED|INPUT_SAW_CR);
+		eol = eofPtr;
+		endBufPtr = bufPtr;
+		goto gotEOF;
+	    }
+	    pos = bufPtr->nextAdded;
+	}
+
+    gotEOF:
+	/*
+	 * Whatever precedes EOF forms the final, unterminated line.
+	 */
+
+	for (bufPtr = statePtr->inQueueHead; bufPtr != endBufPtr;
+		bufPtr = bufPtr->nextPtr) {
+	    if (IsBufferReady(bufPtr)) {
+		break;
+	    }
+	}
+	if ((bufPtr == endBufPtr) && (eol == RemovePoint(endBufPtr))) {
+	    ResetFlag(statePtr, INPUT_SAW_CR);
+	    break;
+	}
+	skip = 0;
+
+    gotEOL:
+	/*
+	 * Gather the raw bytes of the line; the common case of a line lying
+	 * within a single buffer needs no copying.
+	 */
+
+	Tcl_DStringInit(&ds);
+	lineStart = RemovePoint(endBufPtr);
+	for (bufPtr = statePtr->inQueueHead; bufPtr != endBufPtr;
+		bufPtr = bufPtr->nextPtr) {
+	    if (IsBufferReady(bufPtr)) {
+		Tcl_DStringAppend(&ds, RemovePoint(bufPtr), BytesLeft(bufPtr));
+	    }
+	}
+	if (Tcl_DStringLength(&ds) > 0) {
+	    Tcl_DStringAppend(&ds, lineStart, eol - lineStart);
+	    lineStart = Tcl_DStringValue(&ds);
+	    length = Tcl_DStringLength(&ds);
+	} else {
+	    length = eol - lineStart;
+	}
+
+	if (binary) {
+	    lineObj = Tcl_NewByteArrayObj((unsigned char *)lineStart, length);
+	} else {
+	    Tcl_DString lineDs;
+
+	    if (asciiSafe) {
+		for (p = lineStart, end = lineStart + length; p < end; p++) {
+		    if ((unsigned char)(*p - 1) >= 0x7F) {
+			break;
+		    }
+		}
+	    }
+	    if (asciiSafe && (p == end)) {
+		lineObj = Tcl_NewStringObj(lineStart, length);
+	    } else {
+		long long start = StatsStart(statePtr);
+
+		code = Tcl_ExternalToUtfDStringEx(NULL, encoding, lineStart,
+			length, ENCODING_PROFILE_GET(statePtr->inputEncodingFlags),
+			&lineDs, NULL);
+		StatsStop(statePtr, inputEncodingTime, start);
+		if (code != TCL_OK) {
+		    /*
+		     * Leave the offending line in the channel, so that [gets]
+		     * or [read] can report it precisely.
+		     */
+
+		    Tcl_DStringFree(&lineDs);
+		    Tcl_DStringFree(&ds);
+		    ResetFlag(statePtr, INPUT_SAW_CR|CHANNEL_EOF|CHANNEL_STICKY_EOF);
+		    if (lineCount == 0) {
+			Tcl_SetErrno(EILSEQ);
+		    }
+		    goto done;
+		}
+		lineObj = Tcl_DStringToObj(&lineDs);
+	    }
+	}
+	Tcl_DStringFree(&ds);
+	if (statePtr->statsPtr != NULL) {
+	    statePtr->statsPtr->charsIn += binary ? length
+		    : Tcl_GetCharLength(lineObj);
+	}
+	Tcl_ListObjAppendElement(NULL, listPtr, lineObj);
+	lineCount++;
+
+	/*
+	 * Consume the line and its EOL, then recycle the emptied buffers.
+	 */
+
+	for (bufPtr = statePtr->inQueueHead; bufPtr != endBufPtr;
+		bufPtr = bufPtr->nextPtr) {
+	    bufPtr->nextRemoved = bufPtr->nextAdded;
+	}
+	endBufPtr->nextRemoved = (eol - endBufPtr->buf) + skip;
+	if (lfInNext) {
+	    endBufPtr->nextPtr->nextRemoved++;
+	}
+	if (!IsBufferReady(statePtr->inQueueHead)) {
+	    CommonGetsCleanup(chanPtr);
+	}
+	if (GotFlag(statePtr, CHANNEL_EOF)) {
+	    break;
+	}
+	continue;
+
+    blocked:
+	/*
+	 * Couldn't get a complete line, because of an error reading from the
+	 * channel or because we are non-blocking and there is no EOL in the
+	 * available data. Any partial line stays buffered; as with gets, note
+	 * that more data is needed before it is worth firing file events.
+	 */
+
+	SetFlag(statePtr, CHANNEL_NEED_MORE_DATA);
+	break;
+    }
+
+  done:
+    if ((statePtr->inQueueHead != NULL)
+	    && !IsBufferReady(statePtr->inQueueHead)) {
+	CommonGetsCleanup(chanPtr);
+    }
+    if (!GotFlag(statePtr, CHANNEL_NEED_MORE_DATA)) {
+	ResetFlag(statePtr, CHANNEL_BLOCKED);
+    }
+
+    /*
+     * Regenerate the top channel, in case it was changed due to
+     * self-modifying reflected transforms.
+     */
+
+    if (chanPtr != statePtr->topChanPtr) {
+	TclChannelRelease((Tcl_Channel)chanPtr);
+	chanPtr = statePtr->topChanPtr;
+	TclChannelPreserve((Tcl_Channel)chanPtr);
+    }
+    UpdateInterest(chanPtr);
+    TclChannelRelease((Tcl_Channel)chanPtr);
+    return (lineCount ? lineCount : TCL_INDEX_NONE);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * StatsFlushed --
+ *
+ *	Records the completion of a flush of the output queue of a channel
+ *	that collects statistics. The elapsed time is accumulated into a
+ *	histogram whose buckets double in width; bucket N counts flushes that
+ *	took less than 2**N microseconds and the last bucket everything else.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Updates the statistics of the channel.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static void
+StatsFlushed(
+    ChannelState *statePtr,	/* Channel whose flush just completed. */
+    long long start)		/* Clock value when the flush began. */
+{
+    ChannelStats *statsPtr = statePtr->statsPtr;
+    double elapsed;
+    int bucket = 0;
+
+    if (statsPtr == NULL) {
+	return;
+    }
+    elapsed = StatsClockToMicroseconds(StatsClock() - start);
+    while ((bucket < CHANNEL_STATS_BUCKETS - 1)
+	    && (elapsed >= (double) (1LL << bucket))) {
+	bucket++;
+    }
+    statsPtr->flushes++;
+    statsPtr->flushLatency[bucket]++;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TclChannelCollectStats --
+ *
+ *	Switches the collection of I/O statistics for a channel on or off.
+ *	Switching it on (again) starts from zeroed counters; switching it off
+ *	discards the counters collected so far.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Allocates or frees the statistics record of the channel.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+void
+TclChannelCollectStats(
+    Tcl_Channel chan,		/* Channel to configure. */
+    int enable)			/* Whether to collect statistics. */
+{
+    ChannelState *statePtr = ((Channel *) chan)->state;
+
+    if (enable) {
+	if (statePtr->statsPtr == NULL) {
+	    statePtr->statsPtr = (ChannelStats *)
+		    Tcl_Alloc(sizeof(ChannelStats));
+	}
+	memset(statePtr->statsPtr, 0, sizeof(ChannelStats));
+    } else if (statePtr->statsPtr != NULL) {
+	Tcl_Free(statePtr->statsPtr);
+	statePtr->statsPtr = NULL;
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TclChannelGetStats --
+ *
+ *	Builds a dictionary describing the I/O statistics collected for a
+ *	channel since collection was last switched on.
+ *
+ * Results:
+ *	A new dictionary object, empty if no statistics are being collected.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclChannelGetStats(
+    Tcl_Channel chan)		/* Channel to report on. */
+{
+    ChannelStats *statsPtr = ((Channel *) chan)->state->statsPtr;
+    Tcl_Obj *dictPtr, *histPtr;
+    int i;
+
+    TclNewObj(dictPtr);
+    if (statsPtr == NULL) {
+	return dictPtr;
+    }
+
+#define STATS_WIDE(name, value) \
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj(name, -1), \
+	    Tcl_NewWideIntObj((Tcl_WideInt) (value)))
+
+    STATS_WIDE("bytesIn", statsPtr->bytesIn);
+    STATS_WIDE("bytesOut", statsPtr->bytesOut);
+    STATS_WIDE("charsIn", statsPtr->charsIn);
+    STATS_WIDE("charsOut", statsPtr->charsOut);
+    STATS_WIDE("inputCalls", statsPtr->inputCalls);
+    STATS_WIDE("outputCalls", statsPtr->outputCalls);
+    STATS_WIDE("seekCalls", statsPtr->seekCalls);
+    STATS_WIDE("watchCalls", statsPtr->watchCalls);
+    STATS_WIDE("inputAgain", statsPtr->inputAgain);
+    STATS_WIDE("outputAgain", statsPtr->outputAgain);
+    STATS_WIDE("buffersAllocated", statsPtr->buffersAllocated);
+    STATS_WIDE("buffersRecycled", statsPtr->buffersRecycled);
+    STATS_WIDE("buffersFreed", statsPtr->buffersFreed);
+    STATS_WIDE("flushes", statsPtr->flushes);
+
+    TclNewObj(histPtr);
+    for (i = 0; i < CHANNEL_STATS_BUCKETS; i++) {
+	if (statsPtr->flushLatency[i] == 0) {
+	    continue;
+	}
+	Tcl_DictObjPut(NULL, histPtr, (i < CHANNEL_STATS_BUCKETS - 1)
+		? Tcl_NewWideIntObj(1LL << i) : Tcl_NewStringObj("inf", -1),
+		Tcl_NewWideIntObj((Tcl_WideInt) statsPtr->flushLatency[i]));
+    }
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("flushLatency", -1),
+	    histPtr);
+
+    STATS_WIDE("inputEncodingTime",
+	    StatsClockToMicroseconds(statsPtr->inputEncodingTime));
+    STATS_WIDE("outputEncodingTime",
+	    StatsClockToMicroseconds(statsPtr->outputEncodingTime));
+#undef STATS_WIDE
+    return dictPtr;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -5353,6 +6117,7 @@ FilterInputBytes(
     ChannelBuffer *bufPtr;
     char *raw, *dst;
     int offset, toRead, dstNeeded, spaceLeft, result, rawLen;
+    long long start;
     Tcl_Obj *objPtr;
 #define ENCODING_LINESIZE 20	/* Lower bound on how many bytes to convert at
 				 * a time. Since we don't know a priori how
@@ -5450,10 +6215,12 @@ FilterInputBytes(
     }
     gsPtr->state = statePtr->inputEncodingState;
 
-    result = Tcl_ExternalToUtf(NULL, gsPtr->encoding, raw, rawLen,
+    start = StatsStart(statePtr);
+    result = ChanExternalToUtf(statePtr, gsPtr->encoding, raw, rawLen,
 	    statePtr->inputEncodingFlags | TCL_ENCODING_NO_TERMINATE,
-	    &statePtr->inputEncodingState, dst, spaceLeft, &gsPtr->rawRead,
-	    &gsPtr->bytesWrote, &gsPtr->charsWrote);
+	    dst, spaceLeft, &gsPtr->rawRead, &gsPtr->bytesWrote,
+	    &gsPtr->charsWrote);
+    StatsStop(statePtr, inputEncodingTime, start);
 
 	if (result == TCL_CONVERT_UNKNOWN || result == TCL_CONVERT_SYNTAX) {
 	    SetFlag(statePtr, CHANNEL_ENCODING_ERROR);
@@ -5505,6 +6272,7 @@ FilterInputBytes(
 	} else {
 	    if (nextPtr == NULL) {
 		nextPtr = AllocChannelBuffer(statePtr->bufSize);
+		StatsIncr(statePtr, buffersAllocated, 1);
 		bufPtr->nextPtr = nextPtr;
 		statePtr->inQueueTail = nextPtr;
 	    }
@@ -6114,6 +6882,9 @@ finish:
 	Tcl_SetErrno(EILSEQ);
 	copied = -1;
     }
+    if (copied > 0) {
+	StatsIncr(statePtr, charsIn, copied);
+    }
     TclChannelRelease((Tcl_Channel)chanPtr);
     return copied;
 }
@@ -6222,6 +6993,7 @@ ReadChars(
     Tcl_Encoding encoding = statePtr->encoding;
     Tcl_EncodingState savedState = statePtr->inputEncodingState;
     ChannelBuffer *bufPtr = statePtr->inQueueHead;
+    long long start;
     int savedIEFlags = statePtr->inputEncodingFlags;
     int savedFlags = statePtr->flags;
     char *dst, *src = RemovePoint(bufPtr);
@@ -6301,9 +7073,10 @@ ReadChars(
 	assert(bufPtr->nextPtr == NULL || BytesLeft(bufPtr->nextPtr) == 0
 		|| (statePtr->inputEncodingFlags & TCL_ENCODING_END) == 0);
 
-	code = Tcl_ExternalToUtf(NULL, encoding, src, srcLen,
-		flags, &statePtr->inputEncodingState,
+	start = StatsStart(statePtr);
+	code = ChanExternalToUtf(statePtr, encoding, src, srcLen, flags,
 		dst, dstLimit, &srcRead, &dstDecoded, &numChars);
+	StatsStop(statePtr, inputEncodingTime, start);
 
 	if (code == TCL_CONVERT_UNKNOWN || code == TCL_CONVERT_SYNTAX
 		|| (code == TCL_CONVERT_MULTIBYTE && GotFlag(statePtr, CHANNEL_EOF))) {
@@ -6579,6 +7352,231 @@ ReadChars(
     }
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CheckAsciiEncoding --
+ *
+ *	Records in the CHANNEL_ASCII_ENCODING flag whether the encoding of a
+ *	channel is one of the common stateless encodings in which the bytes
+ *	0x01-0x7F stand for the ASCII characters. Input and output in such an
+ *	encoding can copy runs of those bytes without converting them.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Sets or clears the CHANNEL_ASCII_ENCODING flag of the channel.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static void
+CheckAsciiEncoding(
+    ChannelState *statePtr)	/* Channel whose encoding was just set. */
+{
+    const char *name = Tcl_GetEncodingName(statePtr->encoding);
+
+    if ((strcmp(name, "utf-8") == 0) || (strcmp(name, "ascii") == 0)
+	    || (strncmp(name, "iso8859-", 8) == 0)
+	    || (strncmp(name, "cp125", 5) == 0)) {
+	SetFlag(statePtr, CHANNEL_ASCII_ENCODING);
+    } else {
+	ResetFlag(statePtr, CHANNEL_ASCII_ENCODING);
+    }
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * AsciiRunLength --
+ *
+ *	Measures the run of bytes in the range 0x01-0x7F at the start of a
+ *	string. NUL is excluded because Tcl represents it internally by a two
+ *	byte sequence. The bulk of the string is checked a machine word at a
+ *	time.
+ *
+ * Results:
+ *	The length of the run.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static inline int
+AsciiRunLength(
+    const char *src,		/* Bytes to check. */
+    int srcLen)			/* Number of bytes to check. */
+{
+    const unsigned char *p = (const unsigned char *) src;
+    const unsigned char *end = p + srcLen;
+    const size_t ones = ~(size_t) 0 / 0xFF;
+    const size_t highs = ones << 7;
+
+    while (end - p >= (ptrdiff_t) sizeof(size_t)) {
+	size_t word;
+
+	memcpy(&word, p, sizeof(size_t));
+
+	/*
+	 * A byte has its high bit set after subtracting one only if it was
+	 * NUL or had its high bit set already (or borrowed from a preceding
+	 * NUL, in which case the word is rejected anyway).
+	 */
+
+	if (((word - ones) | word) & highs) {
+	    break;
+	}
+	p += sizeof(size_t);
+    }
+    while ((p < end) && (*p - 1U < 0x7F)) {
+	p++;
+    }
+    return (int) (p - (const unsigned char *) src);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ChanExternalToUtf --
+ *
+ *	Converts input of a channel to UTF-8, like Tcl_ExternalToUtf() with
+ *	the input encoding state of the channel. When the channel has an
+ *	ASCII-compatible encoding, the run of ASCII bytes at the start of the
+ *	input is copied directly, and only the remainder (if any) is handed
+ *	to the encoding. Because these encodings are stateless, this yields
+ *	exactly what Tcl_ExternalToUtf() yields for the whole input.
+ *
+ * Results:
+ *	As for Tcl_ExternalToUtf().
+ *
+ * Side effects:
+ *	As for Tcl_ExternalToUtf().
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static int
+ChanExternalToUtf(
+    ChannelState *statePtr,	/* Channel the input comes from. */
+    Tcl_Encoding encoding,	/* Encoding of the input. */
+    const char *src,		/* Input bytes. */
+    int srcLen,			/* Number of input bytes. */
+    int flags,			/* Conversion control flags. */
+    char *dst,			/* Where to store the UTF-8. */
+    int dstLen,			/* Space available at dst. */
+    int *srcReadPtr,		/* Number of input bytes converted. */
+    int *dstWrotePtr,		/* Number of bytes stored at dst. */
+    int *dstCharsPtr)		/* Number of characters stored at dst; on
+				 * input the limit for
+				 * TCL_ENCODING_CHAR_LIMIT. */
+{
+    int run, code;
+
+    if ((encoding != statePtr->encoding)
+	    || !GotFlag(statePtr, CHANNEL_ASCII_ENCODING)) {
+	return Tcl_ExternalToUtf(NULL, encoding, src, srcLen, flags,
+		&statePtr->inputEncodingState, dst, dstLen, srcReadPtr,
+		dstWrotePtr, dstCharsPtr);
+    }
+
+    /*
+     * Copy no more than the encoding itself would have converted before
+     * running out of space or reaching the character limit.
+     */
+
+    run = dstLen - TCL_UTF_MAX + 1;
+    if (run > srcLen) {
+	run = srcLen;
+    }
+    if ((flags & TCL_ENCODING_CHAR_LIMIT) && (run > *dstCharsPtr)) {
+	run = *dstCharsPtr;
+    }
+    run = (run > 0) ? AsciiRunLength(src, run) : 0;
+    if (run == 0) {
+	return Tcl_ExternalToUtf(NULL, encoding, src, srcLen, flags,
+		&statePtr->inputEncodingState, dst, dstLen, srcReadPtr,
+		dstWrotePtr, dstCharsPtr);
+    }
+    memcpy(dst, src, run);
+    if (run == srcLen) {
+	*srcReadPtr = *dstWrotePtr = *dstCharsPtr = run;
+	return TCL_OK;
+    }
+    if (flags & TCL_ENCODING_CHAR_LIMIT) {
+	*dstCharsPtr -= run;
+    }
+    code = Tcl_ExternalToUtf(NULL, encoding, src + run, srcLen - run, flags,
+	    &statePtr->inputEncodingState, dst + run, dstLen - run,
+	    srcReadPtr, dstWrotePtr, dstCharsPtr);
+    *srcReadPtr += run;
+    *dstWrotePtr += run;
+    *dstCharsPtr += run;
+    return code;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ChanUtfToExternal --
+ *
+ *	Converts UTF-8 to the output encoding of a channel, like
+ *	Tcl_UtfToExternal() with the output encoding state and flags of the
+ *	channel. The counterpart of ChanExternalToUtf(): when the channel has
+ *	an ASCII-compatible encoding, the run of ASCII characters at the start
+ *	of the string is copied directly.
+ *
+ * Results:
+ *	As for Tcl_UtfToExternal().
+ *
+ * Side effects:
+ *	As for Tcl_UtfToExternal().
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static int
+ChanUtfToExternal(
+    ChannelState *statePtr,	/* Channel the output goes to. */
+    Tcl_Encoding encoding,	/* Encoding of the output. */
+    const char *src,		/* UTF-8 to convert. */
+    Tcl_Size srcLen,		/* Number of bytes at src. */
+    char *dst,			/* Where to store the output. */
+    int dstLen,			/* Space available at dst. */
+    int *srcReadPtr,		/* Number of bytes of src converted. */
+    int *dstWrotePtr)		/* Number of bytes stored at dst. */
+{
+    int run = 0, code;
+
+    /*
+     * The limit leaves room for the terminating NUL and for the largest
+     * character any of the encodings may need to store.
+     */
+
+    if ((encoding == statePtr->encoding)
+	    && GotFlag(statePtr, CHANNEL_ASCII_ENCODING)
+	    && (dstLen > TCL_UTF_MAX) && (srcLen > 0)) {
+	run = dstLen - TCL_UTF_MAX;
+	if (run > srcLen) {
+	    run = (int) srcLen;
+	}
+	run = AsciiRunLength(src, run);
+	memcpy(dst, src, run);
+	if (run == srcLen) {
+	    *srcReadPtr = *dstWrotePtr = run;
+	    return TCL_OK;
+	}
+    }
+    code = Tcl_UtfToExternal(NULL, encoding, src + run, srcLen - run,
+	    statePtr->outputEncodingFlags, &statePtr->outputEncodingState,
+	    dst + run, dstLen - run, srcReadPtr, dstWrotePtr, NULL);
+    *srcReadPtr += run;
+    *dstWrotePtr += run;
+    return code;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -6976,6 +7974,7 @@ GetInput(
     int result;			/* Of calling driver. */
     int nread;			/* How much was read from channel? */
     ChannelBuffer *bufPtr;	/* New buffer to add to input queue. */
+    int fresh = 0;		/* Reading into a newly queued buffer? */
     ChannelState *statePtr = chanPtr->state;
 				/* State info for channel */
 
@@ -7064,11 +8063,13 @@ GetInput(
 
 	if (bufPtr == NULL) {
 	    bufPtr = AllocChannelBuffer(statePtr->bufSize);
+	    StatsIncr(statePtr, buffersAllocated, 1);
 	}
 	bufPtr->nextPtr = NULL;
 
 	toRead = SpaceLeft(bufPtr);
 	assert((Tcl_Size)toRead == statePtr->bufSize);
+	fresh = 1;
 
 	if (statePtr->inQueueTail == NULL) {
 	    statePtr->inQueueHead = bufPtr;
@@ -7093,9 +8094,77 @@ GetInput(
 	}
     }
 
+    if (fresh && GotFlag(statePtr, CHANNEL_ADAPTIVE)) {
+	AdaptBufferSize(statePtr, nread, toRead);
+    }
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * AdaptBufferSize --
+ *
+ *	Implements the adaptive buffer sizing mode (-buffersize auto). Called
+ *	after each driver read into a fresh input buffer. The buffer size is
+ *	doubled when reads keep filling whole buffers, and halved when reads
+ *	keep delivering less than a quarter of a buffer or nothing at all,
+ *	staying between CHANNELBUFFER_DEFAULT_SIZE and
+ *	CHANNELBUFFER_ADAPTIVE_MAX. Buffers of the previous size are discarded
+ *	by GetInput and RecycleBuffer as they come up for reuse.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May change the buffer size of the channel.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define ADAPT_GROW_READS	2	/* Full reads in a row before growing. */
+#define ADAPT_SHRINK_READS	8	/* Short reads in a row before
+					 * shrinking. */
+
+static void
+AdaptBufferSize(
+    ChannelState *statePtr,	/* Channel to adapt. */
+    int nread,			/* Result of the driver read. */
+    int toRead)			/* Size of the buffer read into. */
+{
+    Tcl_Size sz = statePtr->bufSize;
+
+    if (nread >= toRead) {
+	if (statePtr->adaptCount < 0) {
+	    statePtr->adaptCount = 0;
+	}
+	if ((++statePtr->adaptCount >= ADAPT_GROW_READS)
+		&& (sz < CHANNELBUFFER_ADAPTIVE_MAX)) {
+	    sz *= 2;
+	    if (sz > CHANNELBUFFER_ADAPTIVE_MAX) {
+		sz = CHANNELBUFFER_ADAPTIVE_MAX;
+	    }
+	    statePtr->bufSize = sz;
+	    statePtr->adaptCount = 0;
+	}
+    } else if (nread < toRead / 4) {
+	if (statePtr->adaptCount > 0) {
+	    statePtr->adaptCount = 0;
+	}
+	if ((--statePtr->adaptCount <= -ADAPT_SHRINK_READS)
+		&& (sz > CHANNELBUFFER_DEFAULT_SIZE)) {
+	    sz /= 2;
+	    if (sz < CHANNELBUFFER_DEFAULT_SIZE) {
+		sz = CHANNELBUFFER_DEFAULT_SIZE;
+	    }
+	    statePtr->bufSize = sz;
+	    statePtr->adaptCount = 0;
+	}
+    } else {
+	statePtr->adaptCount = 0;
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -7750,6 +8819,7 @@ Tcl_SetChannelBufferSize(
     }
 
     statePtr = ((Channel *) chan)->state;
+    ResetFlag(statePtr, CHANNEL_ADAPTIVE);
 
     if (statePtr->bufSize == sz) {
 	return;
@@ -8187,6 +9257,11 @@ Tcl_SetChannelOption(
 	Tcl_Obj obj;
 	int code;
 
+	if (strcmp(newValue, "auto") == 0) {
+	    SetFlag(statePtr, CHANNEL_ADAPTIVE);
+	    statePtr->adaptCount = 0;
+	    return TCL_OK;
+	}
 	obj.refCount = 1;
 	obj.bytes = (char *)newValue;
 	obj.length = strlen(newValue);
@@ -8226,6 +9301,7 @@ Tcl_SetChannelOption(
 	}
 	Tcl_FreeEncoding(statePtr->encoding);
 	statePtr->encoding = encoding;
+	CheckAsciiEncoding(statePtr);
 	statePtr->inputEncodingState = NULL;
 	profile = ENCODING_PROFILE_GET(statePtr->inputEncodingFlags);
 	statePtr->inputEncodingFlags = TCL_ENCODING_START;
@@ -8314,6 +9390,7 @@ Tcl_SetChannelOption(
 		statePtr->inEofChar = 0;
 		Tcl_FreeEncoding(statePtr->encoding);
 		statePtr->encoding = Tcl_GetEncoding(NULL, "iso8859-1");
+		CheckAsciiEncoding(statePtr);
 	    } else if (strcmp(readMode, "lf") == 0) {
 		translation = TCL_TRANSLATE_LF;
 	    } else if (strcmp(readMode, "cr") == 0) {
@@ -8363,6 +9440,7 @@ Tcl_SetChannelOption(
 		statePtr->outputTranslation = TCL_TRANSLATE_LF;
 		Tcl_FreeEncoding(statePtr->encoding);
 		statePtr->encoding = Tcl_GetEncoding(NULL, "iso8859-1");
+		CheckAsciiEncoding(statePtr);
 	    } else if (strcmp(writeMode, "lf") == 0) {
 		statePtr->outputTranslation = TCL_TRANSLATE_LF;
 	    } else if (strcmp(writeMode, "cr") == 0) {
@@ -9151,6 +10229,7 @@ TclChannelEventScriptInvoker(
 
     Tcl_Preserve(interp);
     TclChannelPreserve((Tcl_Channel)chanPtr);
+    TclEventStatsScript(esPtr->scriptPtr);
     result = Tcl_EvalObjEx(interp, esPtr->scriptPtr, TCL_EVAL_GLOBAL);
 
     /*
@@ -10244,6 +11323,7 @@ DoRead(
 	    == (CHANNEL_EOF|CHANNEL_BLOCKED)));
     UpdateInterest(chanPtr);
     TclChannelRelease((Tcl_Channel)chanPtr);
+    StatsIncr(statePtr, charsIn, p - dst);
     return (Tcl_Size)(p - dst);
 }
 
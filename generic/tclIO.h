@@ -66,6 +66,14 @@ typedef struct ChannelBuffer {
 
 #define CHANNELBUFFER_DEFAULT_SIZE	(1024 * 4)
 
+/*
+ * The largest buffer size that the adaptive buffer sizing mode (-buffersize
+ * auto) grows a channel's buffers to. The smallest size it shrinks them to is
+ * CHANNELBUFFER_DEFAULT_SIZE.
+ */
+
+#define CHANNELBUFFER_ADAPTIVE_MAX	(1024 * 64)
+
 /*
  * The following structure describes the information saved from a call to
  * "fileevent". This is used later when the event being waited for to invoke
@@ -85,6 +93,44 @@ typedef struct EventScriptRecord {
 				/* Next in chain of records. */
 } EventScriptRecord;
 
+/*
+ * struct ChannelStats:
+ *
+ * Counters optionally collected for a channel stack, see [chan stats]. They
+ * are only allocated (and maintained) while collection is switched on.
+ * Durations are measured in the units of the clock used by tclIO.c; the
+ * flush latency histogram has one bucket per power of two microseconds,
+ * the last one catching everything that takes longer.
+ */
+
+#define CHANNEL_STATS_BUCKETS	24
+
+typedef struct ChannelStats {
+    Tcl_WideInt bytesIn;	/* Bytes obtained from the channel driver. */
+    Tcl_WideInt bytesOut;	/* Bytes handed to the channel driver. */
+    Tcl_WideInt charsIn;	/* Characters returned by read operations. */
+    Tcl_WideInt charsOut;	/* Characters accepted by write operations. */
+    Tcl_WideInt inputCalls;	/* Calls of the drivers' inputProc. */
+    Tcl_WideInt outputCalls;	/* Calls of the drivers' outputProc. */
+    Tcl_WideInt seekCalls;	/* Calls of the drivers' seek procedure. */
+    Tcl_WideInt watchCalls;	/* Calls of the drivers' watchProc. */
+    Tcl_WideInt inputAgain;	/* Input calls failing with EAGAIN. */
+    Tcl_WideInt outputAgain;	/* Output calls failing with EAGAIN. */
+    Tcl_WideInt buffersAllocated;
+				/* Channel buffers newly allocated. */
+    Tcl_WideInt buffersRecycled;/* Buffers kept for reuse by RecycleBuffer. */
+    Tcl_WideInt buffersFreed;	/* Buffers given back to the allocator by
+				 * RecycleBuffer. */
+    Tcl_WideInt flushes;	/* Flushes which found output to write. */
+    Tcl_WideInt flushLatency[CHANNEL_STATS_BUCKETS];
+				/* Histogram of the time taken by those
+				 * flushes. */
+    long long inputEncodingTime;/* Time spent converting input to UTF-8. */
+    long long outputEncodingTime;
+				/* Time spent converting output from
+				 * UTF-8. */
+} ChannelStats;
+
 /*
  * struct Channel:
  *
@@ -223,6 +269,13 @@ typedef struct ChannelState {
 				 * lookup results. */
     int maxPerms;		/* TIP #220: Max access privileges
 				 * the channel was created with. */
+    ChannelStats *statsPtr;	/* Statistics about the channel, or NULL when
+				 * they are not being collected. */
+    int adaptCount;		/* Used by the adaptive buffer sizing mode:
+				 * the number of consecutive reads that
+				 * filled a whole buffer when positive, or
+				 * that came back mostly empty when
+				 * negative. */
 } ChannelState;
 
 /*
@@ -288,6 +341,14 @@ typedef struct ChannelState {
 #define CHANNEL_CLOSEDWRITE	(1<<21)	/* Channel write side has been closed.
 					 * No further Tcl-level write IO on
 					 * the channel is allowed. */
+#define CHANNEL_ADAPTIVE	(1<<22)	/* The buffer size of the channel
+					 * follows the amount of data the
+					 * driver delivers per read
+					 * (-buffersize auto). */
+#define CHANNEL_ASCII_ENCODING	(1<<23)	/* The channel encoding is stateless
+					 * and maps the bytes 0x01-0x7F onto
+					 * the same characters, so that runs
+					 * of such bytes need no conversion. */
 
 /*
  * The length of time to wait between synthetic timer events. Must be zero or
@@ -41,6 +41,8 @@ static Tcl_ThreadDataKey dataKey;
 static Tcl_ExitProc		FinalizeIOCmdTSD;
 static Tcl_TcpAcceptProc 	AcceptCallbackProc;
 static Tcl_ObjCmdProc		ChanPendingObjCmd;
+static Tcl_ObjCmdProc		ChanReadLinesObjCmd;
+static Tcl_ObjCmdProc		ChanStatsObjCmd;
 static Tcl_ObjCmdProc		ChanTruncateObjCmd;
 static void		RegisterTcpServerInterpCleanup(
 			    Tcl_Interp *interp,
@@ -343,6 +345,87 @@ Tcl_GetsObjCmd(
     return code;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ChanReadLinesObjCmd --
+ *
+ *	This function is invoked to process the "chan readlines" Tcl command.
+ *	See the user documentation for details on what it does.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	May consume input from channel.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ChanReadLinesObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    Tcl_Channel chan;		/* The channel to read from. */
+    Tcl_Size maxLines = TCL_INDEX_NONE;
+				/* Maximum number of lines to read. */
+    int mode;			/* Mode in which channel is opened. */
+    Tcl_Obj *listPtr, *chanObjPtr;
+
+    if ((objc != 2) && (objc != 3)) {
+	Tcl_WrongNumArgs(interp, 1, objv, "channelId ?maxLines?");
+	return TCL_ERROR;
+    }
+    chanObjPtr = objv[1];
+    if (TclGetChannelFromObj(interp, chanObjPtr, &chan, &mode, 0) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (!(mode & TCL_READABLE)) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"channel \"%s\" wasn't opened for reading",
+		TclGetString(chanObjPtr)));
+	return TCL_ERROR;
+    }
+    if (objc == 3) {
+	if ((Tcl_GetSizeIntFromObj(NULL, objv[2], &maxLines) != TCL_OK)
+		|| (maxLines < 0)) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "expected non-negative integer but got \"%s\"",
+		    TclGetString(objv[2])));
+	    Tcl_SetErrorCode(interp, "TCL", "VALUE", "NUMBER", (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
+
+    TclChannelPreserve(chan);
+    TclNewObj(listPtr);
+    if ((TclReadLines(chan, listPtr, maxLines) == TCL_IO_FAILURE)
+	    && !Tcl_Eof(chan) && !Tcl_InputBlocked(chan)) {
+	Tcl_DecrRefCount(listPtr);
+
+	/*
+	 * TIP #219.
+	 * Capture error messages put by the driver into the bypass area and
+	 * put them into the regular interpreter result. Fall back to the
+	 * regular message if nothing was found in the bypass.
+	 */
+
+	if (!TclChanCaughtErrorBypass(interp, chan)) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "error reading \"%s\": %s",
+		    TclGetString(chanObjPtr), Tcl_PosixError(interp)));
+	}
+	TclChannelRelease(chan);
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, listPtr);
+    TclChannelRelease(chan);
+    return TCL_OK;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -479,6 +562,51 @@ Tcl_ReadObjCmd(
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ChanStatsObjCmd --
+ *
+ *	This function is invoked to process the "chan stats" Tcl command.
+ *	See the user documentation for details on what it does.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	May switch the collection of statistics for a channel on or off.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ChanStatsObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    Tcl_Channel chan;
+    int enable;
+
+    if ((objc != 2) && (objc != 3)) {
+	Tcl_WrongNumArgs(interp, 1, objv, "channelId ?boolean?");
+	return TCL_ERROR;
+    }
+    if (TclGetChannelFromObj(interp, objv[1], &chan, NULL, 0) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (objc == 3) {
+	if (Tcl_GetBooleanFromObj(interp, objv[2], &enable) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	TclChannelCollectStats(chan, enable);
+	return TCL_OK;
+    }
+    Tcl_SetObjResult(interp, TclChannelGetStats(chan));
+    return TCL_OK;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2042,7 +2170,9 @@ TclInitChanCmd(
 	{"push",	TclChanPushObjCmd,	TclCompileBasic2ArgCmd, NULL, NULL, 0},		/* TIP #230 */
 	{"puts",	Tcl_PutsObjCmd,		NULL, NULL, NULL, 0},
 	{"read",	Tcl_ReadObjCmd,		NULL, NULL, NULL, 0},
+	{"readlines",	ChanReadLinesObjCmd,	TclCompileBasic1Or2ArgCmd, NULL, NULL, 0},
 	{"seek",	Tcl_SeekObjCmd,		TclCompileBasic2Or3ArgCmd, NULL, NULL, 0},
+	{"stats",	ChanStatsObjCmd,	TclCompileBasic1Or2ArgCmd, NULL, NULL, 0},
 	{"tell",	Tcl_TellObjCmd,		TclCompileBasic1ArgCmd, NULL, NULL, 0},
 	{"truncate",	ChanTruncateObjCmd,	TclCompileBasic1Or2ArgCmd, NULL, NULL, 0},		/* TIP #208 */
 	{NULL, NULL, NULL, NULL, NULL, 0}
@@ -123,6 +123,18 @@ typedef struct {
 				   order to call Tcl_NotifyChannel when the
 				   channel is writable
 				*/
+#if TCL_THREADS
+    char *readAhead;		/* Bytes read from the handler thread beyond
+				 * what the channel asked for, not consumed
+				 * yet. NULL if not allocated. */
+    int readAheadAllocated;	/* Size of the readAhead area. */
+    int readAheadStart;		/* Offset of the first unconsumed byte. */
+    int readAheadLength;	/* Number of unconsumed bytes. */
+    int readAheadSize;		/* Number of bytes to ask the handler for in
+				 * the next forwarded read. 0 asks for what
+				 * the channel asked for, -1 disables reading
+				 * ahead. */
+#endif
 
     /*
      * Note regarding the usage of timers.
@@ -222,6 +234,13 @@ typedef enum {
  * send'.
  */
 
+/*
+ * Largest number of bytes a forwarded read asks the handler for when reading
+ * ahead. See ReflectInput.
+ */
+
+#define READ_AHEAD_MAX (64 * 1024)
+
 /*
  * Enumeration of all operations which can be forwarded.
  */
@@ -358,7 +377,7 @@ struct ForwardingResult {
      * indirections are needed to retrieve it. And the evPtr may be gone,
      * breaking the chain.
      */
-    Tcl_Condition done;		/* Condition variable the forwarder blocks
+    Tcl_Condition *donePtr;	/* Condition variable the forwarder blocks
 				 * on. */
     int result;			/* TCL_OK or TCL_ERROR */
     ForwardingEvent *evPtr;	/* Event the result belongs to. */
@@ -374,6 +393,15 @@ typedef struct {
      */
 
     ReflectedChannelMap *rcmPtr;
+
+    /*
+     * Condition variable this thread waits on for its forwards, to reflected
+     * channels and reflected transforms alike. See TclChanForwardCondition.
+     */
+
+    Tcl_Condition forwardDone;
+    int forwardDoneExit;	/* Whether the exit handler finalizing
+				 * forwardDone is registered. */
 } ThreadSpecificData;
 
 static Tcl_ThreadDataKey dataKey;
@@ -401,6 +429,10 @@ static void		ForwardOpToHandlerThread(ReflectedChannel *rcPtr,
 			    ForwardedOperation op, const void *param);
 static int		ForwardProc(Tcl_Event *evPtr, int mask);
 static void		SrcExitProc(void *clientData);
+static Tcl_ExitProc	FinalizeForwardCondition;
+static int		ReadAheadTake(ReflectedChannel *rcPtr, char *buf,
+			    int toRead);
+static void		ReadAheadNotify(ReflectedChannel *rcPtr);
 
 #define FreeReceivedError(p) \
 	if ((p)->base.mustFree) {                               \
@@ -716,6 +748,18 @@ TclChanCreateObjCmd(
 	chanPtr->typePtr = clonePtr;
     }
 
+#if TCL_THREADS
+    /*
+     * Bytes read ahead would make the position reported by the handler
+     * disagree with what the channel has consumed, so only channels which
+     * cannot seek read ahead.
+     */
+
+    if (methods & FLAG(METH_SEEK)) {
+	rcPtr->readAheadSize = -1;
+    }
+#endif
+
     /*
      * Register the channel in the I/O system, and in our our map for 'chan
      * postevent'.
@@ -1016,6 +1060,53 @@ TimerRunRead(
     rcPtr->readTimer = NULL;
     Tcl_NotifyChannel(rcPtr->chan, TCL_READABLE);
 }
+
+#if TCL_THREADS
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReadAheadTake, ReadAheadNotify --
+ *
+ *	Hand bytes read ahead from the handler thread to the channel, and
+ *	make sure the channel hears about those still left. The handler will
+ *	not post a readable event for bytes it has delivered already.
+ *
+ * Results:
+ *	ReadAheadTake returns the number of bytes copied into buf.
+ *
+ * Side effects:
+ *	May schedule a timer notifying the channel that it is readable.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ReadAheadTake(
+    ReflectedChannel *rcPtr,
+    char *buf,
+    int toRead)
+{
+    int n = (toRead < rcPtr->readAheadLength) ? toRead
+	    : rcPtr->readAheadLength;
+
+    memcpy(buf, rcPtr->readAhead + rcPtr->readAheadStart, n);
+    rcPtr->readAheadStart += n;
+    rcPtr->readAheadLength -= n;
+    ReadAheadNotify(rcPtr);
+    return n;
+}
+
+static void
+ReadAheadNotify(
+    ReflectedChannel *rcPtr)
+{
+    if ((rcPtr->readAheadLength > 0) && (rcPtr->readTimer == NULL)
+	    && (rcPtr->owner == Tcl_GetCurrentThread())) {
+	rcPtr->readTimer = Tcl_CreateTimerHandler(SYNTHETIC_EVENT_TIME,
+		TimerRunRead, rcPtr);
+    }
+}
+#endif
 
 static void
 TimerRunWrite(
@@ -1338,16 +1429,44 @@ ReflectInput(
     unsigned char *bytev;	/* Array of returned bytes */
     Tcl_Obj *resObj;		/* Result data for 'read' */
 
+#if TCL_THREADS
+    /*
+     * Bytes read ahead by an earlier forwarded read come first, whatever
+     * thread we are in now.
+     */
+
+    if (rcPtr->readAheadLength > 0) {
+	*errorCodePtr = EOK;
+	return ReadAheadTake(rcPtr, buf, toRead);
+    }
+
     /*
      * Are we in the correct thread?
      */
 
-#if TCL_THREADS
     if (rcPtr->thread != Tcl_GetCurrentThread()) {
 	ForwardParam p;
+	int size = toRead;
+
+	/*
+	 * Every forwarded read is a round trip to the handler thread. While
+	 * the handler fills the requests completely, ask it for twice as much
+	 * each time, up to READ_AHEAD_MAX, and keep what the channel did not
+	 * ask for. A short read is taken as the handler having run dry and
+	 * starts over at the size the channel asks for.
+	 */
 
-	p.input.buf = buf;
-	p.input.toRead = toRead;
+	if (rcPtr->readAheadSize > toRead) {
+	    size = rcPtr->readAheadSize;
+	    if (rcPtr->readAheadAllocated < size) {
+		rcPtr->readAhead = (char *)Tcl_Realloc(rcPtr->readAhead, size);
+		rcPtr->readAheadAllocated = size;
+	    }
+	    p.input.buf = rcPtr->readAhead;
+	} else {
+	    p.input.buf = buf;
+	}
+	p.input.toRead = size;
 
 	ForwardOpToHandlerThread(rcPtr, ForwardedInput, &p);
 
@@ -1367,6 +1486,19 @@ ReflectInput(
 	    *errorCodePtr = EOK;
 	}
 
+	if (rcPtr->readAheadSize >= 0) {
+	    if (p.input.toRead == size && size < READ_AHEAD_MAX) {
+		rcPtr->readAheadSize = (size > READ_AHEAD_MAX / 2) ?
+			READ_AHEAD_MAX : 2 * size;
+	    } else if (p.input.toRead < size) {
+		rcPtr->readAheadSize = 0;
+	    }
+	}
+	if (p.input.buf != buf && p.input.toRead > 0) {
+	    rcPtr->readAheadStart = 0;
+	    rcPtr->readAheadLength = p.input.toRead;
+	    return ReadAheadTake(rcPtr, buf, toRead);
+	}
 	return p.input.toRead;
     }
 #endif
@@ -1673,6 +1805,12 @@ ReflectWatch(
 
     mask &= rcPtr->mode;
 
+#if TCL_THREADS
+    if (mask & TCL_READABLE) {
+	ReadAheadNotify(rcPtr);
+    }
+#endif
+
     if (mask == rcPtr->interest) {
 	/*
 	 * Same old, same old, why should we do something?
@@ -1806,8 +1944,17 @@ ReflectThread(
     switch (action) {
     case TCL_CHANNEL_THREAD_INSERT:
 	rcPtr->owner = Tcl_GetCurrentThread();
+	ReadAheadNotify(rcPtr);
 	break;
     case TCL_CHANNEL_THREAD_REMOVE:
+	/*
+	 * A pending timer belongs to the thread the channel leaves.
+	 */
+
+	if (rcPtr->readTimer != NULL) {
+	    Tcl_DeleteTimerHandler(rcPtr->readTimer);
+	    rcPtr->readTimer = NULL;
+	}
 	rcPtr->owner = NULL;
 	break;
     default:
@@ -2257,6 +2404,11 @@ NewReflectedChannel(
     rcPtr->writeTimer = 0;
 #if TCL_THREADS
     rcPtr->thread = Tcl_GetCurrentThread();
+    rcPtr->readAhead = NULL;
+    rcPtr->readAheadAllocated = 0;
+    rcPtr->readAheadStart = 0;
+    rcPtr->readAheadLength = 0;
+    rcPtr->readAheadSize = 0;
 #endif
     rcPtr->mode = mode;
     rcPtr->interest = 0;		/* Initially no interest registered */
@@ -2333,6 +2485,11 @@ FreeReflectedChannel(
     if (rcPtr->cmd) {
 	Tcl_DecrRefCount(rcPtr->cmd);
     }
+#if TCL_THREADS
+    if (rcPtr->readAhead) {
+	Tcl_Free(rcPtr->readAhead);
+    }
+#endif
     Tcl_Free(rcPtr);
 }
 
@@ -2712,7 +2869,7 @@ DeleteReflectedChannelMap(
 
 	ForwardSetStaticError(paramPtr, msg_send_dstlost);
 
-	Tcl_ConditionNotify(&resultPtr->done);
+	Tcl_ConditionNotify(resultPtr->donePtr);
     }
     Tcl_MutexUnlock(&rcForwardMutex);
 
@@ -2865,7 +3022,7 @@ DeleteThreadReflectedChannelMap(
 
 	ForwardSetStaticError(paramPtr, msg_send_dstlost);
 
-	Tcl_ConditionNotify(&resultPtr->done);
+	Tcl_ConditionNotify(resultPtr->donePtr);
     }
     Tcl_MutexUnlock(&rcForwardMutex);
 
@@ -2947,7 +3104,7 @@ ForwardOpToHandlerThread(
     resultPtr->src = Tcl_GetCurrentThread();
     resultPtr->dst = dst;
     resultPtr->dsti = rcPtr->interp;
-    resultPtr->done = NULL;
+    resultPtr->donePtr = TclChanForwardCondition();
     resultPtr->result = -1;
     resultPtr->evPtr = evPtr;
 
@@ -2993,7 +3150,7 @@ ForwardOpToHandlerThread(
 	 * immediately after.
 	 */
 
-	Tcl_ConditionWait(&resultPtr->done, &rcForwardMutex, NULL);
+	Tcl_ConditionWait(resultPtr->donePtr, &rcForwardMutex, NULL);
     }
 
     /*
@@ -3007,7 +3164,6 @@ ForwardOpToHandlerThread(
     resultPtr->prevPtr = NULL;
 
     Tcl_MutexUnlock(&rcForwardMutex);
-    Tcl_ConditionFinalize(&resultPtr->done);
 
     /*
      * Kill the cleanup handler now, and the result structure as well, before
@@ -3020,6 +3176,49 @@ ForwardOpToHandlerThread(
 
     Tcl_Free(resultPtr);
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclChanForwardCondition --
+ *
+ *	A thread has at most one forward in flight, as it blocks until that
+ *	forward is done. The condition variable it waits on is therefore kept
+ *	per thread and used by all its forwards, instead of being created and
+ *	finalized for each one, which takes the global lock of the sync object
+ *	registry twice. Used by the forwards of reflected channels and
+ *	reflected transforms alike.
+ *
+ * Results:
+ *	The condition variable of the current thread.
+ *
+ * Side effects:
+ *	Registers a thread exit handler finalizing the condition variable.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Condition *
+TclChanForwardCondition(void)
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+
+    if (!tsdPtr->forwardDoneExit) {
+	Tcl_CreateThreadExitHandler(FinalizeForwardCondition, NULL);
+	tsdPtr->forwardDoneExit = 1;
+    }
+    return &tsdPtr->forwardDone;
+}
+
+static void
+FinalizeForwardCondition(
+    TCL_UNUSED(void *))
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+
+    Tcl_ConditionFinalize(&tsdPtr->forwardDone);
+    tsdPtr->forwardDoneExit = 0;
+}
 
 static int
 ForwardProc(
@@ -3380,7 +3579,7 @@ ForwardProc(
 
 	Tcl_MutexLock(&rcForwardMutex);
 	resultPtr->result = TCL_OK;
-	Tcl_ConditionNotify(&resultPtr->done);
+	Tcl_ConditionNotify(resultPtr->donePtr);
 	Tcl_MutexUnlock(&rcForwardMutex);
     }
 
@@ -3432,7 +3631,7 @@ SrcExitProc(
      * "ForwardProc". Maybe.
      */
 
-    Tcl_ConditionNotify(&resultPtr->done);
+    Tcl_ConditionNotify(resultPtr->donePtr);
 }
 
 static void
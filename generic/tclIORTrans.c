@@ -84,8 +84,9 @@ static const Tcl_ChannelType tclRTransformType = {
 typedef struct {
     unsigned char *buf;		/* Reference to the buffer area. */
     size_t allocated;		/* Allocated size of the buffer area. */
-    size_t used;		/* Number of bytes in the buffer,
-				 * <= allocated. */
+    size_t start;		/* Offset of the first unconsumed byte. */
+    size_t used;		/* Number of unconsumed bytes in the buffer,
+				 * start + used <= allocated. */
 } ResultBuffer;
 
 #define ResultLength(r) ((r)->used)
@@ -97,6 +98,9 @@ static inline void	ResultAdd(ResultBuffer *r, unsigned char *buf,
 			    size_t toWrite);
 static inline size_t	ResultCopy(ResultBuffer *r, unsigned char *buf,
 			    size_t toRead);
+static inline size_t	ResultDeliver(ResultBuffer *r, unsigned char *dst,
+			    size_t dstLen, unsigned char *buf,
+			    size_t toWrite);
 
 #define RB_INCREMENT (512)
 
@@ -314,7 +318,7 @@ struct ForwardingResult {
     Tcl_ThreadId dst;		/* Thread the op was forwarded to. */
     Tcl_Interp *dsti;		/* Interpreter in the thread the op was
 				 * forwarded to. */
-    Tcl_Condition done;		/* Condition variable the forwarder blocks
+    Tcl_Condition *donePtr;	/* Condition variable the forwarder blocks
 				 * on. */
     int result;			/* TCL_OK or TCL_ERROR */
     ForwardingEvent *evPtr;	/* Event the result belongs to. */
@@ -452,7 +456,8 @@ static void		TimerKill(ReflectedTransform *rtPtr);
 static void		TimerSetup(ReflectedTransform *rtPtr);
 static void		TimerRun(void *clientData);
 static int		TransformRead(ReflectedTransform *rtPtr,
-			    int *errorCodePtr, Tcl_Obj *bufObj);
+			    int *errorCodePtr, Tcl_Obj *bufObj,
+			    char *dst, int *dstLenPtr);
 static int		TransformWrite(ReflectedTransform *rtPtr,
 			    int *errorCodePtr, unsigned char *buf,
 			    int toWrite);
@@ -1200,15 +1205,18 @@ ReflectInput(
 	} /* readBytes == 0 */
 
 	/*
-	 * Transform the read chunk, which was not empty. Anything we got back
-	 * is a transformation result is put into our buffers, and the next
-	 * iteration will put it into the result.
+	 * The transformation result is placed directly into 'buf' where
+	 * possible, saving the round trip through the result buffer.
 	 */
 
 	Tcl_SetByteArrayLength(bufObj, readBytes);
-	if (!TransformRead(rtPtr, errorCodePtr, bufObj)) {
+	copied = toRead;
+	if (!TransformRead(rtPtr, errorCodePtr, bufObj, buf, &copied)) {
 	    goto error;
 	}
+	toRead -= copied;
+	buf += copied;
+	gotBytes += copied;
 	if (Tcl_IsShared(bufObj)) {
 	    Tcl_DecrRefCount(bufObj);
 	    TclNewObj(bufObj);
@@ -2213,7 +2221,7 @@ DeleteReflectedTransformMap(
 
 	ForwardSetStaticError(paramPtr, msg_send_dstlost);
 
-	Tcl_ConditionNotify(&resultPtr->done);
+	Tcl_ConditionNotify(resultPtr->donePtr);
     }
     Tcl_MutexUnlock(&rtForwardMutex);
 #endif /* TCL_THREADS */
@@ -2341,7 +2349,7 @@ DeleteThreadReflectedTransformMap(
 
 	ForwardSetStaticError(paramPtr, msg_send_dstlost);
 
-	Tcl_ConditionNotify(&resultPtr->done);
+	Tcl_ConditionNotify(resultPtr->donePtr);
     }
     Tcl_MutexUnlock(&rtForwardMutex);
 }
@@ -2390,7 +2398,7 @@ ForwardOpToOwnerThread(
     resultPtr->src = Tcl_GetCurrentThread();
     resultPtr->dst = dst;
     resultPtr->dsti = rtPtr->interp;
-    resultPtr->done = NULL;
+    resultPtr->donePtr = TclChanForwardCondition();
     resultPtr->result = -1;
     resultPtr->evPtr = evPtr;
 
@@ -2433,7 +2441,7 @@ ForwardOpToOwnerThread(
 	 * immediately after.
 	 */
 
-	Tcl_ConditionWait(&resultPtr->done, &rtForwardMutex, NULL);
+	Tcl_ConditionWait(resultPtr->donePtr, &rtForwardMutex, NULL);
     }
 
     /*
@@ -2447,7 +2455,6 @@ ForwardOpToOwnerThread(
     resultPtr->prevPtr = NULL;
 
     Tcl_MutexUnlock(&rtForwardMutex);
-    Tcl_ConditionFinalize(&resultPtr->done);
 
     /*
      * Kill the cleanup handler now, and the result structure as well, before
@@ -2711,7 +2718,7 @@ ForwardProc(
 
 	Tcl_MutexLock(&rtForwardMutex);
 	resultPtr->result = TCL_OK;
-	Tcl_ConditionNotify(&resultPtr->done);
+	Tcl_ConditionNotify(resultPtr->donePtr);
 	Tcl_MutexUnlock(&rtForwardMutex);
     }
 
@@ -2763,7 +2770,7 @@ SrcExitProc(
      * "ForwardProc". Maybe.
      */
 
-    Tcl_ConditionNotify(&resultPtr->done);
+    Tcl_ConditionNotify(resultPtr->donePtr);
 }
 
 static void
@@ -2890,6 +2897,7 @@ ResultInit(
     ResultBuffer *rPtr)		/* Reference to the structure to
 				 * initialize. */
 {
+    rPtr->start = 0;
     rPtr->used = 0;
     rPtr->allocated = 0;
     rPtr->buf = NULL;
@@ -2914,6 +2922,7 @@ static inline void
 ResultClear(
     ResultBuffer *rPtr)		/* Reference to the buffer to clear out */
 {
+    rPtr->start = 0;
     rPtr->used = 0;
 
     if (!rPtr->allocated) {
@@ -2947,17 +2956,37 @@ ResultAdd(
     unsigned char *buf,		/* The buffer to read from */
     size_t toWrite)		/* The number of bytes in 'buf' */
 {
-    if ((rPtr->used + toWrite + 1) > rPtr->allocated) {
-	/*
-	 * Extension of the internal buffer is required.
-	 * NOTE: Currently linear. Should be doubling to amortize.
-	 */
+    if (rPtr->used == 0) {
+	rPtr->start = 0;
+    }
 
-	if (rPtr->allocated == 0) {
+    if ((rPtr->start + rPtr->used + toWrite + 1) > rPtr->allocated) {
+	if ((rPtr->used + toWrite + 1) <= rPtr->allocated) {
+	    /*
+	     * Enough room once the consumed prefix is dropped.
+	     */
+
+	    memmove(rPtr->buf, rPtr->buf + rPtr->start, rPtr->used);
+	    rPtr->start = 0;
+	} else if (rPtr->allocated == 0) {
 	    rPtr->allocated = toWrite + RB_INCREMENT;
 	    rPtr->buf = UCHARP(Tcl_Alloc(rPtr->allocated));
 	} else {
-	    rPtr->allocated += toWrite + RB_INCREMENT;
+	    /*
+	     * Extension of the internal buffer is required. Grow
+	     * geometrically to amortize the cost of repeated additions.
+	     */
+
+	    size_t needed = rPtr->used + toWrite + RB_INCREMENT;
+
+	    if (rPtr->start > 0) {
+		memmove(rPtr->buf, rPtr->buf + rPtr->start, rPtr->used);
+		rPtr->start = 0;
+	    }
+	    rPtr->allocated *= 2;
+	    if (rPtr->allocated < needed) {
+		rPtr->allocated = needed;
+	    }
 	    rPtr->buf = UCHARP(Tcl_Realloc((char *) rPtr->buf,
 		    rPtr->allocated));
 	}
@@ -2967,7 +2996,7 @@ ResultAdd(
      * Now copy data.
      */
 
-    memcpy(rPtr->buf + rPtr->used, buf, toWrite);
+    memcpy(rPtr->buf + rPtr->start + rPtr->used, buf, toWrite);
     rPtr->used += toWrite;
 }
 
@@ -2995,47 +3024,65 @@ ResultCopy(
     unsigned char *buf,		/* The buffer to copy into */
     size_t toRead)			/* Number of requested bytes */
 {
-    int copied;
+    size_t copied = (rPtr->used < toRead) ? rPtr->used : toRead;
 
-    if (rPtr->used == 0) {
+    if (copied == 0) {
 	/*
 	 * Nothing to copy in the case of an empty buffer.
 	 */
 
-	copied = 0;
-    } else if (rPtr->used == (size_t)toRead) {
-	/*
-	 * We have just enough. Copy everything to the caller.
-	 */
+	return 0;
+    }
 
-	memcpy(buf, rPtr->buf, toRead);
-	rPtr->used = 0;
-	copied = toRead;
-    } else if (rPtr->used > (size_t)toRead) {
-	/*
-	 * The internal buffer contains more than requested. Copy the
-	 * requested subset to the caller, and shift the remaining bytes down.
-	 */
+    /*
+     * Consumed bytes are not shifted down here, only skipped. The space is
+     * reclaimed by the next 'ResultAdd', or immediately when the buffer
+     * becomes empty. This keeps draining a large result in small chunks
+     * linear instead of quadratic.
+     */
 
-	memcpy(buf, rPtr->buf, toRead);
-	memmove(rPtr->buf, rPtr->buf + toRead, rPtr->used - toRead);
+    memcpy(buf, rPtr->buf + rPtr->start, copied);
+    rPtr->used -= copied;
+    rPtr->start = (rPtr->used == 0) ? 0 : rPtr->start + copied;
+    return copied;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ResultDeliver --
+ *
+ *	Hands a fresh transformation result to a reader. When nothing is
+ *	queued in the buffer the bytes go straight into the reader's array,
+ *	and only the part that does not fit is queued. Otherwise everything is
+ *	appended to the buffer, to keep the order of the data intact.
+ *
+ * Side effects:
+ *	See above.
+ *
+ * Result:
+ *	The number of bytes copied into 'dst'.
+ *
+ *----------------------------------------------------------------------
+ */
 
-	rPtr->used -= toRead;
-	copied = toRead;
-    } else {
-	/*
-	 * There is not enough in the buffer to satisfy the caller, so take
-	 * everything.
-	 */
+static inline size_t
+ResultDeliver(
+    ResultBuffer *rPtr,		/* The buffer to queue the excess in */
+    unsigned char *dst,		/* The reader's array, or NULL */
+    size_t dstLen,		/* Space available in 'dst' */
+    unsigned char *buf,		/* The transformation result */
+    size_t toWrite)		/* The number of bytes in 'buf' */
+{
+    size_t copied = 0;
 
-	memcpy(buf, rPtr->buf, rPtr->used);
-	toRead = rPtr->used;
-	rPtr->used = 0;
-	copied = toRead;
+    if ((dst != NULL) && (rPtr->used == 0)) {
+	copied = (toWrite < dstLen) ? toWrite : dstLen;
+	memcpy(dst, buf, copied);
+    }
+    if (copied < toWrite) {
+	ResultAdd(rPtr, buf + copied, toWrite - copied);
     }
-
-    /* -- common postwork code ------- */
-
     return copied;
 }
 
@@ -3043,7 +3090,10 @@ static int
 TransformRead(
     ReflectedTransform *rtPtr,
     int *errorCodePtr,
-    Tcl_Obj *bufObj)
+    Tcl_Obj *bufObj,
+    char *dst,			/* Where to place the result directly. */
+    int *dstLenPtr)		/* In: space available in 'dst'. Out: number
+				 * of bytes placed there. */
 {
     Tcl_Obj *resObj;
     Tcl_Size bytec = 0;		/* Number of returned bytes */
@@ -3069,7 +3119,8 @@ TransformRead(
 	}
 
 	*errorCodePtr = EOK;
-	ResultAdd(&rtPtr->result, UCHARP(p.transform.buf), p.transform.size);
+	*dstLenPtr = ResultDeliver(&rtPtr->result, UCHARP(dst), *dstLenPtr,
+		UCHARP(p.transform.buf), p.transform.size);
 	Tcl_Free(p.transform.buf);
 	return 1;
     }
@@ -3086,7 +3137,8 @@ TransformRead(
     }
 
     bytev = Tcl_GetBytesFromObj(NULL, resObj, &bytec);
-    ResultAdd(&rtPtr->result, bytev, bytec);
+    *dstLenPtr = ResultDeliver(&rtPtr->result, UCHARP(dst), *dstLenPtr,
+	    bytev, bytec);
 
     Tcl_DecrRefCount(resObj);		/* Remove reference held from invoke */
     return 1;
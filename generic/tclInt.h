@@ -1632,6 +1632,11 @@ typedef struct ExecEnv {
 				/* Top callback in NRE's stack. */
     struct CoroutineData *corPtr;
     int rewind;
+    CmdFrame *tebcFramePtr;	/* Frame of the innermost bytecode executing
+				 * in this environment, or NULL. It is only
+				 * linked into the interp's command frames
+				 * while the bytecode calls out, but keeps the
+				 * pc of the command it is running. */
 } ExecEnv;
 
 #define COR_IS_SUSPENDED(corPtr) \
@@ -3125,6 +3130,16 @@ enum CheckEmptyStringResult {
 	TCL_EMPTYSTRING_UNKNOWN = -1, TCL_EMPTYSTRING_NO, TCL_EMPTYSTRING_YES
 };
 
+/*
+ * Kinds of event handlers told apart by [::tcl::unsupported::eventstats],
+ * see TclEventStatsRecord.
+ */
+
+enum TclEventStatsKind {
+    TCL_EVSTATS_ASYNC, TCL_EVSTATS_EVENT, TCL_EVSTATS_TIMER, TCL_EVSTATS_IDLE,
+    TCL_EVSTATS_KINDS
+};
+
 /*
  *----------------------------------------------------------------
  * Procedures shared among Tcl modules but not used by the outside world,
@@ -3261,7 +3276,12 @@ MODULE_SCOPE int	TclCheckArrayTraces(Tcl_Interp *interp, Var *varPtr,
 MODULE_SCOPE int	TclCheckEmptyString(Tcl_Obj *objPtr);
 MODULE_SCOPE int	TclChanCaughtErrorBypass(Tcl_Interp *interp,
 			    Tcl_Channel chan);
+MODULE_SCOPE Tcl_Condition *TclChanForwardCondition(void);
+MODULE_SCOPE void	TclChannelCollectStats(Tcl_Channel chan, int enable);
+MODULE_SCOPE Tcl_Obj *	TclChannelGetStats(Tcl_Channel chan);
 MODULE_SCOPE Tcl_ObjCmdProc TclChannelNamesCmd;
+MODULE_SCOPE Tcl_Size	TclReadLines(Tcl_Channel chan, Tcl_Obj *listPtr,
+			    Tcl_Size maxLines);
 MODULE_SCOPE Tcl_NRPostProc TclClearRootEnsemble;
 MODULE_SCOPE int	TclCompareTwoNumbers(Tcl_Obj *valuePtr,
 			    Tcl_Obj *value2Ptr);
@@ -3317,6 +3337,18 @@ MODULE_SCOPE Tcl_Obj *const *TclFetchEnsembleRoot(Tcl_Interp *interp,
 MODULE_SCOPE Tcl_Obj *const *TclEnsembleGetRewriteValues(Tcl_Interp *interp);
 MODULE_SCOPE Tcl_Namespace *TclEnsureNamespace(Tcl_Interp *interp,
 			    Tcl_Namespace *namespacePtr);
+MODULE_SCOPE int	tclAllocProfiling;
+MODULE_SCOPE void	TclAllocProfileAlloc(void *ptr, size_t size);
+MODULE_SCOPE void	TclAllocProfileFree(void *ptr);
+MODULE_SCOPE Tcl_ObjCmdProc TclAllocProfileObjCmd;
+MODULE_SCOPE void	TclAllocProfileRealloc(void *oldPtr, void *newPtr,
+			    size_t size);
+MODULE_SCOPE Tcl_ObjCmdProc TclEventStatsObjCmd;
+MODULE_SCOPE int	TclEventStatsEnabled(void);
+MODULE_SCOPE void	TclEventStatsIdle(Tcl_Size backlog);
+MODULE_SCOPE void	TclEventStatsRecord(int kind, long long start);
+MODULE_SCOPE void	TclEventStatsScript(Tcl_Obj *scriptPtr);
+MODULE_SCOPE long long	TclEventStatsStart(void);
 MODULE_SCOPE void	TclFinalizeAllocSubsystem(void);
 MODULE_SCOPE void	TclFinalizeAsync(void);
 MODULE_SCOPE void	TclFinalizeDoubleConversion(void);
@@ -3341,6 +3373,8 @@ MODULE_SCOPE void	TclFinalizeThreadData(int quick);
 MODULE_SCOPE void	TclFinalizeThreadObjects(void);
 MODULE_SCOPE double	TclFloor(const void *a);
 MODULE_SCOPE void	TclFormatNaN(double value, char *buffer);
+MODULE_SCOPE Tcl_Obj *	TclFormatObj(Tcl_Interp *interp, Tcl_Obj *formatObj,
+			    Tcl_Size objc, Tcl_Obj *const objv[]);
 MODULE_SCOPE int	TclFSFileAttrIndex(Tcl_Obj *pathPtr,
 			    const char *attributeName, int *indexPtr);
 MODULE_SCOPE Tcl_Command TclNRCreateCommandInNs(Tcl_Interp *interp,
@@ -3534,6 +3568,14 @@ MODULE_SCOPE void	TclRemoveScriptLimitCallbacks(Tcl_Interp *interp);
 MODULE_SCOPE int	TclReToGlob(Tcl_Interp *interp, const char *reStr,
 			    Tcl_Size reStrLen, Tcl_DString *dsPtr, int *flagsPtr,
 			    int *quantifiersFoundPtr);
+MODULE_SCOPE const Tcl_UniChar *TclGetRegExpSubject(Tcl_Obj *textObj,
+			    Tcl_DString *dsPtr, Tcl_Size *lengthPtr);
+MODULE_SCOPE int	TclRegExpExecChars(Tcl_Interp *interp, Tcl_RegExp re,
+			    Tcl_Obj *textObj, const Tcl_UniChar *chars,
+			    Tcl_Size numChars, Tcl_Size offset,
+			    Tcl_Size nmatches, int flags);
+MODULE_SCOPE int	TclRegExpMatchSet(Tcl_Interp *interp,
+			    Tcl_Obj *patternsObj, Tcl_Obj *textObj, int flags);
 MODULE_SCOPE Tcl_Size	TclScanElement(const char *string, Tcl_Size length,
 			    char *flagPtr);
 MODULE_SCOPE void	TclSetBgErrorHandler(Tcl_Interp *interp,
@@ -3734,9 +3776,13 @@ MODULE_SCOPE Tcl_ObjCmdProc Tcl_PutsObjCmd;
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_PwdObjCmd;
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_ReadObjCmd;
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_RegexpObjCmd;
+MODULE_SCOPE Tcl_ObjCmdProc TclRegexpCacheObjCmd;
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_RegsubObjCmd;
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_RenameObjCmd;
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_RepresentationCmd;
+MODULE_SCOPE int	tclInterning;
+MODULE_SCOPE Tcl_Obj *	TclInternObj(const char *bytes, Tcl_Size length);
+MODULE_SCOPE Tcl_ObjCmdProc TclInterningObjCmd;
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_ReturnObjCmd;
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_ScanObjCmd;
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_SeekObjCmd;
@@ -3936,6 +3982,8 @@ MODULE_SCOPE Tcl_Obj *	TclStringFirst(Tcl_Obj *needle, Tcl_Obj *haystack,
 			    Tcl_Size start);
 MODULE_SCOPE Tcl_Obj *	TclStringLast(Tcl_Obj *needle, Tcl_Obj *haystack,
 			    Tcl_Size last);
+MODULE_SCOPE Tcl_Obj *	TclStringMap(Tcl_Interp *interp, Tcl_Obj *mapObj,
+			    Tcl_Obj *sourceObj, int nocase);
 MODULE_SCOPE Tcl_Obj *	TclStringRepeat(Tcl_Interp *interp, Tcl_Obj *objPtr,
 			    Tcl_Size count, int flags);
 MODULE_SCOPE Tcl_Obj *	TclStringReplace(Tcl_Interp *interp, Tcl_Obj *objPtr,
@@ -4158,11 +4206,26 @@ TclScaleTime(
 #  define TclIncrObjsFreed()
 #endif /* TCL_COMPILE_STATS */
 
+/*
+ * Tcl_Obj storage allocated and freed without an interp is seen by the
+ * allocation profiler, see TclAllocProfileObjCmd.
+ */
+
 #  define TclAllocObjStorage(objPtr)		\
-	TclAllocObjStorageEx(NULL, (objPtr))
+    do {					\
+	TclAllocObjStorageEx(NULL, (objPtr));	\
+	if (tclAllocProfiling) {		\
+	    TclAllocProfileAlloc((objPtr), sizeof(Tcl_Obj)); \
+	}					\
+    } while (0)
 
 #  define TclFreeObjStorage(objPtr)		\
-	TclFreeObjStorageEx(NULL, (objPtr))
+    do {					\
+	if (tclAllocProfiling) {		\
+	    TclAllocProfileFree(objPtr);	\
+	}					\
+	TclFreeObjStorageEx(NULL, (objPtr));	\
+    } while (0)
 
 #ifndef TCL_MEM_DEBUG
 # define TclNewObj(objPtr) \
@@ -5033,9 +5096,49 @@ typedef struct NRE_callback {
 #include "tclIntPlatDecls.h"
 
 #if !defined(USE_TCL_STUBS) && !defined(TCL_MEM_DEBUG)
-#define Tcl_AttemptAlloc        TclpAlloc
-#define Tcl_AttemptRealloc      TclpRealloc
-#define Tcl_Free                TclpFree
+/*
+ * The core skips the wrappers in tclCkalloc.c for these, but must still let
+ * the allocation profiler see the memory, see TclAllocProfileObjCmd.
+ */
+
+static inline void *
+TclAttemptAllocInline(
+    size_t size)
+{
+    void *ptr = TclpAlloc(size);
+
+    if (tclAllocProfiling) {
+	TclAllocProfileAlloc(ptr, size);
+    }
+    return ptr;
+}
+
+static inline void *
+TclAttemptReallocInline(
+    void *oldPtr,
+    size_t size)
+{
+    void *ptr = TclpRealloc(oldPtr, size);
+
+    if (tclAllocProfiling) {
+	TclAllocProfileRealloc(oldPtr, ptr, size);
+    }
+    return ptr;
+}
+
+static inline void
+TclFreeInline(
+    void *ptr)
+{
+    if (tclAllocProfiling) {
+	TclAllocProfileFree(ptr);
+    }
+    TclpFree(ptr);
+}
+
+#define Tcl_AttemptAlloc        TclAttemptAllocInline
+#define Tcl_AttemptRealloc      TclAttemptReallocInline
+#define Tcl_Free                TclFreeInline
 #endif
 
 /*
@@ -3406,6 +3406,19 @@ SetListFromAny(
 		break;
 	    }
 
+	    /*
+	     * Share small literal elements through the interning cache when
+	     * it is switched on. A single element list may map to the very
+	     * value being converted; it must not become its own element.
+	     */
+
+	    if (literal && tclInterning
+		    && (*elemPtrs = TclInternObj(elemStart, elemSize))
+		    && (*elemPtrs != objPtr)) {
+		Tcl_IncrRefCount(*elemPtrs++);
+		continue;
+	    }
+
 	    TclNewObj(*elemPtrs);
 	    TclInvalidateStringRep(*elemPtrs);
 	    check = Tcl_InitStringRep(*elemPtrs, literal ? elemStart : NULL,
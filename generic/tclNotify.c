@@ -39,6 +39,47 @@ typedef struct EventSource {
     struct EventSource *nextPtr;
 } EventSource;
 
+/*
+ * Statistics about the event loop of a thread, collected on request by
+ * [::tcl::unsupported::eventstats]. They are only allocated (and maintained)
+ * while collection is switched on for the thread. All times are in
+ * microseconds; histogram bucket i counts the values below 2**i.
+ */
+
+#define EVENT_STATS_BUCKETS	24
+
+typedef struct EventStatsFrame {
+    Tcl_Obj *script;		/* Script run by the handler, if any. */
+    int nested;			/* Whether the handler ran other handlers
+				 * itself. */
+} EventStatsFrame;
+
+typedef struct EventStats {
+    Tcl_WideInt handled[TCL_EVSTATS_KINDS];
+				/* Number of handlers run, by kind. */
+    Tcl_WideInt handlerTime[TCL_EVSTATS_KINDS][EVENT_STATS_BUCKETS];
+				/* Histograms of their running time. */
+    Tcl_WideInt queueWait[EVENT_STATS_BUCKETS];
+				/* Histogram of the time that queued events
+				 * waited before being handled. */
+    Tcl_HashTable queuedAt;	/* When the events still in the queue were
+				 * queued, relative to 'base', as allocated
+				 * long longs. Keyed by event. */
+    long long base;		/* When collection was switched on. */
+    Tcl_WideInt waits;		/* Number of waits for the notifier. */
+    long long waitTime;		/* Total time spent in those waits. */
+    Tcl_Size idleBacklog;	/* Number of idle handlers pending at the
+				 * start of the last idle pass. */
+    Tcl_Size idleBacklogMax;	/* Largest such number seen. */
+    EventStatsFrame *frames;	/* The handlers currently running, innermost
+				 * last. */
+    int depth;			/* Number of handlers currently running. */
+    int framesSize;		/* Number of frames allocated. */
+    int longestKind;		/* Kind of the longest running handler. */
+    long long longestTime;	/* Its running time, or 0 if none ran. */
+    Tcl_Obj *longestScript;	/* Its script, or NULL. */
+} EventStats;
+
 /*
  * The following structure keeps track of the state of the notifier on a
  * per-thread basis. The first three elements keep track of the event queue.
@@ -74,27 +115,45 @@ typedef struct ThreadSpecificData {
     void *clientData;	/* Opaque handle for platform specific
 				 * notifier. */
     int initialized;		/* 1 if notifier has been initialized. */
-    struct ThreadSpecificData *nextPtr;
-				/* Next notifier in global list of notifiers.
-				 * Access is controlled by the listLock global
-				 * mutex. */
+    EventStats *statsPtr;	/* Event loop statistics, or NULL when they
+				 * are not being collected. Access is
+				 * controlled by the queueMutex. */
 } ThreadSpecificData;
 
 static Tcl_ThreadDataKey dataKey;
 
 /*
- * Global list of notifiers. Access to this list is controlled by the listLock
- * mutex. If this becomes a performance bottleneck, this could be replaced
- * with a hashtable.
+ * Global table of notifiers, keyed by the thread that owns them. Access to
+ * this table is controlled by the listLock mutex. The table is created with
+ * the first notifier and deleted again with the last one.
  */
 
-static ThreadSpecificData *firstNotifierPtr = NULL;
+static Tcl_HashTable notifierTable;
+static int notifierTableInit = 0;
 TCL_DECLARE_MUTEX(listLock)
 
+/*
+ * Number of threads collecting event loop statistics. Lets the hooks for
+ * that return at once in the common case, without looking up thread data.
+ * Modified under the listLock.
+ */
+
+static int eventStatsThreads = 0;
+
+static const char *const eventStatsKinds[] = {
+    "async", "event", "timer", "idle"
+};
+
 /*
  * Declarations for routines used only in this file.
  */
 
+static ThreadSpecificData *FindNotifier(Tcl_ThreadId threadId);
+static void		EventStatsDrop(ThreadSpecificData *tsdPtr,
+			    long long start);
+static void		FreeEventStats(ThreadSpecificData *tsdPtr);
+static int		EventStatsBucket(long long usec);
+static Tcl_Obj *	EventStatsHistogram(const Tcl_WideInt *buckets);
 static int		QueueEvent(ThreadSpecificData *tsdPtr,
 			    Tcl_Event *evPtr, int position);
 
@@ -120,14 +179,17 @@ TclInitNotifier(void)
 {
     ThreadSpecificData *tsdPtr;
     Tcl_ThreadId threadId = Tcl_GetCurrentThread();
+    Tcl_HashEntry *hPtr;
+    int isNew;
 
     Tcl_MutexLock(&listLock);
-    for (tsdPtr = firstNotifierPtr; tsdPtr && tsdPtr->threadId != threadId;
-	    tsdPtr = tsdPtr->nextPtr) {
-	/* Empty loop body. */
+    if (!notifierTableInit) {
+	Tcl_InitHashTable(&notifierTable, TCL_ONE_WORD_KEYS);
+	notifierTableInit = 1;
     }
+    hPtr = Tcl_CreateHashEntry(&notifierTable, threadId, &isNew);
 
-    if (NULL == tsdPtr) {
+    if (isNew) {
 	/*
 	 * Notifier not yet initialized in this thread.
 	 */
@@ -136,12 +198,45 @@ TclInitNotifier(void)
 	tsdPtr->threadId = threadId;
 	tsdPtr->clientData = Tcl_InitNotifier();
 	tsdPtr->initialized = 1;
-	tsdPtr->nextPtr = firstNotifierPtr;
-	firstNotifierPtr = tsdPtr;
+	Tcl_SetHashValue(hPtr, tsdPtr);
     }
     Tcl_MutexUnlock(&listLock);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * FindNotifier --
+ *
+ *	Look up the notifier of the given thread. The caller must hold the
+ *	listLock, and keep holding it while using the result.
+ *
+ * Results:
+ *	The thread local notifier data of the thread, or NULL if the thread
+ *	has no notifier.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ThreadSpecificData *
+FindNotifier(
+    Tcl_ThreadId threadId)	/* Identifier for thread to look up. */
+{
+    Tcl_HashEntry *hPtr;
+
+    if (!notifierTableInit) {
+	return NULL;
+    }
+    hPtr = Tcl_FindHashEntry(&notifierTable, threadId);
+    if (hPtr == NULL) {
+	return NULL;
+    }
+    return (ThreadSpecificData *)Tcl_GetHashValue(hPtr);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -171,7 +266,7 @@ void
 TclFinalizeNotifier(void)
 {
     ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
-    ThreadSpecificData **prevPtrPtr;
+    Tcl_HashEntry *hPtr;
     Tcl_Event *evPtr, *hold;
 
     if (!tsdPtr->initialized) {
@@ -186,18 +281,20 @@ TclFinalizeNotifier(void)
     }
     tsdPtr->firstEventPtr = NULL;
     tsdPtr->lastEventPtr = NULL;
+    FreeEventStats(tsdPtr);
     Tcl_MutexUnlock(&(tsdPtr->queueMutex));
 
     Tcl_MutexLock(&listLock);
 
     Tcl_FinalizeNotifier(tsdPtr->clientData);
     Tcl_MutexFinalize(&(tsdPtr->queueMutex));
-    for (prevPtrPtr = &firstNotifierPtr; *prevPtrPtr != NULL;
-	    prevPtrPtr = &((*prevPtrPtr)->nextPtr)) {
-	if (*prevPtrPtr == tsdPtr) {
-	    *prevPtrPtr = tsdPtr->nextPtr;
-	    break;
-	}
+    hPtr = Tcl_FindHashEntry(&notifierTable, tsdPtr->threadId);
+    if (hPtr != NULL) {
+	Tcl_DeleteHashEntry(hPtr);
+    }
+    if (notifierTable.numEntries == 0) {
+	Tcl_DeleteHashTable(&notifierTable);
+	notifierTableInit = 0;
     }
     tsdPtr->initialized = 0;
 
@@ -428,15 +525,28 @@ Tcl_ThreadQueueEvent(
 {
     ThreadSpecificData *tsdPtr;
 
+    /*
+     * Events for the current thread need neither the global lock, since
+     * the notifier cannot go away under our feet, nor an alert, since the
+     * thread is obviously awake.
+     */
+
+    if (threadId == Tcl_GetCurrentThread()) {
+	tsdPtr = TCL_TSD_INIT(&dataKey);
+	if (tsdPtr->initialized) {
+	    QueueEvent(tsdPtr, evPtr, position);
+	} else {
+	    Tcl_Free(evPtr);
+	}
+	return;
+    }
+
     /*
      * Find the notifier associated with the specified thread.
      */
 
     Tcl_MutexLock(&listLock);
-    for (tsdPtr = firstNotifierPtr; tsdPtr && tsdPtr->threadId != threadId;
-	    tsdPtr = tsdPtr->nextPtr) {
-	/* Empty loop body. */
-    }
+    tsdPtr = FindNotifier(threadId);
 
     /*
      * Queue the event if there was a notifier associated with the thread.
@@ -530,6 +640,21 @@ QueueEvent(
 	    tsdPtr->lastEventPtr = evPtr;
 	}
     }
+    if (tsdPtr->statsPtr != NULL) {
+	EventStats *statsPtr = tsdPtr->statsPtr;
+	Tcl_HashEntry *hPtr;
+	long long *queuedPtr;
+	int isNew;
+
+	hPtr = Tcl_CreateHashEntry(&statsPtr->queuedAt, evPtr, &isNew);
+	if (isNew) {
+	    queuedPtr = (long long *)Tcl_Alloc(sizeof(long long));
+	    Tcl_SetHashValue(hPtr, queuedPtr);
+	} else {
+	    queuedPtr = (long long *)Tcl_GetHashValue(hPtr);
+	}
+	*queuedPtr = TclpGetMicroseconds() - statsPtr->base;
+    }
     Tcl_MutexUnlock(&(tsdPtr->queueMutex));
     return position & TCL_QUEUE_ALERT_IF_EMPTY;
 }
@@ -601,6 +726,15 @@ Tcl_DeleteEvents(
 	     * Delete the event data structure.
 	     */
 
+	    if (tsdPtr->statsPtr != NULL) {
+		Tcl_HashEntry *hPtr = Tcl_FindHashEntry(
+			&tsdPtr->statsPtr->queuedAt, evPtr);
+
+		if (hPtr != NULL) {
+		    Tcl_Free(Tcl_GetHashValue(hPtr));
+		    Tcl_DeleteHashEntry(hPtr);
+		}
+	    }
 	    hold = evPtr;
 	    evPtr = evPtr->nextPtr;
 	    Tcl_Free(hold);
@@ -648,6 +782,7 @@ Tcl_ServiceEvent(
     Tcl_Event *evPtr, *prevPtr;
     Tcl_EventProc *proc;
     int result;
+    long long start;
     ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
 
     /*
@@ -657,7 +792,9 @@ Tcl_ServiceEvent(
      */
 
     if (Tcl_AsyncReady()) {
+	start = TclEventStatsStart();
 	(void) Tcl_AsyncInvoke(NULL, 0);
+	TclEventStatsRecord(TCL_EVSTATS_ASYNC, start);
 	return 1;
     }
 
@@ -707,6 +844,7 @@ Tcl_ServiceEvent(
 	 */
 
 	Tcl_MutexUnlock(&(tsdPtr->queueMutex));
+	start = TclEventStatsStart();
 	result = proc(evPtr, flags);
 	Tcl_MutexLock(&(tsdPtr->queueMutex));
 
@@ -715,6 +853,21 @@ Tcl_ServiceEvent(
 	     * The event was processed, so remove it from the queue.
 	     */
 
+	    if ((start != 0) && (tsdPtr->statsPtr != NULL)) {
+		EventStats *statsPtr = tsdPtr->statsPtr;
+		Tcl_HashEntry *hPtr = Tcl_FindHashEntry(&statsPtr->queuedAt,
+			evPtr);
+
+		if (hPtr != NULL) {
+		    long long *queuedPtr = (long long *)Tcl_GetHashValue(hPtr);
+
+		    statsPtr->queueWait[EventStatsBucket(start - statsPtr->base
+			    - *queuedPtr)]++;
+		    Tcl_Free(queuedPtr);
+		    Tcl_DeleteHashEntry(hPtr);
+		}
+	    }
+
 	    if (tsdPtr->firstEventPtr == evPtr) {
 		tsdPtr->firstEventPtr = evPtr->nextPtr;
 		if (evPtr->nextPtr == NULL) {
@@ -745,6 +898,7 @@ Tcl_ServiceEvent(
 		Tcl_Free(evPtr);
 	    }
 	    Tcl_MutexUnlock(&(tsdPtr->queueMutex));
+	    TclEventStatsRecord(TCL_EVSTATS_EVENT, start);
 	    return 1;
 	} else {
 	    /*
@@ -753,6 +907,7 @@ Tcl_ServiceEvent(
 	     */
 
 	    evPtr->proc = proc;
+	    EventStatsDrop(tsdPtr, start);
 	}
     }
     Tcl_MutexUnlock(&(tsdPtr->queueMutex));
@@ -891,6 +1046,7 @@ Tcl_DoOneEvent(
     int result = 0, oldMode;
     EventSource *sourcePtr;
     Tcl_Time *timePtr;
+    long long start;
     ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
 
     /*
@@ -898,7 +1054,9 @@ Tcl_DoOneEvent(
      */
 
     if (Tcl_AsyncReady()) {
+	start = TclEventStatsStart();
 	(void) Tcl_AsyncInvoke(NULL, 0);
+	TclEventStatsRecord(TCL_EVSTATS_ASYNC, start);
 	return 1;
     }
 
@@ -983,7 +1141,12 @@ Tcl_DoOneEvent(
 	 * we should abort Tcl_DoOneEvent.
 	 */
 
+	start = TclEventStatsEnabled() ? TclpGetMicroseconds() : 0;
 	result = Tcl_WaitForEvent(timePtr);
+	if ((start != 0) && (tsdPtr->statsPtr != NULL)) {
+	    tsdPtr->statsPtr->waits++;
+	    tsdPtr->statsPtr->waitTime += TclpGetMicroseconds() - start;
+	}
 	if (result < 0) {
 	    result = 0;
 	    break;
@@ -1163,11 +1326,9 @@ Tcl_ThreadAlert(
      */
 
     Tcl_MutexLock(&listLock);
-    for (tsdPtr = firstNotifierPtr; tsdPtr; tsdPtr = tsdPtr->nextPtr) {
-	if (tsdPtr->threadId == threadId) {
-	    Tcl_AlertNotifier(tsdPtr->clientData);
-	    break;
-	}
+    tsdPtr = FindNotifier(threadId);
+    if (tsdPtr) {
+	Tcl_AlertNotifier(tsdPtr->clientData);
     }
     Tcl_MutexUnlock(&listLock);
 }
@@ -1425,6 +1586,444 @@ Tcl_DeleteFileHandler(
     }
 }
 #endif /* !_WIN32 */
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclEventStatsEnabled --
+ *
+ *	Tells whether [::tcl::unsupported::eventstats] collects statistics
+ *	for the current thread, for callers that have extra work to do for
+ *	them.
+ *
+ * Results:
+ *	1 if statistics are collected, 0 otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclEventStatsEnabled(void)
+{
+    ThreadSpecificData *tsdPtr;
+
+    if (eventStatsThreads == 0) {
+	return 0;
+    }
+    tsdPtr = TCL_TSD_INIT(&dataKey);
+    return (tsdPtr->statsPtr != NULL);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclEventStatsStart, TclEventStatsRecord --
+ *
+ *	Hooks bracketing the invocation of an event handler, for the
+ *	statistics of [::tcl::unsupported::eventstats]. TclEventStatsStart
+ *	returns the start time to pass to TclEventStatsRecord, which accounts
+ *	the handler under the given kind.
+ *
+ *	The longest running handler is only taken from handlers that ran no
+ *	other handlers themselves, so that a timer or idle callback is not
+ *	hidden behind the queued event that dispatched it.
+ *
+ * Results:
+ *	TclEventStatsStart returns 0 when no statistics are collected for the
+ *	current thread, in which case TclEventStatsRecord does nothing.
+ *
+ * Side effects:
+ *	Updates the statistics of the current thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+long long
+TclEventStatsStart(void)
+{
+    ThreadSpecificData *tsdPtr;
+    EventStats *statsPtr;
+
+    if (eventStatsThreads == 0) {
+	return 0;
+    }
+    tsdPtr = TCL_TSD_INIT(&dataKey);
+    statsPtr = tsdPtr->statsPtr;
+    if (statsPtr == NULL) {
+	return 0;
+    }
+    if (statsPtr->depth == statsPtr->framesSize) {
+	statsPtr->framesSize = statsPtr->framesSize ?
+		2 * statsPtr->framesSize : 8;
+	statsPtr->frames = (EventStatsFrame *)Tcl_Realloc(statsPtr->frames,
+		statsPtr->framesSize * sizeof(EventStatsFrame));
+    }
+    statsPtr->frames[statsPtr->depth].script = NULL;
+    statsPtr->frames[statsPtr->depth].nested = 0;
+    statsPtr->depth++;
+    return TclpGetMicroseconds();
+}
+
+void
+TclEventStatsRecord(
+    int kind,			/* One of the TCL_EVSTATS_* kinds. */
+    long long start)		/* Result of TclEventStatsStart. */
+{
+    ThreadSpecificData *tsdPtr;
+    EventStats *statsPtr;
+    Tcl_Obj *scriptPtr = NULL;
+    int nested = 0;
+    long long end;
+
+    if (start == 0) {
+	return;
+    }
+    tsdPtr = TCL_TSD_INIT(&dataKey);
+    statsPtr = tsdPtr->statsPtr;
+    if (statsPtr == NULL) {
+	return;
+    }
+    end = TclpGetMicroseconds();
+    statsPtr->handled[kind]++;
+    statsPtr->handlerTime[kind][EventStatsBucket(end - start)]++;
+
+    /*
+     * The frame may be missing if collection was switched on again while
+     * the handler ran.
+     */
+
+    if (statsPtr->depth > 0) {
+	statsPtr->depth--;
+	scriptPtr = statsPtr->frames[statsPtr->depth].script;
+	nested = statsPtr->frames[statsPtr->depth].nested;
+	if (statsPtr->depth > 0) {
+	    statsPtr->frames[statsPtr->depth - 1].nested = 1;
+	}
+    }
+    if (!nested && (end - start >= statsPtr->longestTime)) {
+	statsPtr->longestKind = kind;
+	statsPtr->longestTime = end - start;
+	if (statsPtr->longestScript != NULL) {
+	    Tcl_DecrRefCount(statsPtr->longestScript);
+	}
+	statsPtr->longestScript = scriptPtr;
+    } else if (scriptPtr != NULL) {
+	Tcl_DecrRefCount(scriptPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * EventStatsDrop --
+ *
+ *	Undoes TclEventStatsStart for a queued event whose handler declined
+ *	it, so that it is not accounted until it is actually handled.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Pops the handler from the statistics of the current thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+EventStatsDrop(
+    ThreadSpecificData *tsdPtr,
+    long long start)		/* Result of TclEventStatsStart. */
+{
+    EventStats *statsPtr = tsdPtr->statsPtr;
+    Tcl_Obj *scriptPtr;
+
+    if ((start == 0) || (statsPtr == NULL) || (statsPtr->depth == 0)) {
+	return;
+    }
+    statsPtr->depth--;
+    scriptPtr = statsPtr->frames[statsPtr->depth].script;
+    if (scriptPtr != NULL) {
+	Tcl_DecrRefCount(scriptPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclEventStatsScript, TclEventStatsIdle --
+ *
+ *	More hooks for [::tcl::unsupported::eventstats]. TclEventStatsScript
+ *	notes the script run by the current handler, to be reported should it
+ *	turn out to be the longest running one. TclEventStatsIdle notes the
+ *	number of idle handlers pending at the start of an idle pass.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Updates the statistics of the current thread, if any are collected.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclEventStatsScript(
+    Tcl_Obj *scriptPtr)		/* Script about to be run by a handler. */
+{
+    ThreadSpecificData *tsdPtr;
+    EventStats *statsPtr;
+    EventStatsFrame *framePtr;
+
+    if (eventStatsThreads == 0) {
+	return;
+    }
+    tsdPtr = TCL_TSD_INIT(&dataKey);
+    statsPtr = tsdPtr->statsPtr;
+    if ((statsPtr == NULL) || (statsPtr->depth == 0)) {
+	return;
+    }
+    framePtr = &statsPtr->frames[statsPtr->depth - 1];
+    Tcl_IncrRefCount(scriptPtr);
+    if (framePtr->script != NULL) {
+	Tcl_DecrRefCount(framePtr->script);
+    }
+    framePtr->script = scriptPtr;
+}
+
+void
+TclEventStatsIdle(
+    Tcl_Size backlog)		/* Number of pending idle handlers. */
+{
+    ThreadSpecificData *tsdPtr;
+    EventStats *statsPtr;
+
+    if (eventStatsThreads == 0) {
+	return;
+    }
+    tsdPtr = TCL_TSD_INIT(&dataKey);
+    statsPtr = tsdPtr->statsPtr;
+    if (statsPtr == NULL) {
+	return;
+    }
+    statsPtr->idleBacklog = backlog;
+    if (backlog > statsPtr->idleBacklogMax) {
+	statsPtr->idleBacklogMax = backlog;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * EventStatsBucket, EventStatsHistogram --
+ *
+ *	Helpers for the event loop statistics. EventStatsBucket returns the
+ *	histogram bucket for a duration, EventStatsHistogram converts a
+ *	histogram to a dictionary mapping the upper bound of each non-empty
+ *	bucket to its count.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+EventStatsBucket(
+    long long usec)
+{
+    int bucket = 0;
+
+    while ((bucket < EVENT_STATS_BUCKETS - 1)
+	    && (usec >= (1LL << bucket))) {
+	bucket++;
+    }
+    return bucket;
+}
+
+static Tcl_Obj *
+EventStatsHistogram(
+    const Tcl_WideInt *buckets)
+{
+    Tcl_Obj *histPtr;
+    int i;
+
+    TclNewObj(histPtr);
+    for (i = 0; i < EVENT_STATS_BUCKETS; i++) {
+	if (buckets[i] == 0) {
+	    continue;
+	}
+	Tcl_DictObjPut(NULL, histPtr, (i < EVENT_STATS_BUCKETS - 1)
+		? Tcl_NewWideIntObj(1LL << i) : Tcl_NewStringObj("inf", -1),
+		Tcl_NewWideIntObj(buckets[i]));
+    }
+    return histPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeEventStats --
+ *
+ *	Discards the event loop statistics of a thread. The caller must hold
+ *	the queueMutex of the thread.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Switches collection off for the thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeEventStats(
+    ThreadSpecificData *tsdPtr)
+{
+    EventStats *statsPtr = tsdPtr->statsPtr;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    if (statsPtr == NULL) {
+	return;
+    }
+    tsdPtr->statsPtr = NULL;
+    for (hPtr = Tcl_FirstHashEntry(&statsPtr->queuedAt, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	Tcl_Free(Tcl_GetHashValue(hPtr));
+    }
+    Tcl_DeleteHashTable(&statsPtr->queuedAt);
+    while (statsPtr->depth > 0) {
+	statsPtr->depth--;
+	if (statsPtr->frames[statsPtr->depth].script != NULL) {
+	    Tcl_DecrRefCount(statsPtr->frames[statsPtr->depth].script);
+	}
+    }
+    if (statsPtr->frames != NULL) {
+	Tcl_Free(statsPtr->frames);
+    }
+    if (statsPtr->longestScript != NULL) {
+	Tcl_DecrRefCount(statsPtr->longestScript);
+    }
+    Tcl_Free(statsPtr);
+
+    Tcl_MutexLock(&listLock);
+    eventStatsThreads--;
+    Tcl_MutexUnlock(&listLock);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclEventStatsObjCmd --
+ *
+ *	Implements [::tcl::unsupported::eventstats ?boolean?]. With an
+ *	argument, switches the collection of event loop statistics for the
+ *	current thread on or off. Switching it on (again) starts from zeroed
+ *	counters. Without an argument, returns the statistics collected so
+ *	far as a dictionary, which is empty when collection is off.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See above.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclEventStatsObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    EventStats *statsPtr;
+    Tcl_Obj *dictPtr, *subPtr;
+    Tcl_Event *evPtr;
+    Tcl_WideInt queued = 0;
+    int enable, i;
+
+    if (objc > 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?boolean?");
+	return TCL_ERROR;
+    }
+    if (objc == 2) {
+	if (Tcl_GetBooleanFromObj(interp, objv[1], &enable) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	Tcl_MutexLock(&(tsdPtr->queueMutex));
+	FreeEventStats(tsdPtr);
+	if (enable) {
+	    statsPtr = (EventStats *)Tcl_Alloc(sizeof(EventStats));
+	    memset(statsPtr, 0, sizeof(EventStats));
+	    Tcl_InitHashTable(&statsPtr->queuedAt, TCL_ONE_WORD_KEYS);
+	    statsPtr->base = TclpGetMicroseconds();
+	    tsdPtr->statsPtr = statsPtr;
+
+	    Tcl_MutexLock(&listLock);
+	    eventStatsThreads++;
+	    Tcl_MutexUnlock(&listLock);
+	}
+	Tcl_MutexUnlock(&(tsdPtr->queueMutex));
+	return TCL_OK;
+    }
+
+    TclNewObj(dictPtr);
+    statsPtr = tsdPtr->statsPtr;
+    if (statsPtr == NULL) {
+	Tcl_SetObjResult(interp, dictPtr);
+	return TCL_OK;
+    }
+
+#define STATS_PUT(name, valuePtr) \
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj(name, -1), (valuePtr))
+
+    TclNewObj(subPtr);
+    for (i = 0; i < TCL_EVSTATS_KINDS; i++) {
+	Tcl_DictObjPut(NULL, subPtr, Tcl_NewStringObj(eventStatsKinds[i], -1),
+		Tcl_NewWideIntObj(statsPtr->handled[i]));
+    }
+    STATS_PUT("handled", subPtr);
+    TclNewObj(subPtr);
+    for (i = 0; i < TCL_EVSTATS_KINDS; i++) {
+	Tcl_DictObjPut(NULL, subPtr, Tcl_NewStringObj(eventStatsKinds[i], -1),
+		EventStatsHistogram(statsPtr->handlerTime[i]));
+    }
+    STATS_PUT("handlerTime", subPtr);
+    STATS_PUT("queueWait", EventStatsHistogram(statsPtr->queueWait));
+
+    Tcl_MutexLock(&(tsdPtr->queueMutex));
+    for (evPtr = tsdPtr->firstEventPtr; evPtr != NULL;
+	    evPtr = evPtr->nextPtr) {
+	queued++;
+    }
+    Tcl_MutexUnlock(&(tsdPtr->queueMutex));
+    STATS_PUT("queued", Tcl_NewWideIntObj(queued));
+    STATS_PUT("idleBacklog", Tcl_NewWideIntObj(statsPtr->idleBacklog));
+    STATS_PUT("idleBacklogMax", Tcl_NewWideIntObj(statsPtr->idleBacklogMax));
+    STATS_PUT("notifierWaits", Tcl_NewWideIntObj(statsPtr->waits));
+    STATS_PUT("notifierWaitTime", Tcl_NewWideIntObj(statsPtr->waitTime));
+
+    TclNewObj(subPtr);
+    if (statsPtr->longestTime > 0) {
+	Tcl_DictObjPut(NULL, subPtr, Tcl_NewStringObj("kind", -1),
+		Tcl_NewStringObj(eventStatsKinds[statsPtr->longestKind], -1));
+	Tcl_DictObjPut(NULL, subPtr, Tcl_NewStringObj("time", -1),
+		Tcl_NewWideIntObj(statsPtr->longestTime));
+	if (statsPtr->longestScript != NULL) {
+	    Tcl_DictObjPut(NULL, subPtr, Tcl_NewStringObj("script", -1),
+		    statsPtr->longestScript);
+	}
+    }
+    STATS_PUT("longest", subPtr);
+#undef STATS_PUT
+
+    Tcl_SetObjResult(interp, dictPtr);
+    return TCL_OK;
+}
 
 /*
  * Local Variables:
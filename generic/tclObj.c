@@ -93,12 +93,35 @@ typedef struct {
                                  * that a Tcl_Obj was not allocated by some
                                  * other thread. */
 #endif /* TCL_MEM_DEBUG && TCL_THREADS */
+    Tcl_Obj **internTable;	/* Cache of shared small values, see
+				 * TclInternObj. NULL unless interning was
+				 * switched on for this thread. */
+    Tcl_WideInt internHits;	/* Lookups answered from internTable. */
+    Tcl_WideInt internMisses;	/* Lookups that (re)filled a slot. */
 } ThreadSpecificData;
 
 static Tcl_ThreadDataKey dataKey;
 
 static void             TclThreadFinalizeContLines(void *clientData);
 static ThreadSpecificData *TclGetContLineTable(void);
+static void		FreeInternTable(void *clientData);
+
+/*
+ * Values interned by TclInternObj are at most INTERN_MAX_LENGTH bytes long
+ * and live in a direct mapped table of INTERN_SIZE slots per thread. A value
+ * whose slot is taken by another one simply replaces it.
+ */
+
+#define INTERN_MAX_LENGTH	16
+#define INTERN_SIZE		1024
+
+/*
+ * Number of threads that have interning switched on. Lets callers of
+ * TclInternObj skip it cheaply in the common case.
+ */
+
+int tclInterning = 0;
+TCL_DECLARE_MUTEX(internMutex)
 
 /*
  * Nested Tcl_Obj deletion management support
@@ -4682,6 +4705,186 @@ Tcl_RepresentationCmd(
     return TCL_OK;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclInternObj --
+ *
+ *	Looks up a short string value in the interning cache of the current
+ *	thread. Parsers that make many small element values, such as those
+ *	of lists and dicts, use this to share one Tcl_Obj between all equal
+ *	values instead of making a new one each time.
+ *
+ * Results:
+ *	A shared Tcl_Obj with the given string representation, held by the
+ *	cache, or NULL if interning is off or the value is too long. Callers
+ *	must treat the value as shared: the cache holds a reference, so they
+ *	may only release references they took themselves. Nor may they store
+ *	it inside the internal representation of the value itself, which
+ *	happens when parsing a value that is its own single element.
+ *
+ * Side effects:
+ *	May replace the value cached in the slot the string maps to.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclInternObj(
+    const char *bytes,		/* String representation of the value. */
+    Tcl_Size length)		/* Number of bytes in it. */
+{
+    ThreadSpecificData *tsdPtr;
+    Tcl_Obj **slotPtr, *objPtr;
+    size_t hash = 0;
+    Tcl_Size i;
+
+    if (length > INTERN_MAX_LENGTH) {
+	return NULL;
+    }
+    tsdPtr = TCL_TSD_INIT(&dataKey);
+    if (tsdPtr->internTable == NULL) {
+	return NULL;
+    }
+
+    for (i = 0; i < length; i++) {
+	hash += (hash << 3) + UCHAR(bytes[i]);
+    }
+    slotPtr = &tsdPtr->internTable[hash & (INTERN_SIZE - 1)];
+    objPtr = *slotPtr;
+    if ((objPtr != NULL) && (objPtr->bytes != NULL)
+	    && (objPtr->length == length)
+	    && (memcmp(objPtr->bytes, bytes, length) == 0)) {
+	tsdPtr->internHits++;
+	return objPtr;
+    }
+
+    tsdPtr->internMisses++;
+    if (objPtr != NULL) {
+	TclDecrRefCount(objPtr);
+    }
+    TclNewStringObj(objPtr, bytes, length);
+    Tcl_IncrRefCount(objPtr);
+    *slotPtr = objPtr;
+    return objPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeInternTable --
+ *
+ *	Switches interning off for the current thread and releases the
+ *	values it cached. Also registered as thread exit handler while
+ *	interning is on.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Cached values no longer referenced elsewhere are freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeInternTable(
+    TCL_UNUSED(void *))
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    Tcl_Obj **table = tsdPtr->internTable;
+    int i;
+
+    if (table == NULL) {
+	return;
+    }
+    tsdPtr->internTable = NULL;
+    Tcl_DeleteThreadExitHandler(FreeInternTable, NULL);
+    Tcl_MutexLock(&internMutex);
+    tclInterning--;
+    Tcl_MutexUnlock(&internMutex);
+
+    for (i = 0; i < INTERN_SIZE; i++) {
+	if (table[i] != NULL) {
+	    TclDecrRefCount(table[i]);
+	}
+    }
+    Tcl_Free(table);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclInterningObjCmd --
+ *
+ *	Implements [::tcl::unsupported::interning ?boolean?]. With an
+ *	argument, switches interning of small list and dict element values
+ *	for the current thread on or off. Switching it on (again) starts
+ *	from an empty cache. Without an argument, returns the number of
+ *	cache hits and misses and of values cached as a dictionary, which is
+ *	empty when interning is off.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See above.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclInterningObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    Tcl_Obj *dictPtr;
+    Tcl_WideInt entries = 0;
+    int enable, i;
+
+    if (objc > 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?boolean?");
+	return TCL_ERROR;
+    }
+    if (objc == 2) {
+	if (Tcl_GetBooleanFromObj(interp, objv[1], &enable) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	FreeInternTable(NULL);
+	if (enable) {
+	    tsdPtr->internTable = (Tcl_Obj **)
+		    Tcl_Alloc(INTERN_SIZE * sizeof(Tcl_Obj *));
+	    memset(tsdPtr->internTable, 0, INTERN_SIZE * sizeof(Tcl_Obj *));
+	    tsdPtr->internHits = 0;
+	    tsdPtr->internMisses = 0;
+	    Tcl_CreateThreadExitHandler(FreeInternTable, NULL);
+	    Tcl_MutexLock(&internMutex);
+	    tclInterning++;
+	    Tcl_MutexUnlock(&internMutex);
+	}
+	return TCL_OK;
+    }
+
+    TclNewObj(dictPtr);
+    if (tsdPtr->internTable != NULL) {
+	for (i = 0; i < INTERN_SIZE; i++) {
+	    entries += (tsdPtr->internTable[i] != NULL);
+	}
+	Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("hits", -1),
+		Tcl_NewWideIntObj(tsdPtr->internHits));
+	Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("misses", -1),
+		Tcl_NewWideIntObj(tsdPtr->internMisses));
+	Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("entries", -1),
+		Tcl_NewWideIntObj(entries));
+    }
+    Tcl_SetObjResult(interp, dictPtr);
+    return TCL_OK;
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -13,6 +13,7 @@
 
 #include "tclInt.h"
 #include "tclRegexp.h"
+#include "tclStringRep.h"
 #include "tclTomMath.h"
 #include <assert.h>
 
@@ -59,42 +60,195 @@
  * ***    regexp implementations used by applications.		 ***
  */
 
+/*
+ * Values whose string rep is longer than this many bytes are matched against
+ * a transient Tcl_UniChar copy rather than being given a Unicode rep of their
+ * own, which would be four times their size and live as long as they do.
+ */
+
+#define TRANSIENT_SUBJECT_SIZE (1 << 20)
+
 /*
  * Thread local storage used to maintain a per-thread cache of compiled
- * regular expressions.
+ * regular expressions. Entries are found through a hash table keyed by the
+ * compile flags and the pattern, and kept on a list in order of use so that
+ * the least recently used one can be dropped when the cache is full. The
+ * size can be changed with [::tcl::unsupported::regexpcache].
+ */
+
+#define DEFAULT_CACHE_SIZE 256
+
+/*
+ * The number of bytes the lazy DFAs that run a match may each use to cache
+ * state sets, unless changed with [::tcl::unsupported::regexpcache]. A DFA
+ * only grows past its minimal cache when the subject is long enough to need
+ * it.
  */
 
-#define NUM_REGEXPS 30
+#define DEFAULT_DFA_SIZE (1 << 20)
+
+typedef struct RegexpCacheEntry {
+    struct TclRegexp *regexpPtr;/* Compiled form; the cache holds one
+				 * reference to it. */
+    Tcl_HashEntry *hPtr;	/* Entry in the cache's hash table. */
+    struct RegexpCacheEntry *prevPtr;
+				/* Next more recently used entry. */
+    struct RegexpCacheEntry *nextPtr;
+				/* Next less recently used entry. */
+} RegexpCacheEntry;
 
 typedef struct {
     int initialized;		/* Set to 1 when the module is initialized. */
-    char *patterns[NUM_REGEXPS];/* Strings corresponding to compiled regular
-				 * expression patterns. NULL means that this
-				 * slot isn't used. Malloc-ed. */
-    size_t patLengths[NUM_REGEXPS];/* Number of non-null characters in
-				 * corresponding entry in patterns. -1 means
-				 * entry isn't used. */
-    struct TclRegexp *regexps[NUM_REGEXPS];
-				/* Compiled forms of above strings. Also
-				 * malloc-ed, or NULL if not in use yet. */
+    Tcl_HashTable cache;	/* Maps keys made by MakeCacheKey to
+				 * RegexpCacheEntry structures. */
+    RegexpCacheEntry *firstPtr;	/* Most recently used entry. */
+    RegexpCacheEntry *lastPtr;	/* Least recently used entry. */
+    Tcl_Size numEntries;	/* Number of entries in the cache. */
+    Tcl_Size maxEntries;	/* Most entries kept; 0 means the default. */
+    Tcl_WideInt hits;		/* Lookups found in the cache. */
+    Tcl_WideInt misses;		/* Lookups not found in the cache. */
+    Tcl_WideInt sharedHits;	/* Misses whose automaton had already been
+				 * compiled by some thread. */
+    size_t dfaSize;		/* Budget for each DFA's state-set cache, in
+				 * bytes. */
+    Tcl_WideInt dfaMisses;	/* DFA transitions that had to be computed. */
+    Tcl_WideInt dfaFlushes;	/* DFA state sets evicted from full caches. */
 } ThreadSpecificData;
 
 static Tcl_ThreadDataKey dataKey;
 
+/*
+ * The compiled automaton of a regexp is never modified by matching, so all
+ * threads that compile the same pattern with the same flags share one. The
+ * table maps the same keys as the per-thread caches to SharedRegexp
+ * structures, and holds each for as long as some TclRegexp refers to it.
+ */
+
+typedef struct SharedRegexp {
+    regex_t re;			/* The compiled automaton. */
+    size_t refCount;		/* Number of TclRegexps using it. Guarded by
+				 * sharedMutex. */
+    Tcl_HashEntry *hPtr;	/* Entry in sharedTable, or NULL once the
+				 * table has been finalized. */
+} SharedRegexp;
+
+static Tcl_HashTable sharedTable;
+static int sharedInitialized = 0;
+TCL_DECLARE_MUTEX(sharedMutex)
+
+/*
+ * The patterns given to [regexp -multi] are compiled together into a
+ * RegexpSet, kept as the internal rep of the list that holds them. Patterns
+ * that are plain strings, and the literal prefixes that every match of the
+ * other patterns starts with, are the keywords of an Aho-Corasick automaton
+ * that finds all of them in one pass over the subject. Only patterns whose
+ * prefix occurs, and those that have none, are then run through the regexp
+ * engine.
+ */
+
+typedef struct RegexpSetNode {
+    Tcl_Size fail;		/* Node for the longest proper suffix of this
+				 * node's string that is also in the trie. */
+    Tcl_Size output;		/* Nearest node on the fail chain, this one
+				 * included, where a keyword ends; 0 if
+				 * none. */
+    Tcl_Size firstPattern;	/* First pattern whose keyword ends here, or
+				 * -1. Others are chained through their
+				 * nextPattern fields. */
+    Tcl_Size firstEdge;		/* Index in the edge array of the first edge
+				 * out of this node. */
+    Tcl_Size numEdges;		/* Number of edges out of this node. They are
+				 * sorted by character. */
+} RegexpSetNode;
+
+typedef struct RegexpSetEdge {
+    Tcl_UniChar ch;		/* Character labelling the edge. */
+    Tcl_Size node;		/* Node the edge leads to. */
+} RegexpSetEdge;
+
+typedef struct RegexpSetPattern {
+    TclRegexp *regexpPtr;	/* Compiled pattern, to which the set holds a
+				 * reference, or NULL for a plain string. */
+    int hasKeyword;		/* Whether the pattern has a keyword in the
+				 * automaton. A plain string without one is
+				 * empty, and matches anything. */
+    Tcl_Size nextPattern;	/* Next pattern with the same keyword, or
+				 * -1. */
+} RegexpSetPattern;
+
+typedef struct RegexpSet {
+    size_t refCount;		/* Number of values and matches using the
+				 * set. */
+    int flags;			/* Compile flags of the patterns. */
+    Tcl_Size numPatterns;	/* Number of patterns in the set. */
+    Tcl_Size numKeywords;	/* Number of patterns that have a keyword. */
+    RegexpSetPattern *patterns;	/* Array of numPatterns patterns. */
+    RegexpSetNode *nodes;	/* Nodes of the automaton; 0 is the root. */
+    RegexpSetEdge *edges;	/* Edges of all nodes, grouped by node. */
+    Tcl_Size rootAscii[128];	/* Child of the root for each ASCII
+				 * character, or 0. */
+} RegexpSet;
+
+/*
+ * A keyword of a set while it is being built.
+ */
+
+typedef struct RegexpSetKeyword {
+    Tcl_Size offset;		/* Index of its first character in the
+				 * buffer holding all the keywords. */
+    const Tcl_UniChar *chars;	/* Its characters, once the buffer is
+				 * complete. */
+    Tcl_Size length;		/* Number of characters. */
+    Tcl_Size pattern;		/* Index of the pattern it belongs to. */
+} RegexpSetKeyword;
+
+/*
+ * Case-insensitive sets only use keywords made of ASCII characters, which
+ * fold exactly as the regexp engine folds them.
+ */
+
+#define RegexpSetFold(setPtr, ch) \
+    ((((setPtr)->flags & TCL_REG_NOCASE) && (ch) >= 'A' && (ch) <= 'Z') \
+	    ? (Tcl_UniChar) ((ch) + ('a' - 'A')) : (ch))
+
 /*
  * Declarations for functions used only in this file.
  */
 
+static int		CompareKeywords(const void *first, const void *second);
 static TclRegexp *	CompileRegexp(Tcl_Interp *interp, const char *pattern,
 			    size_t length, int flags);
+static RegexpSet *	CompileRegexpSet(Tcl_Interp *interp, Tcl_Obj *objPtr,
+			    int flags);
 static void		DupRegexpInternalRep(Tcl_Obj *srcPtr,
 			    Tcl_Obj *copyPtr);
+static void		DupRegexpSetInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
 static void		FinalizeRegexp(void *clientData);
+static void		FinalizeSharedRegexps(void *clientData);
 static void		FreeRegexp(TclRegexp *regexpPtr);
+static SharedRegexp *	GetSharedRegexp(Tcl_Interp *interp, const char *key,
+			    const char *string, size_t length, int flags,
+			    int *foundPtr);
+static RegexpSet *	GetRegexpSetFromObj(Tcl_Interp *interp,
+			    Tcl_Obj *objPtr, int flags);
+static void		InitRegexpCache(ThreadSpecificData *tsdPtr);
+static int		IsLiteralPattern(const char *pattern, Tcl_Size length,
+			    int flags, const char **literalPtr,
+			    Tcl_Size *lengthPtr);
+static void		MakeCacheKey(Tcl_DString *keyPtr, const char *string,
+			    size_t length, int flags);
+static void		ReleaseSharedRegexp(SharedRegexp *sharedPtr);
+static void		ReleaseRegexpSet(RegexpSet *setPtr);
+static void		RemoveCacheEntry(ThreadSpecificData *tsdPtr,
+			    RegexpCacheEntry *entryPtr);
 static void		FreeRegexpInternalRep(Tcl_Obj *objPtr);
+static void		FreeRegexpSetInternalRep(Tcl_Obj *objPtr);
 static int		RegExpExecUniChar(Tcl_Interp *interp, Tcl_RegExp re,
 			    const Tcl_UniChar *uniString, size_t numChars,
 			    size_t nmatches, int flags);
+static inline Tcl_Size	RegexpSetChild(const RegexpSet *setPtr,
+			    Tcl_Size node, Tcl_UniChar ch);
 static int		SetRegexpFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
 
 /*
@@ -127,6 +281,20 @@ const Tcl_ObjType tclRegexpType = {
 	(rePtr) = irPtr ? (TclRegexp *)irPtr->twoPtrValue.ptr1 : NULL;		\
     } while (0)
 
+/*
+ * The type of the lists of patterns given to [regexp -multi], caching their
+ * compiled RegexpSet. The string rep is always kept.
+ */
+
+static const Tcl_ObjType regexpSetType = {
+    "regexpset",			/* name */
+    FreeRegexpSetInternalRep,		/* freeIntRepProc */
+    DupRegexpSetInternalRep,		/* dupIntRepProc */
+    NULL,				/* updateStringProc */
+    NULL,				/* setFromAnyProc */
+    TCL_OBJTYPE_V0
+};
+
 
 /*
  *----------------------------------------------------------------------
@@ -314,13 +482,22 @@ RegExpExecUniChar(
     int status;
     TclRegexp *regexpPtr = (TclRegexp *) re;
     size_t last = regexpPtr->re.re_nsub + 1;
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
 
     if (nm >= last) {
 	nm = last;
     }
+    if (!tsdPtr->initialized) {
+	InitRegexpCache(tsdPtr);
+    }
 
+    regexpPtr->details.rm_dfasize = tsdPtr->dfaSize;
+    regexpPtr->details.rm_dfamisses = 0;
+    regexpPtr->details.rm_dfaflushes = 0;
     status = TclReExec(&regexpPtr->re, wString, numChars,
 	    &regexpPtr->details, nm, regexpPtr->matches, flags);
+    tsdPtr->dfaMisses += regexpPtr->details.rm_dfamisses;
+    tsdPtr->dfaFlushes += regexpPtr->details.rm_dfaflushes;
 
     /*
      * Check for errors.
@@ -431,7 +608,7 @@ Tcl_RegExpMatch(
  *	return value is 1 if "string" matches "pattern" and 0 otherwise.
  *
  * Side effects:
- *	Converts the object to a Unicode object.
+ *	Converts the object to a Unicode object, unless it is large.
  *
  *----------------------------------------------------------------------
  */
@@ -451,9 +628,10 @@ Tcl_RegExpExecObj(
     int flags)			/* Regular expression execution flags. */
 {
     TclRegexp *regexpPtr = (TclRegexp *) re;
-    Tcl_UniChar *udata;
+    const Tcl_UniChar *udata;
     Tcl_Size length;
-    int reflags = regexpPtr->flags;
+    Tcl_DString ds;
+    int reflags = regexpPtr->flags, result;
 #define TCL_REG_GLOBOK_FLAGS \
 	(TCL_REG_ADVANCED | TCL_REG_NOSUB | TCL_REG_NOCASE)
 
@@ -476,6 +654,114 @@ Tcl_RegExpExecObj(
 	return TclStringMatchObj(textObj, regexpPtr->globObjPtr, nocase);
     }
 
+    udata = TclGetRegExpSubject(textObj, &ds, &length);
+    result = TclRegExpExecChars(interp, re, textObj, udata, length, offset,
+	    nmatches, flags);
+    Tcl_DStringFree(&ds);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGetRegExpSubject --
+ *
+ *	Get the characters of a value that regexps are to be matched against.
+ *	Values that have a Unicode rep, or are small enough for one to be
+ *	cheap, use that; large ones are converted into the caller's DString
+ *	instead, so that matching does not leave them four times bigger.
+ *	Callers matching the same value repeatedly should fetch the characters
+ *	once and pass them to TclRegExpExecChars each time.
+ *
+ * Results:
+ *	A pointer to the characters of textObj, valid until dsPtr is freed or
+ *	textObj is changed. The number of characters is stored in *lengthPtr.
+ *
+ * Side effects:
+ *	Initializes dsPtr, which the caller must free with Tcl_DStringFree.
+ *	May give textObj a Unicode rep.
+ *
+ *----------------------------------------------------------------------
+ */
+
+const Tcl_UniChar *
+TclGetRegExpSubject(
+    Tcl_Obj *textObj,		/* Value to be matched against. */
+    Tcl_DString *dsPtr,		/* Uninitialized DString to hold a copy of
+				 * the characters if one is needed. */
+    Tcl_Size *lengthPtr)	/* Where to store the number of chars. */
+{
+    const unsigned char *bytes;
+    Tcl_Size numBytes, i;
+    Tcl_UniChar *chars;
+
+    Tcl_DStringInit(dsPtr);
+    if (TclHasInternalRep(textObj, &tclStringType)
+	    && GET_STRING(textObj)->hasUnicode) {
+	return Tcl_GetUnicodeFromObj(textObj, lengthPtr);
+    }
+
+    if (TclIsPureByteArray(textObj)) {
+	/*
+	 * Every byte is a character; no need to generate the string rep.
+	 */
+
+	bytes = Tcl_GetBytesFromObj(NULL, textObj, &numBytes);
+	if (numBytes > TRANSIENT_SUBJECT_SIZE) {
+	    Tcl_DStringSetLength(dsPtr, (numBytes + 1) * sizeof(Tcl_UniChar));
+	    chars = (Tcl_UniChar *) Tcl_DStringValue(dsPtr);
+	    for (i = 0; i < numBytes; i++) {
+		chars[i] = bytes[i];
+	    }
+	    chars[numBytes] = 0;
+	    *lengthPtr = numBytes;
+	    return chars;
+	}
+    } else {
+	bytes = (const unsigned char *) TclGetStringFromObj(textObj,
+		&numBytes);
+	if (numBytes > TRANSIENT_SUBJECT_SIZE) {
+	    chars = Tcl_UtfToUniCharDString((const char *) bytes, numBytes,
+		    dsPtr);
+	    *lengthPtr = Tcl_DStringLength(dsPtr) / sizeof(Tcl_UniChar);
+	    return chars;
+	}
+    }
+    return Tcl_GetUnicodeFromObj(textObj, lengthPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclRegExpExecChars --
+ *
+ *	Execute a precompiled regexp against the characters of an object, as
+ *	obtained from TclGetRegExpSubject.
+ *
+ * Results:
+ *	As for Tcl_RegExpExecObj.
+ *
+ * Side effects:
+ *	Remembers textObj so that match ranges can be extracted from it later.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclRegExpExecChars(
+    Tcl_Interp *interp,		/* Interpreter to use for error reporting. */
+    Tcl_RegExp re,		/* Compiled regular expression. */
+    Tcl_Obj *textObj,		/* Text against which to match re. */
+    const Tcl_UniChar *chars,	/* The characters of textObj. */
+    Tcl_Size numChars,		/* Number of characters in chars. */
+    Tcl_Size offset,		/* Character index that marks where matching
+				 * should begin. */
+    Tcl_Size nmatches,		/* How many subexpression matches are of
+				 * interest. -1 means all of them. */
+    int flags)			/* Regular expression execution flags. */
+{
+    TclRegexp *regexpPtr = (TclRegexp *) re;
+
     /*
      * Save the target object so we can extract strings from it later.
      */
@@ -483,15 +769,11 @@ Tcl_RegExpExecObj(
     regexpPtr->string = NULL;
     regexpPtr->objPtr = textObj;
 
-    udata = Tcl_GetUnicodeFromObj(textObj, &length);
-
-    if (offset > length) {
-	offset = length;
+    if (offset > numChars) {
+	offset = numChars;
     }
-    udata += offset;
-    length -= offset;
-
-    return RegExpExecUniChar(interp, re, udata, length, nmatches, flags);
+    return RegExpExecUniChar(interp, re, chars + offset, numChars - offset,
+	    nmatches, flags);
 }
 
 /*
@@ -840,7 +1122,9 @@ SetRegexpFromAny(
  *
  *	Attempt to compile the given regexp pattern. If the compiled regular
  *	expression can be found in the per-thread cache, it will be used
- *	instead of compiling a new copy.
+ *	instead of compiling a new copy. Failing that, an automaton compiled
+ *	by another thread for the same pattern and flags is reused if there
+ *	is one.
  *
  * Results:
  *	The return value is a pointer to a newly allocated TclRegexp that
@@ -863,14 +1147,15 @@ CompileRegexp(
     int flags)			/* Compilation flags. */
 {
     TclRegexp *regexpPtr;
-    const Tcl_UniChar *uniString;
-    int numChars, status, i, exact;
-    Tcl_DString stringBuf;
+    SharedRegexp *sharedPtr;
+    RegexpCacheEntry *entryPtr;
+    Tcl_HashEntry *hPtr;
+    Tcl_DString key, stringBuf;
+    int exact, found, isNew;
     ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
 
     if (!tsdPtr->initialized) {
-	tsdPtr->initialized = 1;
-	Tcl_CreateThreadExitHandler(FinalizeRegexp, NULL);
+	InitRegexpCache(tsdPtr);
     }
 
     /*
@@ -885,72 +1170,56 @@ CompileRegexp(
      * if it has the same pattern and the same flags.
      */
 
-    for (i = 0; (i < NUM_REGEXPS) && (tsdPtr->patterns[i] != NULL); i++) {
-	if ((length == tsdPtr->patLengths[i])
-		&& (tsdPtr->regexps[i]->flags == flags)
-		&& (strcmp(string, tsdPtr->patterns[i]) == 0)) {
-	    /*
-	     * Move the matched pattern to the first slot in the cache and
-	     * shift the other patterns down one position.
-	     */
-
-	    if (i != 0) {
-		int j;
-		char *cachedString;
-
-		cachedString = tsdPtr->patterns[i];
-		regexpPtr = tsdPtr->regexps[i];
-		for (j = i-1; j >= 0; j--) {
-		    tsdPtr->patterns[j+1] = tsdPtr->patterns[j];
-		    tsdPtr->patLengths[j+1] = tsdPtr->patLengths[j];
-		    tsdPtr->regexps[j+1] = tsdPtr->regexps[j];
-		}
-		tsdPtr->patterns[0] = cachedString;
-		tsdPtr->patLengths[0] = length;
-		tsdPtr->regexps[0] = regexpPtr;
+    MakeCacheKey(&key, string, length, flags);
+    hPtr = Tcl_FindHashEntry(&tsdPtr->cache, Tcl_DStringValue(&key));
+    if (hPtr != NULL) {
+	Tcl_DStringFree(&key);
+	tsdPtr->hits++;
+
+	/*
+	 * Move the entry to the front of the list.
+	 */
+
+	entryPtr = (RegexpCacheEntry *) Tcl_GetHashValue(hPtr);
+	if (entryPtr != tsdPtr->firstPtr) {
+	    entryPtr->prevPtr->nextPtr = entryPtr->nextPtr;
+	    if (entryPtr->nextPtr != NULL) {
+		entryPtr->nextPtr->prevPtr = entryPtr->prevPtr;
+	    } else {
+		tsdPtr->lastPtr = entryPtr->prevPtr;
 	    }
-	    return tsdPtr->regexps[0];
+	    entryPtr->prevPtr = NULL;
+	    entryPtr->nextPtr = tsdPtr->firstPtr;
+	    tsdPtr->firstPtr->prevPtr = entryPtr;
+	    tsdPtr->firstPtr = entryPtr;
 	}
+	return entryPtr->regexpPtr;
     }
+    tsdPtr->misses++;
 
     /*
-     * This is a new expression, so compile it and add it to the cache.
+     * This is a new expression for this thread. Get its automaton, compiling
+     * it unless another thread already has.
      */
 
+    sharedPtr = GetSharedRegexp(interp, Tcl_DStringValue(&key), string,
+	    length, flags, &found);
+    if (sharedPtr == NULL) {
+	Tcl_DStringFree(&key);
+	return NULL;
+    }
+    if (found) {
+	tsdPtr->sharedHits++;
+    }
+
     regexpPtr = (TclRegexp*)Tcl_Alloc(sizeof(TclRegexp));
     regexpPtr->objPtr = NULL;
     regexpPtr->string = NULL;
     regexpPtr->details.rm_extend.rm_so = TCL_INDEX_NONE;
     regexpPtr->details.rm_extend.rm_eo = TCL_INDEX_NONE;
-
-    /*
-     * Get the up-to-date string representation and map to unicode.
-     */
-
-    Tcl_DStringInit(&stringBuf);
-    uniString = Tcl_UtfToUniCharDString(string, length, &stringBuf);
-    numChars = Tcl_DStringLength(&stringBuf) / sizeof(Tcl_UniChar);
-
-    /*
-     * Compile the string and check for errors.
-     */
-
     regexpPtr->flags = flags;
-    status = TclReComp(&regexpPtr->re, uniString, (size_t) numChars, flags);
-    Tcl_DStringFree(&stringBuf);
-
-    if (status != REG_OKAY) {
-	/*
-	 * Clean up and report errors in the interpreter, if possible.
-	 */
-
-	Tcl_Free(regexpPtr);
-	if (interp) {
-	    TclRegError(interp,
-		    "couldn't compile regular expression pattern: ", status);
-	}
-	return NULL;
-    }
+    regexpPtr->re = sharedPtr->re;
+    regexpPtr->sharedPtr = sharedPtr;
 
     /*
      * Convert RE to a glob pattern equivalent, if any, and cache it.  If this
@@ -958,6 +1227,7 @@ CompileRegexp(
      * Tcl_RegExpExecObj to optionally do a fast match (avoids RE engine).
      */
 
+    Tcl_DStringInit(&stringBuf);
     if (TclReToGlob(NULL, string, length, &stringBuf, &exact,
 	    NULL) == TCL_OK) {
 	regexpPtr->globObjPtr = Tcl_DStringToObj(&stringBuf);
@@ -981,102 +1251,1101 @@ CompileRegexp(
     regexpPtr->refCount = 1;
 
     /*
-     * Free the last regexp, if necessary, and make room at the head of the
-     * list for the new regexp.
+     * Free the least recently used regexps, if necessary, and put the new
+     * one at the head of the list.
      */
 
-    if (tsdPtr->patterns[NUM_REGEXPS-1] != NULL) {
-	TclRegexp *oldRegexpPtr = tsdPtr->regexps[NUM_REGEXPS-1];
-
-	if (oldRegexpPtr->refCount-- <= 1) {
-	    FreeRegexp(oldRegexpPtr);
-	}
-	Tcl_Free(tsdPtr->patterns[NUM_REGEXPS-1]);
+    while (tsdPtr->numEntries >= tsdPtr->maxEntries) {
+	RemoveCacheEntry(tsdPtr, tsdPtr->lastPtr);
     }
-    for (i = NUM_REGEXPS - 2; i >= 0; i--) {
-	tsdPtr->patterns[i+1] = tsdPtr->patterns[i];
-	tsdPtr->patLengths[i+1] = tsdPtr->patLengths[i];
-	tsdPtr->regexps[i+1] = tsdPtr->regexps[i];
+    entryPtr = (RegexpCacheEntry *) Tcl_Alloc(sizeof(RegexpCacheEntry));
+    entryPtr->regexpPtr = regexpPtr;
+    entryPtr->hPtr = Tcl_CreateHashEntry(&tsdPtr->cache,
+	    Tcl_DStringValue(&key), &isNew);
+    Tcl_SetHashValue(entryPtr->hPtr, entryPtr);
+    entryPtr->prevPtr = NULL;
+    entryPtr->nextPtr = tsdPtr->firstPtr;
+    if (tsdPtr->firstPtr != NULL) {
+	tsdPtr->firstPtr->prevPtr = entryPtr;
+    } else {
+	tsdPtr->lastPtr = entryPtr;
     }
-    tsdPtr->patterns[0] = (char *)Tcl_Alloc(length + 1);
-    memcpy(tsdPtr->patterns[0], string, length + 1);
-    tsdPtr->patLengths[0] = length;
-    tsdPtr->regexps[0] = regexpPtr;
+    tsdPtr->firstPtr = entryPtr;
+    tsdPtr->numEntries++;
+    Tcl_DStringFree(&key);
 
     return regexpPtr;
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
- * FreeRegexp --
+ * InitRegexpCache --
  *
- *	Release the storage associated with a TclRegexp.
+ *	Set up the per-thread regexp cache.
  *
  * Results:
  *	None.
  *
  * Side effects:
- *	None.
+ *	Initializes the cache's hash table and arranges for it to be freed
+ *	when the thread exits.
  *
  *----------------------------------------------------------------------
  */
 
 static void
-FreeRegexp(
-    TclRegexp *regexpPtr)	/* Compiled regular expression to free. */
+InitRegexpCache(
+    ThreadSpecificData *tsdPtr)
 {
-    TclReFree(&regexpPtr->re);
-    if (regexpPtr->globObjPtr) {
-	TclDecrRefCount(regexpPtr->globObjPtr);
-    }
-    if (regexpPtr->matches) {
-	Tcl_Free(regexpPtr->matches);
+    tsdPtr->initialized = 1;
+    Tcl_InitHashTable(&tsdPtr->cache, TCL_STRING_KEYS);
+    tsdPtr->firstPtr = tsdPtr->lastPtr = NULL;
+    tsdPtr->numEntries = 0;
+    if (tsdPtr->maxEntries == 0) {
+	tsdPtr->maxEntries = DEFAULT_CACHE_SIZE;
     }
-    Tcl_Free(regexpPtr);
+    tsdPtr->dfaSize = DEFAULT_DFA_SIZE;
+    Tcl_CreateThreadExitHandler(FinalizeRegexp, NULL);
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
- * FinalizeRegexp --
+ * MakeCacheKey --
  *
- *	Release the storage associated with the per-thread regexp cache.
+ *	Build the key under which a pattern compiled with the given flags is
+ *	cached: the flags in hex, a colon, then the pattern.
  *
  * Results:
  *	None.
  *
  * Side effects:
+ *	Initializes keyPtr, which the caller must free.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MakeCacheKey(
+    Tcl_DString *keyPtr,	/* Uninitialized DString to hold the key. */
+    const char *string,		/* The regexp (UTF-8). */
+    size_t length,		/* The length of the string in bytes. */
+    int flags)			/* Compilation flags. */
+{
+    char buf[TCL_INTEGER_SPACE + 1];
+
+    Tcl_DStringInit(keyPtr);
+    snprintf(buf, sizeof(buf), "%x:", (unsigned) flags);
+    Tcl_DStringAppend(keyPtr, buf, -1);
+    Tcl_DStringAppend(keyPtr, string, length);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RemoveCacheEntry --
+ *
+ *	Drop an entry from the per-thread regexp cache.
+ *
+ * Results:
  *	None.
  *
+ * Side effects:
+ *	Releases the cache's reference to the compiled regexp, which is freed
+ *	unless some object still refers to it.
+ *
  *----------------------------------------------------------------------
  */
 
 static void
-FinalizeRegexp(
-    TCL_UNUSED(void *))
+RemoveCacheEntry(
+    ThreadSpecificData *tsdPtr,
+    RegexpCacheEntry *entryPtr)
 {
-    int i;
-    TclRegexp *regexpPtr;
-    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    TclRegexp *regexpPtr = entryPtr->regexpPtr;
 
-    for (i = 0; (i < NUM_REGEXPS) && (tsdPtr->patterns[i] != NULL); i++) {
-	regexpPtr = tsdPtr->regexps[i];
-	if (regexpPtr->refCount-- <= 1) {
-	    FreeRegexp(regexpPtr);
-	}
-	Tcl_Free(tsdPtr->patterns[i]);
-	tsdPtr->patterns[i] = NULL;
+    if (entryPtr->prevPtr != NULL) {
+	entryPtr->prevPtr->nextPtr = entryPtr->nextPtr;
+    } else {
+	tsdPtr->firstPtr = entryPtr->nextPtr;
+    }
+    if (entryPtr->nextPtr != NULL) {
+	entryPtr->nextPtr->prevPtr = entryPtr->prevPtr;
+    } else {
+	tsdPtr->lastPtr = entryPtr->prevPtr;
+    }
+    Tcl_DeleteHashEntry(entryPtr->hPtr);
+    tsdPtr->numEntries--;
+    Tcl_Free(entryPtr);
+
+    if (regexpPtr->refCount-- <= 1) {
+	FreeRegexp(regexpPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetSharedRegexp --
+ *
+ *	Find the compiled automaton for a pattern in the table shared by all
+ *	threads, compiling it and adding it to the table if it is not there.
+ *	Compilation happens without holding the table's lock; should two
+ *	threads race to compile the same pattern, the loser's copy is freed.
+ *
+ * Results:
+ *	The shared automaton, with its reference count incremented, or NULL if
+ *	the pattern could not be compiled, in which case an error message is
+ *	left in the interp's result. *foundPtr is set to 1 if the automaton
+ *	was already in the table and to 0 otherwise.
+ *
+ * Side effects:
+ *	May add an entry to the shared table.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static SharedRegexp *
+GetSharedRegexp(
+    Tcl_Interp *interp,		/* Used for error reporting if not NULL. */
+    const char *key,		/* Key made by MakeCacheKey. */
+    const char *string,		/* The regexp to compile (UTF-8). */
+    size_t length,		/* The length of the string in bytes. */
+    int flags,			/* Compilation flags. */
+    int *foundPtr)		/* Where to store whether it was found. */
+{
+    SharedRegexp *sharedPtr = NULL;
+    Tcl_HashEntry *hPtr;
+    Tcl_DString stringBuf;
+    const Tcl_UniChar *uniString;
+    Tcl_Size numChars;
+    regex_t re;
+    int status, isNew;
+
+    Tcl_MutexLock(&sharedMutex);
+    if (!sharedInitialized) {
+	sharedInitialized = 1;
+	Tcl_InitHashTable(&sharedTable, TCL_STRING_KEYS);
+	TclCreateLateExitHandler(FinalizeSharedRegexps, NULL);
+    }
+    hPtr = Tcl_FindHashEntry(&sharedTable, key);
+    if (hPtr != NULL) {
+	sharedPtr = (SharedRegexp *) Tcl_GetHashValue(hPtr);
+	sharedPtr->refCount++;
+    }
+    Tcl_MutexUnlock(&sharedMutex);
+    *foundPtr = (sharedPtr != NULL);
+    if (sharedPtr != NULL) {
+	return sharedPtr;
     }
 
     /*
-     * We may find ourselves reinitialized if another finalization routine
-     * invokes regexps.
+     * Get the up-to-date string representation and map to unicode.
      */
 
-    tsdPtr->initialized = 0;
+    Tcl_DStringInit(&stringBuf);
+    uniString = Tcl_UtfToUniCharDString(string, length, &stringBuf);
+    numChars = Tcl_DStringLength(&stringBuf) / sizeof(Tcl_UniChar);
+
+    /*
+     * Compile the string and check for errors.
+     */
+
+    status = TclReComp(&re, uniString, (size_t) numChars, flags);
+    Tcl_DStringFree(&stringBuf);
+
+    if (status != REG_OKAY) {
+	/*
+	 * Report errors in the interpreter, if possible.
+	 */
+
+	if (interp) {
+	    TclRegError(interp,
+		    "couldn't compile regular expression pattern: ", status);
+	}
+	return NULL;
+    }
+
+    Tcl_MutexLock(&sharedMutex);
+    if (!sharedInitialized) {
+	sharedInitialized = 1;
+	Tcl_InitHashTable(&sharedTable, TCL_STRING_KEYS);
+	TclCreateLateExitHandler(FinalizeSharedRegexps, NULL);
+    }
+    hPtr = Tcl_CreateHashEntry(&sharedTable, key, &isNew);
+    if (isNew) {
+	sharedPtr = (SharedRegexp *) Tcl_Alloc(sizeof(SharedRegexp));
+	sharedPtr->re = re;
+	sharedPtr->refCount = 1;
+	sharedPtr->hPtr = hPtr;
+	Tcl_SetHashValue(hPtr, sharedPtr);
+    } else {
+	sharedPtr = (SharedRegexp *) Tcl_GetHashValue(hPtr);
+	sharedPtr->refCount++;
+    }
+    Tcl_MutexUnlock(&sharedMutex);
+    if (!isNew) {
+	TclReFree(&re);
+    }
+    return sharedPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleaseSharedRegexp --
+ *
+ *	Drop a reference to a shared compiled automaton.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The automaton is removed from the shared table and freed when its
+ *	last user lets go of it.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ReleaseSharedRegexp(
+    SharedRegexp *sharedPtr)
+{
+    int last;
+
+    Tcl_MutexLock(&sharedMutex);
+    last = (sharedPtr->refCount-- <= 1);
+    if (last && sharedPtr->hPtr != NULL) {
+	Tcl_DeleteHashEntry(sharedPtr->hPtr);
+    }
+    Tcl_MutexUnlock(&sharedMutex);
+    if (last) {
+	TclReFree(&sharedPtr->re);
+	Tcl_Free(sharedPtr);
+    }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeRegexp --
+ *
+ *	Release the storage associated with a TclRegexp.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeRegexp(
+    TclRegexp *regexpPtr)	/* Compiled regular expression to free. */
+{
+    ReleaseSharedRegexp(regexpPtr->sharedPtr);
+    if (regexpPtr->globObjPtr) {
+	TclDecrRefCount(regexpPtr->globObjPtr);
+    }
+    if (regexpPtr->matches) {
+	Tcl_Free(regexpPtr->matches);
+    }
+    Tcl_Free(regexpPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FinalizeRegexp --
+ *
+ *	Release the storage associated with the per-thread regexp cache.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FinalizeRegexp(
+    TCL_UNUSED(void *))
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+
+    while (tsdPtr->firstPtr != NULL) {
+	RemoveCacheEntry(tsdPtr, tsdPtr->firstPtr);
+    }
+    Tcl_DeleteHashTable(&tsdPtr->cache);
+
+    /*
+     * We may find ourselves reinitialized if another finalization routine
+     * invokes regexps.
+     */
+
+    tsdPtr->initialized = 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FinalizeSharedRegexps --
+ *
+ *	Release the table of automata shared between threads. This runs after
+ *	the thread exit handlers, so normally the table is empty by now; any
+ *	automaton still in use is detached from it and freed by its last user.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FinalizeSharedRegexps(
+    TCL_UNUSED(void *))
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    Tcl_MutexLock(&sharedMutex);
+    if (sharedInitialized) {
+	for (hPtr = Tcl_FirstHashEntry(&sharedTable, &search); hPtr != NULL;
+		hPtr = Tcl_NextHashEntry(&search)) {
+	    ((SharedRegexp *) Tcl_GetHashValue(hPtr))->hPtr = NULL;
+	}
+	Tcl_DeleteHashTable(&sharedTable);
+	sharedInitialized = 0;
+    }
+    Tcl_MutexUnlock(&sharedMutex);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclRegexpCacheObjCmd --
+ *
+ *	Implements [::tcl::unsupported::regexpcache ?size?] and
+ *	[::tcl::unsupported::regexpcache ?-size size? ?-dfasize bytes?]. The
+ *	size is the number of compiled regexps the current thread keeps cached
+ *	by pattern; if there are now too many, the least recently used ones
+ *	are dropped. The DFA size is the number of bytes each lazy DFA run by
+ *	the thread's matches may use to cache state sets, 0 meaning the
+ *	minimum. Without arguments, returns a dictionary describing the cache:
+ *	its size, the number of entries, hits and misses, how many misses were
+ *	satisfied by an automaton another thread had compiled, and how many
+ *	automata are shared between threads altogether; then the DFA size, the
+ *	number of DFA transitions computed and of state sets evicted.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See above.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclRegexpCacheObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+    Tcl_Obj *dictPtr, *valuePtr;
+    Tcl_WideInt size, shared = 0;
+    int i, index;
+    static const char *const options[] = {
+	"-dfasize",	"-size",	NULL
+    };
+    enum cacheOptions {
+	CACHE_DFASIZE,	CACHE_SIZE
+    };
+
+    if (objc != 2 && objc % 2 == 0) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?-size size? ?-dfasize bytes?");
+	return TCL_ERROR;
+    }
+    if (!tsdPtr->initialized) {
+	InitRegexpCache(tsdPtr);
+    }
+    for (i = 1; i < objc; i += 2) {
+	if (objc == 2) {
+	    index = CACHE_SIZE;
+	    valuePtr = objv[1];
+	} else if (Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0,
+		&index) != TCL_OK) {
+	    return TCL_ERROR;
+	} else {
+	    valuePtr = objv[i+1];
+	}
+	if (Tcl_GetWideIntFromObj(interp, valuePtr, &size) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (index == CACHE_DFASIZE) {
+	    if (size < 0 || (Tcl_WideUInt) size > SIZE_MAX) {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+			"bad DFA size \"%s\": must be a non-negative integer",
+			TclGetString(valuePtr)));
+		Tcl_SetErrorCode(interp, "TCL", "VALUE", "NUMBER",
+			(char *)NULL);
+		return TCL_ERROR;
+	    }
+	    tsdPtr->dfaSize = (size_t) size;
+	    continue;
+	}
+	if (size < 1 || size > TCL_SIZE_MAX) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "bad cache size \"%s\": must be a positive integer",
+		    TclGetString(valuePtr)));
+	    Tcl_SetErrorCode(interp, "TCL", "VALUE", "NUMBER", (char *)NULL);
+	    return TCL_ERROR;
+	}
+	tsdPtr->maxEntries = (Tcl_Size) size;
+	while (tsdPtr->numEntries > tsdPtr->maxEntries) {
+	    RemoveCacheEntry(tsdPtr, tsdPtr->lastPtr);
+	}
+    }
+    if (objc > 1) {
+	return TCL_OK;
+    }
+
+    Tcl_MutexLock(&sharedMutex);
+    if (sharedInitialized) {
+	shared = sharedTable.numEntries;
+    }
+    Tcl_MutexUnlock(&sharedMutex);
+
+    TclNewObj(dictPtr);
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("size", -1),
+	    Tcl_NewWideIntObj(tsdPtr->maxEntries));
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("entries", -1),
+	    Tcl_NewWideIntObj(tsdPtr->numEntries));
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("hits", -1),
+	    Tcl_NewWideIntObj(tsdPtr->hits));
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("misses", -1),
+	    Tcl_NewWideIntObj(tsdPtr->misses));
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("sharedhits", -1),
+	    Tcl_NewWideIntObj(tsdPtr->sharedHits));
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("shared", -1),
+	    Tcl_NewWideIntObj(shared));
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("dfasize", -1),
+	    Tcl_NewWideIntObj((Tcl_WideInt) tsdPtr->dfaSize));
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("dfamisses", -1),
+	    Tcl_NewWideIntObj(tsdPtr->dfaMisses));
+    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj("dfaflushes", -1),
+	    Tcl_NewWideIntObj(tsdPtr->dfaFlushes));
+    Tcl_SetObjResult(interp, dictPtr);
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclRegExpMatchSet --
+ *
+ *	Implements [regexp -multi]: matches each of a list of regular
+ *	expressions against a value, scanning the value only once for the
+ *	literal parts of all of them.
+ *
+ * Results:
+ *	A standard Tcl result. On success the interp's result is the list of
+ *	the indices, in increasing order, of the patterns that match.
+ *
+ * Side effects:
+ *	The compiled set is cached as the internal rep of patternsObj.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclRegExpMatchSet(
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Obj *patternsObj,	/* List of the regular expressions. */
+    Tcl_Obj *textObj,		/* Value to match them against. */
+    int flags)			/* Regular expression compilation flags. */
+{
+    RegexpSet *setPtr;
+    const RegexpSetPattern *patPtr;
+    const Tcl_UniChar *chars;
+    Tcl_Size numChars, numLeft, node, next, out, i, p;
+    Tcl_DString ds;
+    Tcl_Obj *resultObj;
+    char *found;
+    int match, code = TCL_OK;
+
+    setPtr = GetRegexpSetFromObj(interp, patternsObj, flags);
+    if (setPtr == NULL) {
+	return TCL_ERROR;
+    }
+
+    /*
+     * Getting the characters might shimmer the set away from patternsObj if
+     * it is also the subject, so hold on to it.
+     */
+
+    setPtr->refCount++;
+    chars = TclGetRegExpSubject(textObj, &ds, &numChars);
+    found = (char *) Tcl_Alloc(setPtr->numPatterns + 1);
+    memset(found, 0, setPtr->numPatterns + 1);
+
+    /*
+     * Run the automaton over the subject, noting each keyword seen, until
+     * the subject or the unseen keywords run out.
+     */
+
+    numLeft = setPtr->numKeywords;
+    node = 0;
+    for (i = 0; i < numChars && numLeft > 0; i++) {
+	Tcl_UniChar ch = RegexpSetFold(setPtr, chars[i]);
+
+	while (1) {
+	    next = (node == 0 && ch < 0x80) ? setPtr->rootAscii[ch]
+		    : RegexpSetChild(setPtr, node, ch);
+	    if (next != 0 || node == 0) {
+		node = next;
+		break;
+	    }
+	    node = setPtr->nodes[node].fail;
+	}
+	for (out = setPtr->nodes[node].output; out != 0;
+		out = setPtr->nodes[setPtr->nodes[out].fail].output) {
+	    for (p = setPtr->nodes[out].firstPattern; p >= 0;
+		    p = setPtr->patterns[p].nextPattern) {
+		if (!found[p]) {
+		    found[p] = 1;
+		    numLeft--;
+		}
+	    }
+	}
+    }
+
+    /*
+     * Decide each pattern, running the regexp engine only where the
+     * keywords leave the answer open.
+     */
+
+    TclNewObj(resultObj);
+    for (i = 0; i < setPtr->numPatterns; i++) {
+	patPtr = &setPtr->patterns[i];
+	if (patPtr->hasKeyword && !found[i]) {
+	    continue;
+	}
+	if (patPtr->regexpPtr == NULL) {
+	    match = 1;
+	} else {
+	    match = TclRegExpExecChars(interp, (Tcl_RegExp) patPtr->regexpPtr,
+		    textObj, chars, numChars, 0, 0, 0);
+	    if (match < 0) {
+		Tcl_DecrRefCount(resultObj);
+		code = TCL_ERROR;
+		break;
+	    }
+	}
+	if (match) {
+	    Tcl_ListObjAppendElement(NULL, resultObj, Tcl_NewWideIntObj(i));
+	}
+    }
+    if (code == TCL_OK) {
+	Tcl_SetObjResult(interp, resultObj);
+    }
+
+    Tcl_Free(found);
+    Tcl_DStringFree(&ds);
+    ReleaseRegexpSet(setPtr);
+    return code;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetRegexpSetFromObj --
+ *
+ *	Get the compiled form of a list of regular expressions, compiling it
+ *	with the given flags if the value does not already hold it.
+ *
+ * Results:
+ *	The compiled set, or NULL with an error message left in the interp's
+ *	result if the value is not a list or a pattern could not be compiled.
+ *
+ * Side effects:
+ *	Changes the internal rep of objPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static RegexpSet *
+GetRegexpSetFromObj(
+    Tcl_Interp *interp,		/* Used for error reporting. */
+    Tcl_Obj *objPtr,		/* List of regular expressions. */
+    int flags)			/* Regular expression compilation flags. */
+{
+    const Tcl_ObjInternalRep *irPtr;
+    Tcl_ObjInternalRep ir;
+    RegexpSet *setPtr;
+
+    irPtr = TclFetchInternalRep(objPtr, &regexpSetType);
+    if (irPtr != NULL) {
+	setPtr = (RegexpSet *) irPtr->twoPtrValue.ptr1;
+	if (setPtr->flags == flags) {
+	    return setPtr;
+	}
+    }
+
+    setPtr = CompileRegexpSet(interp, objPtr, flags);
+    if (setPtr == NULL) {
+	return NULL;
+    }
+
+    /*
+     * The list rep is about to go, so make sure the value can be told
+     * without it.
+     */
+
+    (void) TclGetString(objPtr);
+    setPtr->refCount++;
+    ir.twoPtrValue.ptr1 = setPtr;
+    ir.twoPtrValue.ptr2 = NULL;
+    Tcl_StoreInternalRep(objPtr, &regexpSetType, &ir);
+    return setPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * IsLiteralPattern --
+ *
+ *	Decide whether an advanced regular expression only ever matches one
+ *	fixed string, which the set's automaton can then find by itself.
+ *
+ * Results:
+ *	1 if it does, with the string stored in *literalPtr and its length in
+ *	bytes in *lengthPtr; 0 otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+IsLiteralPattern(
+    const char *pattern,	/* The regular expression (UTF-8). */
+    Tcl_Size length,		/* Its length in bytes. */
+    int flags,			/* Regular expression compilation flags. */
+    const char **literalPtr,	/* Where to store the string matched. */
+    Tcl_Size *lengthPtr)	/* Where to store its length. */
+{
+    Tcl_Size i;
+
+    if (length >= 4 && strncmp(pattern, "***=", 4) == 0) {
+	pattern += 4;
+	length -= 4;
+    } else if (flags & TCL_REG_EXPANDED) {
+	return 0;
+    } else {
+	for (i = 0; i < length; i++) {
+	    if (strchr("\\^$.[]|()*+?{}", pattern[i]) != NULL) {
+		return 0;
+	    }
+	}
+    }
+    if (flags & TCL_REG_NOCASE) {
+	for (i = 0; i < length; i++) {
+	    if (UCHAR(pattern[i]) >= 0x80) {
+		return 0;
+	    }
+	}
+    }
+    *literalPtr = pattern;
+    *lengthPtr = length;
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompareKeywords --
+ *
+ *	qsort comparison function ordering the keywords of a set.
+ *
+ * Results:
+ *	Negative, zero or positive as the first keyword sorts before, equal
+ *	to or after the second. A keyword sorts before those it is a prefix
+ *	of.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+CompareKeywords(
+    const void *first,
+    const void *second)
+{
+    const RegexpSetKeyword *kw1 = (const RegexpSetKeyword *) first;
+    const RegexpSetKeyword *kw2 = (const RegexpSetKeyword *) second;
+    Tcl_Size i;
+
+    for (i = 0; i < kw1->length && i < kw2->length; i++) {
+	if (kw1->chars[i] != kw2->chars[i]) {
+	    return (kw1->chars[i] < kw2->chars[i]) ? -1 : 1;
+	}
+    }
+    return (kw1->length < kw2->length) ? -1 : (kw1->length > kw2->length);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompileRegexpSet --
+ *
+ *	Compile a list of regular expressions into a RegexpSet: compile the
+ *	patterns that are not plain strings, and build the Aho-Corasick
+ *	automaton of the keywords.
+ *
+ *	Entering the keywords in sorted order means that any existing child a
+ *	keyword can follow is the one most recently added to its node, and
+ *	that every node gains its children in order of their characters.
+ *
+ * Results:
+ *	The new set, with a reference count of 0, or NULL with an error
+ *	message left in the interp's result.
+ *
+ * Side effects:
+ *	Compiles the patterns, caching them in the list elements.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static RegexpSet *
+CompileRegexpSet(
+    Tcl_Interp *interp,		/* Used for error reporting. */
+    Tcl_Obj *objPtr,		/* List of regular expressions. */
+    int flags)			/* Regular expression compilation flags. */
+{
+    RegexpSet *setPtr;
+    RegexpSetPattern *patPtr;
+    RegexpSetKeyword *keywords;
+    RegexpSetNode *nodePtr;
+    Tcl_Obj **objv;
+    Tcl_Size objc, i, j, length, numChars, numNodes, node, child;
+    Tcl_Size *parents, *lastChild, *fill, *queue, head, tail;
+    Tcl_UniChar *base, *letters;
+    const Tcl_UniChar *chars;
+    const char *pattern, *literal;
+    Tcl_DString buffer, ds;
+
+    if (TclListObjGetElements(interp, objPtr, &objc, &objv) != TCL_OK) {
+	return NULL;
+    }
+
+    setPtr = (RegexpSet *) Tcl_Alloc(sizeof(RegexpSet));
+    memset(setPtr, 0, sizeof(RegexpSet));
+    setPtr->flags = flags;
+    setPtr->patterns = (RegexpSetPattern *)
+	    Tcl_Alloc((objc + 1) * sizeof(RegexpSetPattern));
+    keywords = (RegexpSetKeyword *)
+	    Tcl_Alloc((objc + 1) * sizeof(RegexpSetKeyword));
+    Tcl_DStringInit(&buffer);
+
+    /*
+     * Compile the patterns, gathering their keywords in a buffer.
+     */
+
+    for (i = 0; i < objc; i++) {
+	patPtr = &setPtr->patterns[i];
+	patPtr->regexpPtr = NULL;
+	patPtr->hasKeyword = 0;
+	patPtr->nextPattern = -1;
+	setPtr->numPatterns++;
+
+	pattern = TclGetStringFromObj(objv[i], &length);
+	Tcl_DStringInit(&ds);
+	if (IsLiteralPattern(pattern, length, flags, &literal, &length)) {
+	    chars = Tcl_UtfToUniCharDString(literal, length, &ds);
+	    numChars = Tcl_DStringLength(&ds) / sizeof(Tcl_UniChar);
+	} else {
+	    patPtr->regexpPtr = (TclRegexp *)
+		    Tcl_GetRegExpFromObj(interp, objv[i], flags);
+	    if (patPtr->regexpPtr == NULL) {
+		Tcl_Free(keywords);
+		Tcl_DStringFree(&buffer);
+		ReleaseRegexpSet(setPtr);
+		return NULL;
+	    }
+	    patPtr->regexpPtr->refCount++;
+	    numChars = TclRePrefix(&patPtr->regexpPtr->re, &chars);
+	}
+	if (numChars > 0) {
+	    keywords[setPtr->numKeywords].offset =
+		    Tcl_DStringLength(&buffer) / sizeof(Tcl_UniChar);
+	    keywords[setPtr->numKeywords].length = numChars;
+	    keywords[setPtr->numKeywords].pattern = i;
+	    setPtr->numKeywords++;
+	    patPtr->hasKeyword = 1;
+	    Tcl_DStringAppend(&buffer, (const char *) chars,
+		    numChars * sizeof(Tcl_UniChar));
+	}
+	Tcl_DStringFree(&ds);
+    }
+
+    base = (Tcl_UniChar *) Tcl_DStringValue(&buffer);
+    numChars = Tcl_DStringLength(&buffer) / sizeof(Tcl_UniChar);
+    for (j = 0; j < numChars; j++) {
+	base[j] = RegexpSetFold(setPtr, base[j]);
+    }
+    for (i = 0; i < setPtr->numKeywords; i++) {
+	keywords[i].chars = base + keywords[i].offset;
+    }
+    qsort(keywords, setPtr->numKeywords, sizeof(RegexpSetKeyword),
+	    CompareKeywords);
+
+    /*
+     * Build the trie. Each node but the root is reached by a single edge,
+     * recorded by its parent and letter until the edges are laid out.
+     */
+
+    setPtr->nodes = (RegexpSetNode *)
+	    Tcl_Alloc((numChars + 1) * sizeof(RegexpSetNode));
+    parents = (Tcl_Size *) Tcl_Alloc((numChars + 1) * sizeof(Tcl_Size));
+    lastChild = (Tcl_Size *) Tcl_Alloc((numChars + 1) * sizeof(Tcl_Size));
+    letters = (Tcl_UniChar *) Tcl_Alloc((numChars + 1) * sizeof(Tcl_UniChar));
+    nodePtr = &setPtr->nodes[0];
+    nodePtr->fail = 0;
+    nodePtr->output = 0;
+    nodePtr->firstPattern = -1;
+    nodePtr->firstEdge = 0;
+    nodePtr->numEdges = 0;
+    lastChild[0] = 0;
+    numNodes = 1;
+
+    for (i = 0; i < setPtr->numKeywords; i++) {
+	node = 0;
+	for (j = 0; j < keywords[i].length; j++) {
+	    child = lastChild[node];
+	    if (child == 0 || letters[child] != keywords[i].chars[j]) {
+		child = numNodes++;
+		nodePtr = &setPtr->nodes[child];
+		nodePtr->fail = 0;
+		nodePtr->output = 0;
+		nodePtr->firstPattern = -1;
+		nodePtr->firstEdge = 0;
+		nodePtr->numEdges = 0;
+		parents[child] = node;
+		letters[child] = keywords[i].chars[j];
+		lastChild[child] = 0;
+		lastChild[node] = child;
+		setPtr->nodes[node].numEdges++;
+	    }
+	    node = child;
+	}
+	setPtr->patterns[keywords[i].pattern].nextPattern =
+		setPtr->nodes[node].firstPattern;
+	setPtr->nodes[node].firstPattern = keywords[i].pattern;
+    }
+    Tcl_Free(keywords);
+    Tcl_DStringFree(&buffer);
+
+    /*
+     * Lay out the edges, node by node. Nodes were created in the order of
+     * their letters among their siblings, so each node's edges end up
+     * sorted.
+     */
+
+    setPtr->edges = (RegexpSetEdge *)
+	    Tcl_Alloc(numNodes * sizeof(RegexpSetEdge));
+    fill = lastChild;
+    for (i = 0, j = 0; i < numNodes; i++) {
+	setPtr->nodes[i].firstEdge = j;
+	fill[i] = j;
+	j += setPtr->nodes[i].numEdges;
+    }
+    for (child = 1; child < numNodes; child++) {
+	j = fill[parents[child]]++;
+	setPtr->edges[j].ch = letters[child];
+	setPtr->edges[j].node = child;
+	if (parents[child] == 0 && letters[child] < 0x80) {
+	    setPtr->rootAscii[letters[child]] = child;
+	}
+    }
+    Tcl_Free(letters);
+
+    /*
+     * Work out the fail and output links breadth first, so that those of
+     * shorter strings are known when longer ones need them.
+     */
+
+    queue = parents;
+    head = tail = 0;
+    queue[tail++] = 0;
+    while (head < tail) {
+	node = queue[head++];
+	nodePtr = &setPtr->nodes[node];
+	for (j = 0; j < nodePtr->numEdges; j++) {
+	    RegexpSetEdge *edgePtr = &setPtr->edges[nodePtr->firstEdge + j];
+	    RegexpSetNode *childPtr = &setPtr->nodes[edgePtr->node];
+
+	    if (node != 0) {
+		Tcl_Size fail = nodePtr->fail;
+
+		while ((child = RegexpSetChild(setPtr, fail, edgePtr->ch)) == 0
+			&& fail != 0) {
+		    fail = setPtr->nodes[fail].fail;
+		}
+		childPtr->fail = child;
+	    }
+	    childPtr->output = (childPtr->firstPattern >= 0) ? edgePtr->node
+		    : setPtr->nodes[childPtr->fail].output;
+	    queue[tail++] = edgePtr->node;
+	}
+    }
+    Tcl_Free(queue);
+    Tcl_Free(fill);
+    return setPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RegexpSetChild --
+ *
+ *	Follow an edge of a set's trie.
+ *
+ * Results:
+ *	The child of the node along the edge labelled ch, or 0 if there is
+ *	none.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static inline Tcl_Size
+RegexpSetChild(
+    const RegexpSet *setPtr,	/* The set. */
+    Tcl_Size node,		/* Node to leave. */
+    Tcl_UniChar ch)		/* Character to follow. */
+{
+    const RegexpSetEdge *edges =
+	    setPtr->edges + setPtr->nodes[node].firstEdge;
+    Tcl_Size low = 0, high = setPtr->nodes[node].numEdges, mid;
+
+    while (low < high) {
+	mid = low + (high - low) / 2;
+	if (edges[mid].ch == ch) {
+	    return edges[mid].node;
+	} else if (edges[mid].ch < ch) {
+	    low = mid + 1;
+	} else {
+	    high = mid;
+	}
+    }
+    return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleaseRegexpSet --
+ *
+ *	Drop a reference to a compiled set of regular expressions, freeing it
+ *	once no references are left.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May free the set and the compiled patterns it holds.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ReleaseRegexpSet(
+    RegexpSet *setPtr)		/* The set to release. */
+{
+    TclRegexp *regexpPtr;
+    Tcl_Size i;
+
+    if (setPtr->refCount-- > 1) {
+	return;
+    }
+    for (i = 0; i < setPtr->numPatterns; i++) {
+	regexpPtr = setPtr->patterns[i].regexpPtr;
+	if (regexpPtr != NULL && regexpPtr->refCount-- <= 1) {
+	    FreeRegexp(regexpPtr);
+	}
+    }
+    Tcl_Free(setPtr->patterns);
+    if (setPtr->nodes != NULL) {
+	Tcl_Free(setPtr->nodes);
+    }
+    if (setPtr->edges != NULL) {
+	Tcl_Free(setPtr->edges);
+    }
+    Tcl_Free(setPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeRegexpSetInternalRep, DupRegexpSetInternalRep --
+ *
+ *	Manage the reference a value holds to its compiled set of regular
+ *	expressions.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May free the set.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeRegexpSetInternalRep(
+    Tcl_Obj *objPtr)		/* Value with internal rep to free. */
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(objPtr, &regexpSetType);
+
+    assert(irPtr != NULL);
+    ReleaseRegexpSet((RegexpSet *) irPtr->twoPtrValue.ptr1);
+}
+
+static void
+DupRegexpSetInternalRep(
+    Tcl_Obj *srcPtr,		/* Value with internal rep to copy. */
+    Tcl_Obj *copyPtr)		/* Value with internal rep to set. */
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(srcPtr, &regexpSetType);
+    RegexpSet *setPtr;
+    Tcl_ObjInternalRep ir;
+
+    assert(irPtr != NULL);
+    setPtr = (RegexpSet *) irPtr->twoPtrValue.ptr1;
+    setPtr->refCount++;
+    ir.twoPtrValue.ptr1 = setPtr;
+    ir.twoPtrValue.ptr2 = NULL;
+    Tcl_StoreInternalRep(copyPtr, &regexpSetType, &ir);
+}
+
 /*
  * Local Variables:
  * mode: c
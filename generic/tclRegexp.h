@@ -39,6 +39,9 @@ typedef struct TclRegexp {
 				 * used only for REG_EXPECT). */
     size_t refCount;		/* Count of number of references to this
 				 * compiled regexp. */
+    struct SharedRegexp *sharedPtr;
+				/* Holder of the compiled automaton in re,
+				 * which other threads may be using too. */
 } TclRegexp;
 
 #endif /* _TCLREGEXP */
@@ -43,15 +43,70 @@ typedef struct {
     Range *ranges;
 } CharSet;
 
+/*
+ * A format string parsed into the steps of the scan: skipping white space,
+ * matching a literal character, or a conversion. The format is only parsed
+ * once it has been validated, so the steps need no more checking. It is
+ * cached as the internal rep of the format string, along with the number of
+ * variables it was last validated for.
+ */
+
+typedef struct {
+    int type;			/* SCAN_SPACE, SCAN_LITERAL or
+				 * SCAN_CONVERSION. */
+    int ch;			/* The literal or conversion character. */
+    int flags;			/* Flag values as above. */
+    int objIndex;		/* The variable of a "%n$" conversion, or
+				 * -1. */
+    Tcl_Size width;		/* The field width, or 0. */
+    CharSet cset;		/* The set of a "[" conversion. */
+} ScanStep;
+
+#define SCAN_SPACE	0
+#define SCAN_LITERAL	1
+#define SCAN_CONVERSION	2
+
+typedef struct {
+    size_t refCount;		/* Number of values using it. */
+    int numVars;		/* The number of variables the format was
+				 * last validated for... */
+    int totalVars;		/* ...and the number of results that makes. */
+    int numSteps;		/* Number of entries in steps. */
+    ScanStep steps[TCLFLEXARRAY];
+} ScanFormat;
+
+/*
+ * Numbers of at most this many digits fit in a long, so %d conversions of
+ * them need not go through TclParseNumber.
+ */
+
+#define SCAN_SHORT_DIGITS	((sizeof(long) > 4) ? 18 : 9)
+
 /*
  * Declarations for functions used only in this file.
  */
 
 static const char *	BuildCharSet(CharSet *cset, const char *format);
 static int		CharInSet(CharSet *cset, int ch);
+static void		DupScanFormatInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
+static void		FreeScanFormatInternalRep(Tcl_Obj *objPtr);
+static ScanFormat *	GetScanFormatFromObj(Tcl_Interp *interp,
+			    Tcl_Obj *formatObj, int numVars, int *totalVars);
+static ScanFormat *	ParseScanFormat(const char *format);
 static void		ReleaseCharSet(CharSet *cset);
+static void		ReleaseScanFormat(ScanFormat *scanPtr);
 static int		ValidateFormat(Tcl_Interp *interp, const char *format,
 			    int numVars, int *totalVars);
+
+static const Tcl_ObjType scanFormatType = {
+    "scanformat",		/* name */
+    FreeScanFormatInternalRep,	/* freeIntRepPro */
+    DupScanFormatInternalRep,	/* dupIntRepProc */
+    NULL,			/* updateStringProc */
+    NULL,			/* setFromAnyProc */
+    TCL_OBJTYPE_V0
+};
 
 /*
  *----------------------------------------------------------------------
@@ -566,6 +621,239 @@ ValidateFormat(
     return TCL_ERROR;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ParseScanFormat --
+ *
+ *	Parse a format string that ValidateFormat has accepted into the steps
+ *	of the scan.
+ *
+ * Results:
+ *	The parsed format, with a reference count of 0.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ScanFormat *
+ParseScanFormat(
+    const char *format)		/* The format string. */
+{
+    ScanFormat *scanPtr;
+    ScanStep *stepPtr;
+    int numSteps = 8;
+    Tcl_UniChar ch = 0;
+
+    scanPtr = (ScanFormat *)Tcl_Alloc(offsetof(ScanFormat, steps)
+	    + numSteps * sizeof(ScanStep));
+    scanPtr->refCount = 0;
+    scanPtr->numVars = -1;
+    scanPtr->totalVars = 0;
+    scanPtr->numSteps = 0;
+
+    while (*format != '\0') {
+	if (scanPtr->numSteps == numSteps) {
+	    numSteps *= 2;
+	    scanPtr = (ScanFormat *)Tcl_Realloc(scanPtr,
+		    offsetof(ScanFormat, steps) + numSteps * sizeof(ScanStep));
+	}
+	stepPtr = scanPtr->steps + scanPtr->numSteps++;
+	memset(stepPtr, 0, sizeof(ScanStep));
+	stepPtr->objIndex = -1;
+
+	format += TclUtfToUniChar(format, &ch);
+	if (Tcl_UniCharIsSpace(ch)) {
+	    stepPtr->type = SCAN_SPACE;
+	    continue;
+	}
+	stepPtr->type = SCAN_LITERAL;
+	stepPtr->ch = ch;
+	if (ch != '%') {
+	    continue;
+	}
+	format += TclUtfToUniChar(format, &ch);
+	if (ch == '%') {
+	    continue;
+	}
+
+	/*
+	 * Check for assignment suppression ('*') or an XPG3-style assignment
+	 * ('%n$').
+	 */
+
+	stepPtr->type = SCAN_CONVERSION;
+	if (ch == '*') {
+	    stepPtr->flags |= SCAN_SUPPRESS;
+	    format += TclUtfToUniChar(format, &ch);
+	} else if ((ch < 0x80) && isdigit(UCHAR(ch))) {	/* INTL: "C" locale. */
+	    char *formatEnd;
+	    long value = strtoul(format-1, &formatEnd, 10);/* INTL: "C" locale. */
+
+	    if (*formatEnd == '$') {
+		format = formatEnd+1;
+		format += TclUtfToUniChar(format, &ch);
+		stepPtr->objIndex = (int) value - 1;
+	    }
+	}
+
+	/*
+	 * Parse any width specifier.
+	 */
+
+	if ((ch < 0x80) && isdigit(UCHAR(ch))) {	/* INTL: "C" locale. */
+	    unsigned long long ull;
+	    ull  = strtoull(format-1, (char **) &format, 10); /* INTL: "C" locale. */
+	    assert(ull <= TCL_SIZE_MAX); /* Else ValidateFormat should've error'ed */
+	    stepPtr->width = (Tcl_Size)ull;
+	    format += TclUtfToUniChar(format, &ch);
+	}
+
+	/*
+	 * Handle any size specifier.
+	 */
+
+	switch (ch) {
+	case 'l':
+	    if (*format == 'l') {
+		stepPtr->flags |= SCAN_BIG;
+		format += 1;
+		format += TclUtfToUniChar(format, &ch);
+		break;
+	    }
+	    /* FALLTHRU */
+	case 'L':
+	    stepPtr->flags |= SCAN_LONGER;
+	    /* FALLTHRU */
+	case 'h':
+	    format += TclUtfToUniChar(format, &ch);
+	}
+
+	stepPtr->ch = ch;
+	if (ch == '[') {
+	    format = BuildCharSet(&stepPtr->cset, format);
+	}
+    }
+    return scanPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetScanFormatFromObj --
+ *
+ *	Get the parsed form of a [scan] format string, validating it for the
+ *	given number of variables unless it already was.
+ *
+ * Results:
+ *	The parsed format, or NULL with an error message left in the interp's
+ *	result.
+ *
+ * Side effects:
+ *	Changes the internal rep of formatObj.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ScanFormat *
+GetScanFormatFromObj(
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Obj *formatObj,		/* The format string. */
+    int numVars,		/* The number of variables passed to the scan
+				 * command. */
+    int *totalVars)		/* The number of variables that will be
+				 * required. */
+{
+    const Tcl_ObjInternalRep *irPtr;
+    Tcl_ObjInternalRep ir;
+    ScanFormat *scanPtr;
+    const char *format = TclGetString(formatObj);
+
+    irPtr = TclFetchInternalRep(formatObj, &scanFormatType);
+    if (irPtr != NULL) {
+	scanPtr = (ScanFormat *)irPtr->twoPtrValue.ptr1;
+	if (scanPtr->numVars == numVars) {
+	    *totalVars = scanPtr->totalVars;
+	    return scanPtr;
+	}
+    }
+    if (ValidateFormat(interp, format, numVars, totalVars) == TCL_ERROR) {
+	return NULL;
+    }
+    if (irPtr == NULL) {
+	scanPtr = ParseScanFormat(format);
+	scanPtr->refCount++;
+	ir.twoPtrValue.ptr1 = scanPtr;
+	ir.twoPtrValue.ptr2 = NULL;
+	Tcl_StoreInternalRep(formatObj, &scanFormatType, &ir);
+    }
+    scanPtr->numVars = numVars;
+    scanPtr->totalVars = *totalVars;
+    return scanPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleaseScanFormat, FreeScanFormatInternalRep, DupScanFormatInternalRep --
+ *
+ *	Manage the references to a parsed [scan] format string.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The parsed format is freed when its last reference goes.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ReleaseScanFormat(
+    ScanFormat *scanPtr)
+{
+    int i;
+
+    if (scanPtr->refCount-- > 1) {
+	return;
+    }
+    for (i = 0; i < scanPtr->numSteps; i++) {
+	if ((scanPtr->steps[i].type == SCAN_CONVERSION)
+		&& (scanPtr->steps[i].ch == '[')) {
+	    ReleaseCharSet(&scanPtr->steps[i].cset);
+	}
+    }
+    Tcl_Free(scanPtr);
+}
+
+static void
+FreeScanFormatInternalRep(
+    Tcl_Obj *objPtr)
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(objPtr, &scanFormatType);
+
+    ReleaseScanFormat((ScanFormat *)irPtr->twoPtrValue.ptr1);
+}
+
+static void
+DupScanFormatInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(srcPtr, &scanFormatType);
+    ScanFormat *scanPtr = (ScanFormat *)irPtr->twoPtrValue.ptr1;
+    Tcl_ObjInternalRep ir;
+
+    scanPtr->refCount++;
+    ir.twoPtrValue.ptr1 = scanPtr;
+    ir.twoPtrValue.ptr2 = NULL;
+    Tcl_StoreInternalRep(copyPtr, &scanFormatType, &ir);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -590,7 +878,6 @@ Tcl_ScanObjCmd(
     int objc,			/* Number of arguments. */
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
-    const char *format;
     int numVars, nconversions, totalVars = -1;
     int objIndex, offset, i, result, code;
     long value;
@@ -602,6 +889,8 @@ Tcl_ScanObjCmd(
     Tcl_UniChar ch = 0, sch = 0;
     Tcl_Obj **objs = NULL, *objPtr = NULL;
     int flags;
+    ScanFormat *scanPtr;
+    ScanStep *stepPtr, *lastPtr;
 
     if (objc < 3) {
 	Tcl_WrongNumArgs(interp, 1, objv,
@@ -609,16 +898,19 @@ Tcl_ScanObjCmd(
 	return TCL_ERROR;
     }
 
-    format = TclGetString(objv[2]);
     numVars = objc-3;
 
     /*
-     * Check for errors in the format string.
+     * Check for errors in the format string. Nothing in the scan below can
+     * change the internal rep of the format, so its parsed form needs no
+     * reference of our own.
      */
 
-    if (ValidateFormat(interp, format, numVars, &totalVars) == TCL_ERROR) {
+    scanPtr = GetScanFormatFromObj(interp, objv[2], numVars, &totalVars);
+    if (scanPtr == NULL) {
 	return TCL_ERROR;
     }
+    lastPtr = scanPtr->steps + scanPtr->numSteps;
 
     /*
      * Allocate space for the result objects.
@@ -635,24 +927,25 @@ Tcl_ScanObjCmd(
     baseString = string;
 
     /*
-     * Iterate over the format string filling in the result objects until we
-     * reach the end of input, the end of the format string, or there is a
-     * mismatch.
+     * Iterate over the steps of the format filling in the result objects
+     * until we reach the end of input, the end of the format string, or there
+     * is a mismatch.
      */
 
     objIndex = 0;
     nconversions = 0;
-    while (*format != '\0') {
+    for (stepPtr = scanPtr->steps; stepPtr < lastPtr; stepPtr++) {
 	int parseFlag = TCL_PARSE_NO_WHITESPACE;
-	format += TclUtfToUniChar(format, &ch);
 
-	flags = 0;
+	ch = stepPtr->ch;
+	flags = stepPtr->flags;
+	width = stepPtr->width;
 
 	/*
 	 * If we see whitespace in the format, skip whitespace in the string.
 	 */
 
-	if (Tcl_UniCharIsSpace(ch)) {
+	if (stepPtr->type == SCAN_SPACE) {
 	    offset = TclUtfToUniChar(string, &sch);
 	    while (Tcl_UniCharIsSpace(sch)) {
 		if (*string == '\0') {
@@ -664,8 +957,7 @@ Tcl_ScanObjCmd(
 	    continue;
 	}
 
-	if (ch != '%') {
-	literal:
+	if (stepPtr->type == SCAN_LITERAL) {
 	    if (*string == '\0') {
 		underflow = 1;
 		goto done;
@@ -677,62 +969,8 @@ Tcl_ScanObjCmd(
 	    continue;
 	}
 
-	format += TclUtfToUniChar(format, &ch);
-	if (ch == '%') {
-	    goto literal;
-	}
-
-	/*
-	 * Check for assignment suppression ('*') or an XPG3-style assignment
-	 * ('%n$').
-	 */
-
-	if (ch == '*') {
-	    flags |= SCAN_SUPPRESS;
-	    format += TclUtfToUniChar(format, &ch);
-	} else if ((ch < 0x80) && isdigit(UCHAR(ch))) {	/* INTL: "C" locale. */
-	    char *formatEnd;
-	    /* Note currently XPG3 range limited to INT_MAX to match type of objc */
-	    value = strtoul(format-1, &formatEnd, 10);/* INTL: "C" locale. */
-	    if (*formatEnd == '$') {
-		format = formatEnd+1;
-		format += TclUtfToUniChar(format, &ch);
-		objIndex = (int) value - 1;
-	    }
-	}
-
-	/*
-	 * Parse any width specifier.
-	 */
-
-	if ((ch < 0x80) && isdigit(UCHAR(ch))) {	/* INTL: "C" locale. */
-	    unsigned long long ull;
-	    ull  = strtoull(format-1, (char **) &format, 10); /* INTL: "C" locale. */
-	    assert(ull <= TCL_SIZE_MAX); /* Else ValidateFormat should've error'ed */
-	    width = (Tcl_Size)ull;
-	    format += TclUtfToUniChar(format, &ch);
-	} else {
-	    width = 0;
-	}
-
-	/*
-	 * Handle any size specifier.
-	 */
-
-	switch (ch) {
-	case 'l':
-	    if (*format == 'l') {
-		flags |= SCAN_BIG;
-		format += 1;
-		format += TclUtfToUniChar(format, &ch);
-		break;
-	    }
-	    /* FALLTHRU */
-	case 'L':
-	    flags |= SCAN_LONGER;
-	    /* FALLTHRU */
-	case 'h':
-	    format += TclUtfToUniChar(format, &ch);
+	if (stepPtr->objIndex >= 0) {
+	    objIndex = stepPtr->objIndex;
 	}
 
 	/*
@@ -862,17 +1100,16 @@ Tcl_ScanObjCmd(
 	    break;
 
 	case '[': {
-	    CharSet cset;
+	    CharSet *csetPtr = &stepPtr->cset;
 
 	    if (width == 0) {
 		width = ~0;
 	    }
 	    end = string;
 
-	    format = BuildCharSet(&cset, format);
 	    while (*end != '\0') {
 		offset = TclUtfToUniChar(end, &sch);
-		if (!CharInSet(&cset, (int)sch)) {
+		if (!CharInSet(csetPtr, (int)sch)) {
 		    break;
 		}
 		end += offset;
@@ -880,7 +1117,6 @@ Tcl_ScanObjCmd(
 		    break;
 		}
 	    }
-	    ReleaseCharSet(&cset);
 
 	    if (string == end) {
 		/*
@@ -914,8 +1150,37 @@ Tcl_ScanObjCmd(
 
 	case 'i':
 	    /*
-	     * Scan an unsigned or signed integer.
+	     * Scan an unsigned or signed integer. A plain %d of a number
+	     * short enough to fit in a long is converted right here.
 	     */
+
+	    if ((ch == 'd') && (width == 0)
+		    && !(flags & (SCAN_LONGER|SCAN_BIG))) {
+		const char *p = string;
+		int numDigits = 0, negative = (*p == '-');
+
+		if ((*p == '-') || (*p == '+')) {
+		    p++;
+		}
+		while ((numDigits <= (int) SCAN_SHORT_DIGITS)
+			&& isdigit(UCHAR(p[numDigits]))) {	/* INTL: digit */
+		    numDigits++;
+		}
+		if ((numDigits > 0) && (numDigits <= (int) SCAN_SHORT_DIGITS)) {
+		    value = 0;
+		    for (string = p; string < p + numDigits; string++) {
+			value = 10 * value + (*string - '0');
+		    }
+		    if (flags & SCAN_SUPPRESS) {
+			break;
+		    }
+		    TclNewIntObj(objPtr, negative ? -value : value);
+		    Tcl_IncrRefCount(objPtr);
+		    CLANG_ASSERT(objs);
+		    objs[objIndex++] = objPtr;
+		    break;
+		}
+	    }
 	    TclNewIntObj(objPtr, 0);
 	    Tcl_IncrRefCount(objPtr);
 	    if (width == 0) {
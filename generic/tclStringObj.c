@@ -40,6 +40,10 @@
  * Prototypes for functions defined later in this file:
  */
 
+static int		AppendFormatField(Tcl_Obj *appendObj,
+			    const char *bytes, Tcl_Size numBytes,
+			    Tcl_WideInt width, int gotMinus, int gotZero,
+			    Tcl_Size *limitPtr);
 static void		AppendPrintfToObjVA(Tcl_Obj *objPtr,
 			    const char *format, va_list argList);
 static void		AppendUnicodeToUnicodeRep(Tcl_Obj *objPtr,
@@ -50,17 +54,35 @@ static void		AppendUtfToUnicodeRep(Tcl_Obj *objPtr,
 			    const char *bytes, Tcl_Size numBytes);
 static void		AppendUtfToUtfRep(Tcl_Obj *objPtr,
 			    const char *bytes, Tcl_Size numBytes);
+static struct StringMap *CompileStringMap(Tcl_Size mapElemc,
+			    Tcl_Obj *const mapElemv[], int nocase, int copy);
+static void		DupParsedFormatInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
 static void		DupStringInternalRep(Tcl_Obj *objPtr,
 			    Tcl_Obj *copyPtr);
+static void		DupStringMapInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
 static Tcl_Size		ExtendStringRepWithUnicode(Tcl_Obj *objPtr,
 			    const Tcl_UniChar *unicode, Tcl_Size numChars);
 static void		ExtendUnicodeRepWithString(Tcl_Obj *objPtr,
 			    const char *bytes, Tcl_Size numBytes,
 			    Tcl_Size numAppendChars);
 static void		FillUnicodeRep(Tcl_Obj *objPtr);
+static void		FreeParsedFormatInternalRep(Tcl_Obj *objPtr);
 static void		FreeStringInternalRep(Tcl_Obj *objPtr);
+static void		FreeStringMapInternalRep(Tcl_Obj *objPtr);
+static struct StringMap *GetStringMapFromObj(Tcl_Interp *interp,
+			    Tcl_Obj *mapObj, int nocase);
+static struct ParsedFormat *GetParsedFormatFromObj(Tcl_Obj *formatObj);
+static int		AppendParsedFormat(Tcl_Interp *interp,
+			    Tcl_Obj *appendObj, const char *format,
+			    const struct ParsedFormat *fmtPtr, Tcl_Size objc,
+			    Tcl_Obj *const objv[]);
 static void		GrowStringBuffer(Tcl_Obj *objPtr, Tcl_Size needed, int flag);
 static void		GrowUnicodeBuffer(Tcl_Obj *objPtr, Tcl_Size needed);
+static struct ParsedFormat *ParseFormat(const char *format);
+static void		ReleaseParsedFormat(struct ParsedFormat *fmtPtr);
+static void		ReleaseStringMap(struct StringMap *mapPtr);
 static int		SetStringFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
 static void		SetUnicodeObj(Tcl_Obj *objPtr,
 			    const Tcl_UniChar *unicode, Tcl_Size numChars);
@@ -83,6 +105,113 @@ const Tcl_ObjType tclStringType = {
     SetStringFromAny,		/* setFromAnyProc */
     TCL_OBJTYPE_V0
 };
+
+/*
+ * A [string map] mapping compiled for matching. The pairs whose keys start
+ * with the same character, folded to lower case for -nocase, are chained in
+ * mapping order, so that at each position of the string only the keys that
+ * might match there are tried. The keys and values are copied, both as
+ * Unicode and as UTF-8, into the same block as the structure. It is cached
+ * as the internal rep of the mapping, whose string rep is always kept.
+ */
+
+typedef struct StringMap {
+    size_t refCount;		/* Number of values and maps using it. */
+    int nocase;			/* Whether keys match case-insensitively. */
+    Tcl_Size numPairs;		/* Number of key/value pairs. */
+    Tcl_UniChar **keys;		/* The characters of each key... */
+    Tcl_Size *keyLens;		/* ...and how many there are. */
+    Tcl_UniChar **values;	/* The characters of each value... */
+    Tcl_Size *valueLens;	/* ...and how many there are. */
+    char **keyBytes;		/* The UTF-8 of each key... */
+    Tcl_Size *keyByteLens;	/* ...and its length in bytes. */
+    char **valueBytes;		/* The UTF-8 of each value... */
+    Tcl_Size *valueByteLens;	/* ...and its length in bytes. */
+    int asciiKeys;		/* Whether all keys are ASCII, so that a
+				 * case-sensitive mapping can be done on the
+				 * UTF-8 of the string. */
+    Tcl_UniChar *firstChars;	/* The (folded) first character of each
+				 * key. */
+    Tcl_Size *nextPair;		/* Next pair in the same chain, or -1. */
+    Tcl_Size otherPairs;	/* First pair whose key starts with a
+				 * non-ASCII character, or -1. */
+    Tcl_Size asciiPairs[128];	/* First pair whose key starts with each
+				 * ASCII character, or -1. */
+} StringMap;
+
+static const Tcl_ObjType stringMapType = {
+    "stringmap",		/* name */
+    FreeStringMapInternalRep,	/* freeIntRepPro */
+    DupStringMapInternalRep,	/* dupIntRepProc */
+    NULL,			/* updateStringProc */
+    NULL,			/* setFromAnyProc */
+    TCL_OBJTYPE_V0
+};
+
+/*
+ * A format string for Tcl_AppendFormatToObj, parsed into its conversion
+ * specifiers. Each specifier records the literal text in front of it; the
+ * text after the last one is an entry of its own. It is cached as the
+ * internal rep of a [format] format string.
+ */
+
+typedef struct FormatSpec {
+    Tcl_Size textStart;		/* Offset of the literal text before the
+				 * specifier in the format string... */
+    Tcl_Size textLength;	/* ...and its length in bytes. */
+    int flags;			/* FORMAT_* flags, defined below. */
+    int ch;			/* The conversion character. */
+    int position;		/* The argument number of a "%n$" specifier. */
+    int errorAt;		/* Where the specifier is found to be in
+				 * error, if it is: FORMAT_ERROR_*. */
+    Tcl_WideInt width;		/* Minimum field width... */
+    Tcl_WideInt precision;	/* ...and precision, unless they are taken
+				 * from the arguments. */
+} FormatSpec;
+
+#define FORMAT_TEXT		0x1	/* Just literal text. */
+#define FORMAT_XPG		0x2	/* A "%n$" specifier. */
+#define FORMAT_MINUS		0x4	/* The flags... */
+#define FORMAT_HASH		0x8
+#define FORMAT_ZERO		0x10
+#define FORMAT_SPACE		0x20
+#define FORMAT_PLUS		0x40
+#define FORMAT_WIDTH_ARG	0x80	/* Width "*". */
+#define FORMAT_PRECISION	0x100	/* Precision given with ".". */
+#define FORMAT_PRECISION_ARG	0x200	/* Precision "*". */
+#define FORMAT_SHORT		0x400	/* Length modifiers. */
+#define FORMAT_WIDE		0x800
+#define FORMAT_BIG		0x1000
+
+#define FORMAT_ERROR_MIXED	1	/* Mixes "%" and "%n$". */
+#define FORMAT_ERROR_WIDTH	2	/* Width too big. */
+#define FORMAT_ERROR_PRECISION	3	/* Precision too big. */
+
+/*
+ * Limits under which fields are formatted in local buffers.
+ */
+
+#define FORMAT_SMALL_FIELD	64
+#define FORMAT_FLOAT_BUFFER	400
+
+typedef struct ParsedFormat {
+    size_t refCount;		/* Number of values and callers using it. */
+    Tcl_Size numSpecs;		/* Number of entries in specs. */
+    FormatSpec specs[TCLFLEXARRAY];
+} ParsedFormat;
+
+static const Tcl_ObjType parsedFormatType = {
+    "formatstring",		/* name */
+    FreeParsedFormatInternalRep,	/* freeIntRepPro */
+    DupParsedFormatInternalRep,	/* dupIntRepProc */
+    NULL,			/* updateStringProc */
+    NULL,			/* setFromAnyProc */
+    TCL_OBJTYPE_V0
+};
+
+#define ASCII_TO_LOWER(ch) \
+    ((((ch) >= 'A') && ((ch) <= 'Z')) ? (Tcl_UniChar) ((ch) + ('a' - 'A')) \
+	    : (ch))
 
 /*
  * TCL STRING GROWTH ALGORITHM
@@ -1824,16 +1953,17 @@ Tcl_AppendStringsToObj(
 /*
  *----------------------------------------------------------------------
  *
- * Tcl_AppendFormatToObj --
+ * ParseFormat --
  *
- *	This function appends a list of Tcl_Obj's to a Tcl_Obj according to
- *	the formatting instructions embedded in the format string. The
- *	formatting instructions are inspired by sprintf(). Returns TCL_OK when
- *	successful. If there's an error in the arguments, TCL_ERROR is
- *	returned, and an error message is written to the interp, if non-NULL.
+ *	Parse a format string for Tcl_AppendFormatToObj into the list of its
+ *	conversion specifiers, each with the literal text in front of it.
+ *	Parsing stops at the first specifier that is in error; the error is
+ *	only reported when that specifier is reached during formatting, so
+ *	that it comes in the same order relative to the errors found in the
+ *	arguments as it always has.
  *
  * Results:
- *	A standard Tcl result.
+ *	The parsed format, with a reference count of 0.
  *
  * Side effects:
  *	None.
@@ -1841,75 +1971,54 @@ Tcl_AppendStringsToObj(
  *----------------------------------------------------------------------
  */
 
-int
-Tcl_AppendFormatToObj(
-    Tcl_Interp *interp,
-    Tcl_Obj *appendObj,
-    const char *format,
-    Tcl_Size objc,
-    Tcl_Obj *const objv[])
+static ParsedFormat *
+ParseFormat(
+    const char *format)		/* The NUL-terminated format string. */
 {
-    const char *span = format, *msg, *errCode;
+    const char *start = format, *span = format, *percent;
+    ParsedFormat *fmtPtr;
+    FormatSpec *specPtr;
+    Tcl_Size numSpecs = 1;
     int gotXpg = 0, gotSequential = 0;
-    Tcl_Size objIndex = 0, originalLength, limit, numBytes = 0;
     Tcl_UniChar ch = 0;
-    static const char *mixedXPG =
-	    "cannot mix \"%\" and \"%n$\" conversion specifiers";
-    static const char *const badIndex[2] = {
-	"not enough arguments for all format specifiers",
-	"\"%n$\" argument index out of range"
-    };
-    static const char *overflow = "max size for a Tcl value exceeded";
-
-    if (Tcl_IsShared(appendObj)) {
-	Tcl_Panic("%s called with shared object", "Tcl_AppendFormatToObj");
-    }
-    (void)TclGetStringFromObj(appendObj, &originalLength);
-    limit = TCL_SIZE_MAX - originalLength;
 
     /*
-     * Format string is NUL-terminated.
+     * Each specifier starts with its own "%", so this is enough entries.
      */
 
-    while (*format != '\0') {
-	char *end;
-	int gotMinus = 0, gotHash = 0, gotZero = 0, gotSpace = 0, gotPlus = 0;
-	int gotPrecision, sawFlag, useShort = 0, useBig = 0;
-	Tcl_WideInt width, precision;
-#ifndef TCL_WIDE_INT_IS_LONG
-	int useWide = 0;
-#endif
-	int newXpg, allocSegment = 0;
-	Tcl_Size numChars, segmentLimit, segmentNumBytes;
-	Tcl_Obj *segment;
-	int step = TclUtfToUniChar(format, &ch);
+    for (percent = strchr(format, '%'); percent != NULL;
+	    percent = strchr(percent + 1, '%')) {
+	numSpecs++;
+    }
+    fmtPtr = (ParsedFormat *) Tcl_Alloc(offsetof(ParsedFormat, specs)
+	    + numSpecs * sizeof(FormatSpec));
+    fmtPtr->refCount = 0;
+    fmtPtr->numSpecs = 0;
 
-	format += step;
-	if (ch != '%') {
-	    numBytes += step;
-	    continue;
-	}
-	if (numBytes) {
-	    if (numBytes > limit) {
-		msg = overflow;
-		errCode = "OVERFLOW";
-		goto errorMsg;
-	    }
-	    Tcl_AppendToObj(appendObj, span, numBytes);
-	    limit -= numBytes;
-	    numBytes = 0;
+    while (1) {
+	char *end;
+	int step, sawFlag;
+
+	specPtr = fmtPtr->specs + fmtPtr->numSpecs++;
+	memset(specPtr, 0, sizeof(FormatSpec));
+	specPtr->textStart = span - start;
+	percent = strchr(format, '%');
+	if (percent == NULL) {
+	    specPtr->textLength = format + strlen(format) - span;
+	    specPtr->flags = FORMAT_TEXT;
+	    break;
 	}
+	specPtr->textLength = percent - span;
+	format = percent + 1;
 
 	/*
-	 * Saw a % : process the format specifier.
-	 *
 	 * Step 0. Handle special case of escaped format marker (i.e., %%).
 	 */
 
 	step = TclUtfToUniChar(format, &ch);
 	if (ch == '%') {
+	    specPtr->flags = FORMAT_TEXT;
 	    span = format;
-	    numBytes = step;
 	    format += step;
 	    continue;
 	}
@@ -1918,37 +2027,29 @@ Tcl_AppendFormatToObj(
 	 * Step 1. XPG3 position specifier
 	 */
 
-	newXpg = 0;
 	if (isdigit(UCHAR(ch))) {
 	    int position = strtoul(format, &end, 10);
 
 	    if (*end == '$') {
-		newXpg = 1;
-		objIndex = position - 1;
+		specPtr->flags |= FORMAT_XPG;
+		specPtr->position = position;
 		format = end + 1;
 		step = TclUtfToUniChar(format, &ch);
 	    }
 	}
-	if (newXpg) {
+	if (specPtr->flags & FORMAT_XPG) {
 	    if (gotSequential) {
-		msg = mixedXPG;
-		errCode = "MIXEDSPECTYPES";
-		goto errorMsg;
+		specPtr->errorAt = FORMAT_ERROR_MIXED;
+		break;
 	    }
 	    gotXpg = 1;
 	} else {
 	    if (gotXpg) {
-		msg = mixedXPG;
-		errCode = "MIXEDSPECTYPES";
-		goto errorMsg;
+		specPtr->errorAt = FORMAT_ERROR_MIXED;
+		break;
 	    }
 	    gotSequential = 1;
 	}
-	if ((objIndex < 0) || (objIndex >= objc)) {
-	    msg = badIndex[gotXpg];
-	    errCode = gotXpg ? "INDEXRANGE" : "FIELDVARMISMATCH";
-	    goto errorMsg;
-	}
 
 	/*
 	 * Step 2. Set of flags.
@@ -1958,19 +2059,19 @@ Tcl_AppendFormatToObj(
 	do {
 	    switch (ch) {
 	    case '-':
-		gotMinus = 1;
+		specPtr->flags |= FORMAT_MINUS;
 		break;
 	    case '#':
-		gotHash = 1;
+		specPtr->flags |= FORMAT_HASH;
 		break;
 	    case '0':
-		gotZero = 1;
+		specPtr->flags |= FORMAT_ZERO;
 		break;
 	    case ' ':
-		gotSpace = 1;
+		specPtr->flags |= FORMAT_SPACE;
 		break;
 	    case '+':
-		gotPlus = 1;
+		specPtr->flags |= FORMAT_PLUS;
 		break;
 	    default:
 		sawFlag = 0;
@@ -1985,50 +2086,30 @@ Tcl_AppendFormatToObj(
 	 * Step 3. Minimum field width.
 	 */
 
-	width = 0;
 	if (isdigit(UCHAR(ch))) {
 	    /* Note ull will be >= 0 because of isdigit check above */
 	    unsigned long long ull;
 	    ull = strtoull(format, &end, 10);
 	    /* Comparison is >=, not >, to leave room for nul */
 	    if (ull >= WIDE_MAX) {
-		msg = overflow;
-		errCode = "OVERFLOW";
-		goto errorMsg;
+		specPtr->errorAt = FORMAT_ERROR_WIDTH;
+		break;
 	    }
-	    width = (Tcl_WideInt)ull;
+	    specPtr->width = (Tcl_WideInt)ull;
 	    format = end;
 	    step = TclUtfToUniChar(format, &ch);
 	} else if (ch == '*') {
-	    if (objIndex >= objc - 1) {
-		msg = badIndex[gotXpg];
-		errCode = gotXpg ? "INDEXRANGE" : "FIELDVARMISMATCH";
-		goto errorMsg;
-	    }
-	    if (TclGetWideIntFromObj(interp, objv[objIndex], &width) != TCL_OK) {
-		goto error;
-	    }
-	    if (width < 0) {
-		width = -width;
-		gotMinus = 1;
-	    }
-	    objIndex++;
+	    specPtr->flags |= FORMAT_WIDTH_ARG;
 	    format += step;
 	    step = TclUtfToUniChar(format, &ch);
 	}
-	if (width > limit) {
-	    msg = overflow;
-	    errCode = "OVERFLOW";
-	    goto errorMsg;
-	}
 
 	/*
 	 * Step 4. Precision.
 	 */
 
-	gotPrecision = precision = 0;
 	if (ch == '.') {
-	    gotPrecision = 1;
+	    specPtr->flags |= FORMAT_PRECISION;
 	    format += step;
 	    step = TclUtfToUniChar(format, &ch);
 	}
@@ -2038,32 +2119,14 @@ Tcl_AppendFormatToObj(
 	    ull = strtoull(format, &end, 10);
 	    /* Comparison is >=, not >, to leave room for nul */
 	    if (ull >= WIDE_MAX) {
-		msg = overflow;
-		errCode = "OVERFLOW";
-		goto errorMsg;
+		specPtr->errorAt = FORMAT_ERROR_PRECISION;
+		break;
 	    }
-	    precision = (Tcl_WideInt)ull;
+	    specPtr->precision = (Tcl_WideInt)ull;
 	    format = end;
 	    step = TclUtfToUniChar(format, &ch);
 	} else if (ch == '*') {
-	    if (objIndex >= objc - 1) {
-		msg = badIndex[gotXpg];
-		errCode = gotXpg ? "INDEXRANGE" : "FIELDVARMISMATCH";
-		goto errorMsg;
-	    }
-	    if (TclGetWideIntFromObj(interp, objv[objIndex], &precision)
-		    != TCL_OK) {
-		goto error;
-	    }
-
-	    /*
-	     * TODO: Check this truncation logic.
-	     */
-
-	    if (precision < 0) {
-		precision = 0;
-	    }
-	    objIndex++;
+	    specPtr->flags |= FORMAT_PRECISION_ARG;
 	    format += step;
 	    step = TclUtfToUniChar(format, &ch);
 	}
@@ -2073,28 +2136,24 @@ Tcl_AppendFormatToObj(
 	 */
 
 	if (ch == 'h') {
-	    useShort = 1;
+	    specPtr->flags |= FORMAT_SHORT;
 	    format += step;
 	    step = TclUtfToUniChar(format, &ch);
 	} else if (ch == 'l') {
 	    format += step;
 	    step = TclUtfToUniChar(format, &ch);
 	    if (ch == 'l') {
-		useBig = 1;
+		specPtr->flags |= FORMAT_BIG;
 		format += step;
 		step = TclUtfToUniChar(format, &ch);
-#ifndef TCL_WIDE_INT_IS_LONG
 	    } else {
-		useWide = 1;
-#endif
+		specPtr->flags |= FORMAT_WIDE;
 	    }
 	} else if (ch == 'I') {
 	    if ((format[1] == '6') && (format[2] == '4')) {
 		format += (step + 2);
 		step = TclUtfToUniChar(format, &ch);
-#ifndef TCL_WIDE_INT_IS_LONG
-		useWide = 1;
-#endif
+		specPtr->flags |= FORMAT_WIDE;
 	    } else if ((format[1] == '3') && (format[2] == '2')) {
 		format += (step + 2);
 		step = TclUtfToUniChar(format, &ch);
@@ -2106,139 +2165,598 @@ Tcl_AppendFormatToObj(
 		|| (ch == 'L')) {
 	    format += step;
 	    step = TclUtfToUniChar(format, &ch);
-	    useBig = 1;
+	    specPtr->flags |= FORMAT_BIG;
 	}
 
 	format += step;
 	span = format;
 
 	/*
-	 * Step 6. The actual conversion character.
+	 * Step 6. The actual conversion character. A missing or bad one ends
+	 * the parse.
 	 */
 
-	segment = objv[objIndex];
-	numChars = -1;
 	if (ch == 'i') {
 	    ch = 'd';
 	}
+	specPtr->ch = ch;
 	switch (ch) {
-	case '\0':
-	    msg = "format string ended in middle of field specifier";
-	    errCode = "INCOMPLETE";
-	    goto errorMsg;
-	case 's':
-	    if (gotPrecision) {
-		numChars = Tcl_GetCharLength(segment);
-		if (precision < numChars) {
-		    if (precision < 1) {
-			TclNewObj(segment);
-		    } else {
-			segment = Tcl_GetRange(segment, 0, precision - 1);
-		    }
-		    numChars = precision;
-		    Tcl_IncrRefCount(segment);
-		    allocSegment = 1;
-		}
-	    }
-	    break;
-	case 'c': {
-	    char buf[4] = "";
-	    int code, length;
-
-	    if (TclGetIntFromObj(interp, segment, &code) != TCL_OK) {
-		goto error;
-	    }
-	    if ((unsigned)code > 0x10FFFF) {
-	    	code = 0xFFFD;
-	    }
-	    length = Tcl_UniCharToUtf(code, buf);
-	    segment = Tcl_NewStringObj(buf, length);
-	    Tcl_IncrRefCount(segment);
-	    allocSegment = 1;
-	    break;
+	case 's': case 'c':
+	case 'u': case 'd': case 'o': case 'p': case 'x': case 'X': case 'b':
+	case 'a': case 'A': case 'e': case 'E': case 'f': case 'g': case 'G':
+	    continue;
 	}
+	break;
+    }
+    return fmtPtr;
+}
 
-	case 'u':
-	    /* FALLTHRU */
-	case 'd':
-	case 'o':
-	case 'p':
-	case 'x':
-	case 'X':
-	case 'b': {
-	    short s = 0;	/* Silence compiler warning; only defined and
-				 * used when useShort is true. */
-	    long l;
-	    Tcl_WideInt w;
-	    mp_int big;
-	    int isNegative = 0;
-	    Tcl_Size toAppend;
-
-#ifndef TCL_WIDE_INT_IS_LONG
-	    if (ch == 'p') {
-		useWide = 1;
-	    }
-#endif
-	    if (useBig) {
-		int cmpResult;
-		if (Tcl_GetBignumFromObj(interp, segment, &big) != TCL_OK) {
-		    goto error;
-		}
-		cmpResult = mp_cmp_d(&big, 0);
-		isNegative = (cmpResult == MP_LT);
-		if (cmpResult == MP_EQ) {
-		    gotHash = 0;
-		}
-		if (ch == 'u') {
-		    if (isNegative) {
-			mp_clear(&big);
-			msg = "unsigned bignum format is invalid";
-			errCode = "BADUNSIGNED";
-			goto errorMsg;
-		    } else {
-			ch = 'd';
-		    }
-		}
-#ifndef TCL_WIDE_INT_IS_LONG
-	    } else if (useWide) {
-		if (TclGetWideBitsFromObj(interp, segment, &w) != TCL_OK) {
-		    goto error;
-		}
-		isNegative = (w < (Tcl_WideInt) 0);
-		if (w == (Tcl_WideInt) 0) {
-		    gotHash = 0;
-		}
-#endif
-	    } else if (TclGetLongFromObj(NULL, segment, &l) != TCL_OK) {
-		if (TclGetWideBitsFromObj(interp, segment, &w) != TCL_OK) {
-		    goto error;
-		} else {
-		    l = (long) w;
-		}
-		if (useShort) {
-		    s = (short) l;
-		    isNegative = (s < (short) 0);
-		    if (s == (short) 0) {
-			gotHash = 0;
-		    }
-		} else {
-		    isNegative = (l < (long) 0);
-		    if (l == (long) 0) {
-			gotHash = 0;
-		    }
-		}
-	    } else if (useShort) {
-		s = (short) l;
-		isNegative = (s < (short) 0);
-		if (s == (short) 0) {
-		    gotHash = 0;
-		}
-	    } else {
-		isNegative = (l < (long) 0);
-		if (l == (long) 0) {
-		    gotHash = 0;
-		}
-	    }
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetParsedFormatFromObj --
+ *
+ *	Get the parsed form of a format string, parsing it if the value does
+ *	not already hold it.
+ *
+ * Results:
+ *	The parsed format.
+ *
+ * Side effects:
+ *	Changes the internal rep of formatObj.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ParsedFormat *
+GetParsedFormatFromObj(
+    Tcl_Obj *formatObj)		/* The format string. */
+{
+    const Tcl_ObjInternalRep *irPtr;
+    Tcl_ObjInternalRep ir;
+    ParsedFormat *fmtPtr;
+
+    irPtr = TclFetchInternalRep(formatObj, &parsedFormatType);
+    if (irPtr != NULL) {
+	return (ParsedFormat *) irPtr->twoPtrValue.ptr1;
+    }
+    fmtPtr = ParseFormat(TclGetString(formatObj));
+    fmtPtr->refCount++;
+    ir.twoPtrValue.ptr1 = fmtPtr;
+    ir.twoPtrValue.ptr2 = NULL;
+    Tcl_StoreInternalRep(formatObj, &parsedFormatType, &ir);
+    return fmtPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleaseParsedFormat, FreeParsedFormatInternalRep,
+ * DupParsedFormatInternalRep --
+ *
+ *	Manage the references to a parsed format string.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The parsed format is freed when its last reference goes.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ReleaseParsedFormat(
+    ParsedFormat *fmtPtr)
+{
+    if (fmtPtr->refCount-- <= 1) {
+	Tcl_Free(fmtPtr);
+    }
+}
+
+static void
+FreeParsedFormatInternalRep(
+    Tcl_Obj *objPtr)
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(objPtr, &parsedFormatType);
+
+    ReleaseParsedFormat((ParsedFormat *) irPtr->twoPtrValue.ptr1);
+}
+
+static void
+DupParsedFormatInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(srcPtr, &parsedFormatType);
+    ParsedFormat *fmtPtr = (ParsedFormat *) irPtr->twoPtrValue.ptr1;
+    Tcl_ObjInternalRep ir;
+
+    fmtPtr->refCount++;
+    ir.twoPtrValue.ptr1 = fmtPtr;
+    ir.twoPtrValue.ptr2 = NULL;
+    Tcl_StoreInternalRep(copyPtr, &parsedFormatType, &ir);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AppendFormatField --
+ *
+ *	Append a formatted field made only of ASCII characters to the result
+ *	of Tcl_AppendFormatToObj, padded out to its width as the general case
+ *	in AppendParsedFormat does with the field held in a value.
+ *
+ * Results:
+ *	TCL_OK, or TCL_ERROR when the field would make the result too big.
+ *
+ * Side effects:
+ *	Appends to appendObj and lowers *limitPtr accordingly.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+AppendFormatField(
+    Tcl_Obj *appendObj,		/* The result being built. */
+    const char *bytes,		/* The field... */
+    Tcl_Size numBytes,		/* ...and its length. */
+    Tcl_WideInt width,		/* The minimum field width. */
+    int gotMinus,		/* Whether to pad on the right. */
+    int gotZero,		/* Whether to pad with zeroes. */
+    Tcl_Size *limitPtr)		/* How much more the result may grow. */
+{
+    static const char zeroes[] = "0000000000000000";
+    static const char blanks[] = "                ";
+    const char *pad = (gotZero ? zeroes : blanks);
+    Tcl_WideInt padding = width - numBytes, count;
+
+    if (!gotMinus && (padding > 0)) {
+	*limitPtr -= padding;
+	for (count = padding; count > 0; count -= 16) {
+	    Tcl_AppendToObj(appendObj, pad, (count < 16 ? count : 16));
+	}
+	padding = 0;
+    }
+    if (numBytes > *limitPtr) {
+	return TCL_ERROR;
+    }
+    Tcl_AppendToObj(appendObj, bytes, numBytes);
+    *limitPtr -= numBytes;
+    if (padding > 0) {
+	*limitPtr -= padding;
+	for (count = padding; count > 0; count -= 16) {
+	    Tcl_AppendToObj(appendObj, pad, (count < 16 ? count : 16));
+	}
+    }
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_AppendFormatToObj --
+ *
+ *	This function appends a list of Tcl_Obj's to a Tcl_Obj according to
+ *	the formatting instructions embedded in the format string. The
+ *	formatting instructions are inspired by sprintf(). Returns TCL_OK when
+ *	successful. If there's an error in the arguments, TCL_ERROR is
+ *	returned, and an error message is written to the interp, if non-NULL.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tcl_AppendFormatToObj(
+    Tcl_Interp *interp,
+    Tcl_Obj *appendObj,
+    const char *format,
+    Tcl_Size objc,
+    Tcl_Obj *const objv[])
+{
+    ParsedFormat *fmtPtr = ParseFormat(format);
+    int result;
+
+    result = AppendParsedFormat(interp, appendObj, format, fmtPtr, objc,
+	    objv);
+    Tcl_Free(fmtPtr);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AppendParsedFormat --
+ *
+ *	Does the work of Tcl_AppendFormatToObj, following the format string
+ *	as parsed by ParseFormat.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+AppendParsedFormat(
+    Tcl_Interp *interp,
+    Tcl_Obj *appendObj,
+    const char *format,		/* The format string... */
+    const ParsedFormat *fmtPtr,	/* ...and its parsed form. */
+    Tcl_Size objc,
+    Tcl_Obj *const objv[])
+{
+    const FormatSpec *specPtr = fmtPtr->specs;
+    const FormatSpec *lastPtr = fmtPtr->specs + fmtPtr->numSpecs;
+    const char *msg, *errCode;
+    Tcl_Size objIndex = 0, originalLength, limit;
+    static const char *mixedXPG =
+	    "cannot mix \"%\" and \"%n$\" conversion specifiers";
+    static const char *const badIndex[2] = {
+	"not enough arguments for all format specifiers",
+	"\"%n$\" argument index out of range"
+    };
+    static const char *overflow = "max size for a Tcl value exceeded";
+
+    if (Tcl_IsShared(appendObj)) {
+	Tcl_Panic("%s called with shared object", "Tcl_AppendFormatToObj");
+    }
+    (void)TclGetStringFromObj(appendObj, &originalLength);
+    limit = TCL_SIZE_MAX - originalLength;
+
+    for (; specPtr < lastPtr; specPtr++) {
+	int flags = specPtr->flags;
+	int gotXpg = ((flags & FORMAT_XPG) != 0);
+	int gotMinus = ((flags & FORMAT_MINUS) != 0);
+	int gotHash = ((flags & FORMAT_HASH) != 0);
+	int gotZero = ((flags & FORMAT_ZERO) != 0);
+	int gotSpace = ((flags & FORMAT_SPACE) != 0);
+	int gotPlus = ((flags & FORMAT_PLUS) != 0);
+	int gotPrecision = ((flags & FORMAT_PRECISION) != 0);
+	int useShort = ((flags & FORMAT_SHORT) != 0);
+	int useBig = ((flags & FORMAT_BIG) != 0);
+	Tcl_WideInt width, precision;
+#ifndef TCL_WIDE_INT_IS_LONG
+	int useWide = ((flags & FORMAT_WIDE) != 0);
+#endif
+	int allocSegment = 0, ch = specPtr->ch;
+	Tcl_Size numChars, segmentLimit, segmentNumBytes;
+	Tcl_Obj *segment;
+
+	if (specPtr->textLength) {
+	    if (specPtr->textLength > limit) {
+		msg = overflow;
+		errCode = "OVERFLOW";
+		goto errorMsg;
+	    }
+	    Tcl_AppendToObj(appendObj, format + specPtr->textStart,
+		    specPtr->textLength);
+	    limit -= specPtr->textLength;
+	}
+	if (flags & FORMAT_TEXT) {
+	    continue;
+	}
+
+	/*
+	 * Work out which argument the specifier applies to.
+	 */
+
+	if (specPtr->errorAt == FORMAT_ERROR_MIXED) {
+	    msg = mixedXPG;
+	    errCode = "MIXEDSPECTYPES";
+	    goto errorMsg;
+	}
+	if (gotXpg) {
+	    objIndex = specPtr->position - 1;
+	}
+	if ((objIndex < 0) || (objIndex >= objc)) {
+	    msg = badIndex[gotXpg];
+	    errCode = gotXpg ? "INDEXRANGE" : "FIELDVARMISMATCH";
+	    goto errorMsg;
+	}
+
+	/*
+	 * Minimum field width.
+	 */
+
+	if (specPtr->errorAt == FORMAT_ERROR_WIDTH) {
+	    msg = overflow;
+	    errCode = "OVERFLOW";
+	    goto errorMsg;
+	}
+	width = specPtr->width;
+	if (flags & FORMAT_WIDTH_ARG) {
+	    if (objIndex >= objc - 1) {
+		msg = badIndex[gotXpg];
+		errCode = gotXpg ? "INDEXRANGE" : "FIELDVARMISMATCH";
+		goto errorMsg;
+	    }
+	    if (TclGetWideIntFromObj(interp, objv[objIndex], &width) != TCL_OK) {
+		goto error;
+	    }
+	    if (width < 0) {
+		width = -width;
+		gotMinus = 1;
+	    }
+	    objIndex++;
+	}
+	if (width > limit) {
+	    msg = overflow;
+	    errCode = "OVERFLOW";
+	    goto errorMsg;
+	}
+
+	/*
+	 * Precision.
+	 */
+
+	if (specPtr->errorAt == FORMAT_ERROR_PRECISION) {
+	    msg = overflow;
+	    errCode = "OVERFLOW";
+	    goto errorMsg;
+	}
+	precision = specPtr->precision;
+	if (flags & FORMAT_PRECISION_ARG) {
+	    if (objIndex >= objc - 1) {
+		msg = badIndex[gotXpg];
+		errCode = gotXpg ? "INDEXRANGE" : "FIELDVARMISMATCH";
+		goto errorMsg;
+	    }
+	    if (TclGetWideIntFromObj(interp, objv[objIndex], &precision)
+		    != TCL_OK) {
+		goto error;
+	    }
+
+	    /*
+	     * TODO: Check this truncation logic.
+	     */
+
+	    if (precision < 0) {
+		precision = 0;
+	    }
+	    objIndex++;
+	}
+
+	/*
+	 * The actual conversion.
+	 */
+
+	segment = objv[objIndex];
+	numChars = -1;
+	switch (ch) {
+	case '\0':
+	    msg = "format string ended in middle of field specifier";
+	    errCode = "INCOMPLETE";
+	    goto errorMsg;
+	case 's':
+	    if (gotPrecision) {
+		numChars = Tcl_GetCharLength(segment);
+		if (precision < numChars) {
+		    if (precision < 1) {
+			TclNewObj(segment);
+		    } else {
+			segment = Tcl_GetRange(segment, 0, precision - 1);
+		    }
+		    numChars = precision;
+		    Tcl_IncrRefCount(segment);
+		    allocSegment = 1;
+		}
+	    }
+	    break;
+	case 'c': {
+	    char buf[4] = "";
+	    int code, length;
+
+	    if (TclGetIntFromObj(interp, segment, &code) != TCL_OK) {
+		goto error;
+	    }
+	    if ((unsigned)code > 0x10FFFF) {
+	    	code = 0xFFFD;
+	    }
+	    length = Tcl_UniCharToUtf(code, buf);
+	    segment = Tcl_NewStringObj(buf, length);
+	    Tcl_IncrRefCount(segment);
+	    allocSegment = 1;
+	    break;
+	}
+
+	case 'u':
+	    /* FALLTHRU */
+	case 'd':
+	case 'o':
+	case 'p':
+	case 'x':
+	case 'X':
+	case 'b': {
+	    short s = 0;	/* Silence compiler warning; only defined and
+				 * used when useShort is true. */
+	    long l;
+	    Tcl_WideInt w;
+	    mp_int big;
+	    int isNegative = 0;
+	    Tcl_Size toAppend;
+
+#ifndef TCL_WIDE_INT_IS_LONG
+	    if (ch == 'p') {
+		useWide = 1;
+	    }
+#endif
+	    if (useBig) {
+		int cmpResult;
+		if (Tcl_GetBignumFromObj(interp, segment, &big) != TCL_OK) {
+		    goto error;
+		}
+		cmpResult = mp_cmp_d(&big, 0);
+		isNegative = (cmpResult == MP_LT);
+		if (cmpResult == MP_EQ) {
+		    gotHash = 0;
+		}
+		if (ch == 'u') {
+		    if (isNegative) {
+			mp_clear(&big);
+			msg = "unsigned bignum format is invalid";
+			errCode = "BADUNSIGNED";
+			goto errorMsg;
+		    } else {
+			ch = 'd';
+		    }
+		}
+#ifndef TCL_WIDE_INT_IS_LONG
+	    } else if (useWide) {
+		if (TclGetWideBitsFromObj(interp, segment, &w) != TCL_OK) {
+		    goto error;
+		}
+		isNegative = (w < (Tcl_WideInt) 0);
+		if (w == (Tcl_WideInt) 0) {
+		    gotHash = 0;
+		}
+#endif
+	    } else if (TclGetLongFromObj(NULL, segment, &l) != TCL_OK) {
+		if (TclGetWideBitsFromObj(interp, segment, &w) != TCL_OK) {
+		    goto error;
+		} else {
+		    l = (long) w;
+		}
+		if (useShort) {
+		    s = (short) l;
+		    isNegative = (s < (short) 0);
+		    if (s == (short) 0) {
+			gotHash = 0;
+		    }
+		} else {
+		    isNegative = (l < (long) 0);
+		    if (l == (long) 0) {
+			gotHash = 0;
+		    }
+		}
+	    } else if (useShort) {
+		s = (short) l;
+		isNegative = (s < (short) 0);
+		if (s == (short) 0) {
+		    gotHash = 0;
+		}
+	    } else {
+		isNegative = (l < (long) 0);
+		if (l == (long) 0) {
+		    gotHash = 0;
+		}
+	    }
+
+	    /*
+	     * A native integer in a field that is not too wide is converted
+	     * in a local buffer: decimal digits are made two at a time, the
+	     * others by shifting the bits out.
+	     */
+
+	    if (!useBig && (width < FORMAT_SMALL_FIELD)
+		    && (precision < FORMAT_SMALL_FIELD)) {
+		char buf[2 * FORMAT_SMALL_FIELD], *p = buf, *digits;
+		char digitBuf[CHAR_BIT * sizeof(Tcl_WideUInt) + 1];
+		Tcl_Size numDigits, length;
+		Tcl_WideInt value;
+		Tcl_WideUInt bits;
+
+		if (useShort) {
+		    value = s;
+		    bits = (unsigned short) s;
+#ifndef TCL_WIDE_INT_IS_LONG
+		} else if (useWide) {
+		    value = w;
+		    bits = (Tcl_WideUInt) w;
+#endif
+		} else {
+		    value = l;
+		    bits = (unsigned long) l;
+		}
+		if ((ch == 'd') || ((ch == 'u') && (bits <= WIDE_MAX))) {
+		    numDigits = TclFormatInt(digitBuf,
+			    (ch == 'd') ? value : (Tcl_WideInt) bits);
+		    digits = digitBuf;
+		    if (*digits == '-') {
+			digits++;
+			numDigits--;
+		    }
+		} else {
+		    digits = digitBuf + sizeof(digitBuf);
+		    if (ch == 'u') {
+			do {
+			    *--digits = (char) ('0' + bits % 10);
+			    bits /= 10;
+			} while (bits);
+		    } else {
+			int numBits = (ch == 'o') ? 3 : (ch == 'b') ? 1 : 4;
+			const char *hexDigits = (ch == 'X')
+				? "0123456789ABCDEF" : "0123456789abcdef";
+
+			do {
+			    *--digits = hexDigits[bits & ((1 << numBits) - 1)];
+			    bits >>= numBits;
+			} while (bits);
+		    }
+		    numDigits = digitBuf + sizeof(digitBuf) - digits;
+		}
+
+		if ((isNegative || gotPlus || gotSpace) && (ch == 'd')) {
+		    *p++ = (isNegative ? '-' : gotPlus ? '+' : ' ');
+		}
+		if (gotHash || (ch == 'p')) {
+		    switch (ch) {
+		    case 'o':
+			*p++ = '0';
+			*p++ = 'o';
+			break;
+		    case 'p':
+		    case 'x':
+		    case 'X':
+			*p++ = '0';
+			*p++ = 'x';
+			break;
+		    case 'b':
+			*p++ = '0';
+			*p++ = 'b';
+			break;
+		    case 'd':
+			*p++ = '0';
+			*p++ = 'd';
+			break;
+		    }
+		}
+		length = numDigits;
+		if (gotPrecision) {
+		    while (length < precision) {
+			*p++ = '0';
+			length++;
+		    }
+		    gotZero = 0;
+		}
+		if (gotZero) {
+		    length += p - buf;
+		    while (length < width) {
+			*p++ = '0';
+			length++;
+		    }
+		}
+		memcpy(p, digits, numDigits);
+		p += numDigits;
+		if (AppendFormatField(appendObj, buf, p - buf, width, gotMinus,
+			gotZero, &limit) != TCL_OK) {
+		    msg = overflow;
+		    errCode = "OVERFLOW";
+		    goto errorMsg;
+		}
+		goto doneSpec;
+	    }
 
 	    TclNewObj(segment);
 	    allocSegment = 1;
@@ -2510,14 +3028,14 @@ Tcl_AppendFormatToObj(
 		*p++ = '+';
 	    }
 	    if (width) {
-		p += snprintf(p, TCL_INTEGER_SPACE, "%" TCL_LL_MODIFIER "d", width);
+		p += TclFormatInt(p, width);
 		if (width > length) {
 		    length = width;
 		}
 	    }
 	    if (gotPrecision) {
 		*p++ = '.';
-		p += snprintf(p, TCL_INTEGER_SPACE, "%" TCL_LL_MODIFIER "d", precision);
+		p += TclFormatInt(p, precision);
 		if (precision > TCL_SIZE_MAX - length) {
 		    msg = overflow;
 		    errCode = "OVERFLOW";
@@ -2533,6 +3051,31 @@ Tcl_AppendFormatToObj(
 	    *p++ = (char) ch;
 	    *p = '\0';
 
+	    /*
+	     * Most fields fit in a local buffer.
+	     */
+
+	    if (length < FORMAT_FLOAT_BUFFER) {
+		char buf[FORMAT_FLOAT_BUFFER];
+		int n = snprintf(buf, length, spec, d);
+
+		if (ch == 'A') {
+		    char *q = buf + 1;
+		    *q = 'x';
+		    q = strchr(q, 'P');
+		    if (q) {
+			*q = 'p';
+		    }
+		}
+		if (AppendFormatField(appendObj, buf, n, width, gotMinus,
+			gotZero, &limit) != TCL_OK) {
+		    msg = overflow;
+		    errCode = "OVERFLOW";
+		    goto errorMsg;
+		}
+		goto doneSpec;
+	    }
+
 	    TclNewObj(segment);
 	    allocSegment = 1;
 	    if (!Tcl_AttemptSetObjLength(segment, length)) {
@@ -2602,17 +3145,8 @@ Tcl_AppendFormatToObj(
 	    }
 	}
 
-	objIndex += gotSequential;
-    }
-    if (numBytes) {
-	if (numBytes > limit) {
-	    msg = overflow;
-	    errCode = "OVERFLOW";
-	    goto errorMsg;
-	}
-	Tcl_AppendToObj(appendObj, span, numBytes);
-	limit -= numBytes;
-	numBytes = 0;
+    doneSpec:
+	objIndex += !gotXpg;
     }
 
     return TCL_OK;
@@ -2627,39 +3161,87 @@ Tcl_AppendFormatToObj(
     return TCL_ERROR;
 }
 
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * Tcl_Format --
+ *
+ * Results:
+ *	A refcount zero Tcl_Obj.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+Tcl_Format(
+    Tcl_Interp *interp,
+    const char *format,
+    Tcl_Size objc,
+    Tcl_Obj *const objv[])
+{
+    int result;
+    Tcl_Obj *objPtr;
+
+    TclNewObj(objPtr);
+    result = Tcl_AppendFormatToObj(interp, objPtr, format, objc, objv);
+    if (result != TCL_OK) {
+	Tcl_DecrRefCount(objPtr);
+	return NULL;
+    }
+    return objPtr;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
- * Tcl_Format --
+ * TclFormatObj --
+ *
+ *	Like Tcl_Format, but with the format string given as a value, in
+ *	which the parsed form is kept so that it is parsed only once. This is
+ *	the engine of the [format] command.
  *
  * Results:
- *	A refcount zero Tcl_Obj.
+ *	A refcount zero Tcl_Obj, or NULL with an error message left in the
+ *	interp's result.
  *
  * Side effects:
- *	None.
+ *	Changes the internal rep of formatObj.
  *
  *---------------------------------------------------------------------------
  */
 
 Tcl_Obj *
-Tcl_Format(
+TclFormatObj(
     Tcl_Interp *interp,
-    const char *format,
+    Tcl_Obj *formatObj,
     Tcl_Size objc,
     Tcl_Obj *const objv[])
 {
+    ParsedFormat *fmtPtr = GetParsedFormatFromObj(formatObj);
     int result;
     Tcl_Obj *objPtr;
 
+    /*
+     * Hold on to the parsed format: formatObj may also be one of the
+     * arguments, and lose its internal rep when that is converted.
+     */
+
+    fmtPtr->refCount++;
     TclNewObj(objPtr);
-    result = Tcl_AppendFormatToObj(interp, objPtr, format, objc, objv);
+    result = AppendParsedFormat(interp, objPtr, TclGetString(formatObj),
+	    fmtPtr, objc, objv);
+    ReleaseParsedFormat(fmtPtr);
     if (result != TCL_OK) {
 	Tcl_DecrRefCount(objPtr);
 	return NULL;
     }
     return objPtr;
 }
-
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -3810,6 +4392,124 @@ TclStringCmp(
     return match;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FindBytes, FindBytesLast --
+ *
+ *	Find the first or last occurrence of one byte sequence in another.
+ *	Candidates are located with memchr, which C libraries implement with
+ *	vector instructions, and checked at their last byte before the rest
+ *	is compared.
+ *
+ * Results:
+ *	Pointer to the start of the occurrence in the haystack, or NULL if
+ *	there is none.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static const unsigned char *
+FindBytes(
+    const unsigned char *bh,	/* The haystack... */
+    Tcl_Size lh,		/* ...and its length. */
+    const unsigned char *bn,	/* The needle... */
+    Tcl_Size ln)		/* ...and its length, at least 1. */
+{
+    const unsigned char *check = bh, *last;
+
+    if (lh < ln) {
+	return NULL;
+    }
+    last = bh + lh - ln;
+    while (check <= last) {
+	check = (const unsigned char *)
+		memchr(check, bn[0], (last + 1) - check);
+	if (check == NULL) {
+	    return NULL;
+	}
+	if ((check[ln-1] == bn[ln-1]) && (0 == memcmp(check+1, bn+1, ln-1))) {
+	    return check;
+	}
+	check++;
+    }
+    return NULL;
+}
+
+static const unsigned char *
+FindBytesLast(
+    const unsigned char *bh,	/* The haystack... */
+    Tcl_Size lh,		/* ...and its length. */
+    const unsigned char *bn,	/* The needle... */
+    Tcl_Size ln)		/* ...and its length, at least 1. */
+{
+    const unsigned char *check;
+    Tcl_Size offset;
+
+    if (lh < ln) {
+	return NULL;
+    }
+    for (offset = lh - ln; offset >= 0; offset--) {
+	check = bh + offset;
+	if ((*check == bn[0]) && (check[ln-1] == bn[ln-1])
+		&& (0 == memcmp(check+1, bn+1, ln-1))) {
+	    return check;
+	}
+    }
+    return NULL;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetUtfHaystack --
+ *
+ *	Decide whether [string first] and [string last] can look for a needle
+ *	in the string rep of a haystack instead of its Unicode rep, saving
+ *	the cost of making one. That needs a needle of ASCII characters,
+ *	since bytes below 0x80 only ever stand for themselves in a string
+ *	rep, and a haystack that has no Unicode rep already.
+ *
+ * Results:
+ *	The string rep of the haystack, with its length in *lengthPtr and in
+ *	*allSinglePtr whether every character in it is one byte, so that
+ *	byte and character indices agree. NULL if the search should use the
+ *	Unicode rep.
+ *
+ * Side effects:
+ *	The haystack may be converted to a string.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static const unsigned char *
+GetUtfHaystack(
+    Tcl_Obj *needle,
+    Tcl_Obj *haystack,
+    Tcl_Size *lengthPtr,
+    int *allSinglePtr)
+{
+    const char *bytes;
+    Tcl_Size i, length;
+
+    if (TclIsPureByteArray(haystack) || (TclHasInternalRep(haystack,
+	    &tclStringType) && GET_STRING(haystack)->hasUnicode)) {
+	return NULL;
+    }
+    bytes = TclGetStringFromObj(needle, &length);
+    for (i = 0; i < length; i++) {
+	if (UCHAR(bytes[i]) >= 0x80) {
+	    return NULL;
+	}
+    }
+    *allSinglePtr = (Tcl_GetCharLength(haystack) == haystack->length);
+    *lengthPtr = haystack->length;
+    return (const unsigned char *) haystack->bytes;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -3837,6 +4537,8 @@ TclStringFirst(
     Tcl_Size lh = 0, ln = Tcl_GetCharLength(needle);
     Tcl_Size value = -1;
     Tcl_UniChar *checkStr, *endStr, *uh, *un;
+    const unsigned char *bh, *found;
+    int allSingle;
     Tcl_Obj *obj;
 
     if (start < 0) {
@@ -3850,7 +4552,6 @@ TclStringFirst(
     }
 
     if (TclIsPureByteArray(needle) && TclIsPureByteArray(haystack)) {
-	unsigned char *end, *check, *bh;
 	unsigned char *bn = Tcl_GetBytesFromObj(NULL, needle, &ln);
 
 	/* Find bytes in bytes */
@@ -3859,28 +4560,30 @@ TclStringFirst(
 	    /* Don't start the loop if there cannot be a valid answer */
 	    goto firstEnd;
 	}
-	end = bh + lh;
+	found = FindBytes(bh + start, lh - start, bn, ln);
+	if (found != NULL) {
+	    value = found - bh;
+	}
+	goto firstEnd;
+    }
 
-	check = bh + start;
-	while (check + ln <= end) {
-	    /*
-	     * Look for the leading byte of the needle in the haystack
-	     * starting at check and stopping when there's not enough room
-	     * for the needle left.
-	     */
-	    check = (unsigned char *)memchr(check, bn[0], (end + 1 - ln) - check);
-	    if (check == NULL) {
-		/* Leading byte not found -> needle cannot be found. */
-		goto firstEnd;
-	    }
-	    /* Leading byte found, check rest of needle. */
-	    if (0 == memcmp(check+1, bn+1, ln-1)) {
-		/* Checks! Return the successful index. */
-		value = (check - bh);
-		goto firstEnd;
+    /*
+     * An ASCII needle can be found in the string rep. The index of a match
+     * is then its byte offset if all characters are single bytes; if not,
+     * only searches from the start are done this way, lest a loop over
+     * increasing start indices count characters from the beginning every
+     * time.
+     */
+
+    bh = GetUtfHaystack(needle, haystack, &lh, &allSingle);
+    if ((bh != NULL) && (allSingle || (start == 0))) {
+	if (start <= lh) {
+	    found = FindBytes(bh + start, lh - start,
+		    (const unsigned char *) needle->bytes, ln);
+	    if (found != NULL) {
+		value = allSingle ? (found - bh)
+			: Tcl_NumUtfChars((const char *) bh, found - bh);
 	    }
-	    /* Rest of needle match failed; Iterate to continue search. */
-	    check++;
 	}
 	goto firstEnd;
     }
@@ -3894,7 +4597,8 @@ TclStringFirst(
      * we explicitly decline to support.  Getting there will involve
      * locking down in practice more firmly just what encodings produce
      * what supported results for the objPtr->bytes values.  For now,
-     * do only the well-defined Tcl_UniChar array search.
+     * do only the well-defined Tcl_UniChar array search, apart from the
+     * ASCII needles handled above.
      */
 
     un = Tcl_GetUnicodeFromObj(needle, &ln);
@@ -3916,7 +4620,7 @@ TclStringFirst(
     TclNewIndexObj(obj, value);
     return obj;
 }
-
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -3944,6 +4648,8 @@ TclStringLast(
     Tcl_Size lh = 0, ln = Tcl_GetCharLength(needle);
     Tcl_Size value = -1;
     Tcl_UniChar *checkStr, *uh, *un;
+    const unsigned char *bh, *found;
+    int allSingle;
     Tcl_Obj *obj;
 
     if (ln == 0) {
@@ -3957,9 +4663,9 @@ TclStringLast(
     }
 
     if (TclIsPureByteArray(needle) && TclIsPureByteArray(haystack)) {
-	unsigned char *check, *bh = Tcl_GetBytesFromObj(NULL, haystack, &lh);
 	unsigned char *bn = Tcl_GetBytesFromObj(NULL, needle, &ln);
 
+	bh = Tcl_GetBytesFromObj(NULL, haystack, &lh);
 	if (last >= lh) {
 	    last = lh - 1;
 	}
@@ -3967,15 +4673,31 @@ TclStringLast(
 	    /* Don't start the loop if there cannot be a valid answer */
 	    goto lastEnd;
 	}
-	check = bh + last + 1 - ln;
+	found = FindBytesLast(bh, last + 1, bn, ln);
+	if (found != NULL) {
+	    value = found - bh;
+	}
+	goto lastEnd;
+    }
+
+    /*
+     * As for [string first], but only searches up to the end are done in
+     * the string rep unless its bytes are all characters.
+     */
 
-	while (check >= bh) {
-	    if ((*check == bn[0])
-		    && (0 == memcmp(check+1, bn+1, ln-1))) {
-		value = (check - bh);
-		goto lastEnd;
+    bh = GetUtfHaystack(needle, haystack, &lh, &allSingle);
+    if ((bh != NULL) && (allSingle || (last >= haystack->length - 1)
+	    || (last >= Tcl_GetCharLength(haystack) - 1))) {
+	if (!allSingle || (last >= lh)) {
+	    last = lh - 1;
+	}
+	if (last + 1 >= ln) {
+	    found = FindBytesLast(bh, last + 1,
+		    (const unsigned char *) needle->bytes, ln);
+	    if (found != NULL) {
+		value = allSingle ? (found - bh)
+			: Tcl_NumUtfChars((const char *) bh, found - bh);
 	    }
-	    check--;
 	}
 	goto lastEnd;
     }
@@ -4003,7 +4725,471 @@ TclStringLast(
     TclNewIndexObj(obj, value);
     return obj;
 }
-
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TclStringMap --
+ *
+ *	Implements the [string map] operation. The mapping is compiled into
+ *	a StringMap, cached as its internal rep, that chains together the
+ *	keys starting with each character, so that at each position of the
+ *	string only those keys are tried, in mapping order.
+ *
+ * Results:
+ *	The mapped string, or NULL with an error message left in the interp's
+ *	result if the mapping is not a list with an even number of elements.
+ *
+ * Side effects:
+ *	mapObj's internal rep is changed to the compiled mapping. sourceObj
+ *	may get a Unicode rep.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclStringMap(
+    Tcl_Interp *interp,		/* For error reporting. */
+    Tcl_Obj *mapObj,		/* The key/value pairs. */
+    Tcl_Obj *sourceObj,		/* The string to map. */
+    int nocase)			/* Whether keys match case-insensitively. */
+{
+    StringMap *mapPtr;
+    Tcl_Size length1, length2, pair;
+    Tcl_UniChar *ustring1, *p, *end, ch;
+    const char *bytes, *q, *bytesEnd;
+    Tcl_Obj *resultPtr;
+    Tcl_DString ds;
+    int copySource = 0;
+    int (*strCmpFn)(const Tcl_UniChar*, const Tcl_UniChar*, size_t);
+
+    mapPtr = GetStringMapFromObj(interp, mapObj, nocase);
+    if (mapPtr == NULL) {
+	return NULL;
+    }
+    mapPtr->refCount++;
+    if (mapPtr->numPairs == 0) {
+	/*
+	 * Empty charMap, just return whatever string was given.
+	 */
+
+	ReleaseStringMap(mapPtr);
+	return sourceObj;
+    }
+
+    /*
+     * Take a copy of the source string object if it is the same as the map
+     * string to cut out nasty sharing crashes. [Bug 1018562]
+     */
+
+    if (mapObj == sourceObj) {
+	sourceObj = Tcl_DuplicateObj(sourceObj);
+	copySource = 1;
+    }
+
+    /*
+     * Keys of ASCII characters can be matched in the string rep of the
+     * source, where bytes below 0x80 only ever stand for themselves, unless
+     * -nocase would let them match other characters, like the Kelvin sign.
+     * That saves making a Unicode rep of the source and of the result.
+     */
+
+    if (!nocase && mapPtr->asciiKeys && !TclIsPureByteArray(sourceObj)
+	    && !(TclHasInternalRep(sourceObj, &tclStringType)
+	    && GET_STRING(sourceObj)->hasUnicode)) {
+	bytes = TclGetStringFromObj(sourceObj, &length1);
+	bytesEnd = bytes + length1;
+	Tcl_DStringInit(&ds);
+	for (q = bytes; bytes < bytesEnd; bytes++) {
+	    if (UCHAR(*bytes) >= 0x80) {
+		continue;
+	    }
+	    for (pair = mapPtr->asciiPairs[UCHAR(*bytes)]; pair >= 0;
+		    pair = mapPtr->nextPair[pair]) {
+		length2 = mapPtr->keyByteLens[pair];
+		if ((bytesEnd - bytes < length2) || ((length2 > 1)
+			&& memcmp(mapPtr->keyBytes[pair] + 1, bytes + 1,
+			length2 - 1))) {
+		    continue;
+		}
+		Tcl_DStringAppend(&ds, q, bytes - q);
+		q = bytes + length2;
+		bytes = q - 1;
+		Tcl_DStringAppend(&ds, mapPtr->valueBytes[pair],
+			mapPtr->valueByteLens[pair]);
+		break;
+	    }
+	}
+	Tcl_DStringAppend(&ds, q, bytes - q);
+	resultPtr = Tcl_DStringToObj(&ds);
+	goto done;
+    }
+
+    ustring1 = Tcl_GetUnicodeFromObj(sourceObj, &length1);
+    if (length1 == 0) {
+	/*
+	 * Empty input string, just stop now.
+	 */
+
+	TclNewObj(resultPtr);
+	goto done;
+    }
+    end = ustring1 + length1;
+    strCmpFn = nocase ? TclUniCharNcasecmp : TclUniCharNcmp;
+
+    /*
+     * Force result to be Unicode
+     */
+
+    resultPtr = Tcl_NewUnicodeObj(ustring1, 0);
+    for (p = ustring1; ustring1 < end; ustring1++) {
+	ch = *ustring1;
+	if (nocase) {
+	    ch = (ch < 0x80) ? ASCII_TO_LOWER(ch)
+		    : (Tcl_UniChar) Tcl_UniCharToLower(ch);
+	}
+	pair = (ch < 0x80) ? mapPtr->asciiPairs[ch] : mapPtr->otherPairs;
+	for (; pair >= 0; pair = mapPtr->nextPair[pair]) {
+	    length2 = mapPtr->keyLens[pair];
+	    if ((mapPtr->firstChars[pair] != ch) || (end - ustring1 < length2)
+		    || ((length2 > 1) && strCmpFn(mapPtr->keys[pair], ustring1,
+		    length2))) {
+		continue;
+	    }
+
+	    /*
+	     * Put the skipped chars onto the result first, then the map value.
+	     */
+
+	    if (p != ustring1) {
+		Tcl_AppendUnicodeToObj(resultPtr, p, ustring1 - p);
+	    }
+	    p = ustring1 + length2;
+	    ustring1 = p - 1;
+	    Tcl_AppendUnicodeToObj(resultPtr, mapPtr->values[pair],
+		    mapPtr->valueLens[pair]);
+	    break;
+	}
+    }
+    if (p != ustring1) {
+	/*
+	 * Put the rest of the unmapped chars onto result.
+	 */
+
+	Tcl_AppendUnicodeToObj(resultPtr, p, ustring1 - p);
+    }
+
+  done:
+    if (copySource) {
+	Tcl_DecrRefCount(sourceObj);
+    }
+    ReleaseStringMap(mapPtr);
+    return resultPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetStringMapFromObj --
+ *
+ *	Get the compiled form of a [string map] mapping, compiling it if the
+ *	value does not already hold it for the same -nocase setting.
+ *
+ *	A dictionary without a string rep is taken in its own order. Otherwise
+ *	the mapping is a list, in which the first of any duplicate keys wins.
+ *	The compiled form of a value without a string rep is not cached, as
+ *	that would throw away its dictionary or list and give it a string rep,
+ *	which code that goes on to change the mapping would then have to pay
+ *	for on every call.
+ *
+ * Results:
+ *	The compiled mapping, or NULL with an error message left in the
+ *	interp's result. The caller must take a reference to it and release
+ *	that when done, which frees a mapping that is not cached.
+ *
+ * Side effects:
+ *	Changes the internal rep of mapObj, if it has a string rep.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static StringMap *
+GetStringMapFromObj(
+    Tcl_Interp *interp,		/* For error reporting. */
+    Tcl_Obj *mapObj,		/* The key/value pairs. */
+    int nocase)			/* Whether keys match case-insensitively. */
+{
+    const Tcl_ObjInternalRep *irPtr;
+    Tcl_ObjInternalRep ir;
+    StringMap *mapPtr;
+    Tcl_Obj **mapElemv;
+    Tcl_Size mapElemc, index;
+    Tcl_DictSearch search;
+    int done;
+
+    irPtr = TclFetchInternalRep(mapObj, &stringMapType);
+    if (irPtr != NULL) {
+	mapPtr = (StringMap *) irPtr->twoPtrValue.ptr1;
+	if (mapPtr->nocase == nocase) {
+	    return mapPtr;
+	}
+    }
+
+    /*
+     * This test is tricky, but has to be that way or you get other strange
+     * inconsistencies (see test string-10.20.1 for illustration why!)
+     */
+
+    if (!TclHasStringRep(mapObj) && TclHasInternalRep(mapObj, &tclDictType)) {
+	/*
+	 * We know the type exactly, so all dict operations will succeed for
+	 * sure. Copy the dictionary out into an array; that's the easiest
+	 * way to adapt this code...
+	 */
+
+	Tcl_DictObjSize(interp, mapObj, &mapElemc);
+	mapElemc *= 2;
+	mapElemv = (Tcl_Obj **) Tcl_Alloc(sizeof(Tcl_Obj *) * (mapElemc + 1));
+	Tcl_DictObjFirst(interp, mapObj, &search, mapElemv+0, mapElemv+1,
+		&done);
+	for (index = 2; index < mapElemc; index += 2) {
+	    Tcl_DictObjNext(&search, mapElemv+index, mapElemv+index+1, &done);
+	}
+	Tcl_DictObjDone(&search);
+	mapPtr = CompileStringMap(mapElemc, mapElemv, nocase, 0);
+	Tcl_Free(mapElemv);
+	return mapPtr;
+    } else {
+	if (TclListObjGetElements(interp, mapObj, &mapElemc,
+		&mapElemv) != TCL_OK) {
+	    return NULL;
+	}
+	if (mapElemc & 1) {
+	    /*
+	     * The charMap must be an even number of key/value items.
+	     */
+
+	    Tcl_SetObjResult(interp,
+		    Tcl_NewStringObj("char map list unbalanced", -1));
+	    Tcl_SetErrorCode(interp, "TCL", "OPERATION", "MAP",
+		    "UNBALANCED", (void *)NULL);
+	    return NULL;
+	}
+	if (!TclHasStringRep(mapObj)) {
+	    return CompileStringMap(mapElemc, mapElemv, nocase, 0);
+	}
+	mapPtr = CompileStringMap(mapElemc, mapElemv, nocase, 1);
+    }
+
+    mapPtr->refCount++;
+    ir.twoPtrValue.ptr1 = mapPtr;
+    ir.twoPtrValue.ptr2 = NULL;
+    Tcl_StoreInternalRep(mapObj, &stringMapType, &ir);
+    return mapPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CompileStringMap --
+ *
+ *	Build a StringMap from the elements of a mapping. If it is to be
+ *	cached, the keys and values are copied, as Unicode and as UTF-8, into
+ *	the same block as the StringMap itself. A mapping used only once just
+ *	points at the reps of the elements, which must then outlive it.
+ *
+ * Results:
+ *	The new StringMap, with a reference count of 0.
+ *
+ * Side effects:
+ *	The elements get Unicode reps.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static StringMap *
+CompileStringMap(
+    Tcl_Size mapElemc,		/* Number of elements, which is even. */
+    Tcl_Obj *const mapElemv[],	/* Keys alternating with their values. */
+    int nocase,			/* Whether keys match case-insensitively. */
+    int copy)			/* Whether to copy the keys and values. */
+{
+    StringMap *mapPtr;
+    Tcl_Size numPairs = mapElemc / 2, index, total = 0, totalBytes = 0;
+    Tcl_Size length, pair, asciiLast[128], otherLast = -1;
+    Tcl_UniChar *ustring, *chars, ch;
+    const char *bytes;
+    char *area;
+
+    for (index = 0; copy && (index < mapElemc); index++) {
+	(void) Tcl_GetUnicodeFromObj(mapElemv[index], &length);
+	total += length;
+	(void) TclGetStringFromObj(mapElemv[index], &length);
+	totalBytes += length;
+    }
+
+    area = (char *) Tcl_Alloc(sizeof(StringMap)
+	    + numPairs * (4 * sizeof(Tcl_UniChar *) + 5 * sizeof(Tcl_Size))
+	    + (numPairs + total) * sizeof(Tcl_UniChar) + totalBytes);
+    mapPtr = (StringMap *) area;
+    area += sizeof(StringMap);
+    mapPtr->keys = (Tcl_UniChar **) area;
+    area += numPairs * sizeof(Tcl_UniChar *);
+    mapPtr->values = (Tcl_UniChar **) area;
+    area += numPairs * sizeof(Tcl_UniChar *);
+    mapPtr->keyBytes = (char **) area;
+    area += numPairs * sizeof(char *);
+    mapPtr->valueBytes = (char **) area;
+    area += numPairs * sizeof(char *);
+    mapPtr->keyLens = (Tcl_Size *) area;
+    area += numPairs * sizeof(Tcl_Size);
+    mapPtr->valueLens = (Tcl_Size *) area;
+    area += numPairs * sizeof(Tcl_Size);
+    mapPtr->keyByteLens = (Tcl_Size *) area;
+    area += numPairs * sizeof(Tcl_Size);
+    mapPtr->valueByteLens = (Tcl_Size *) area;
+    area += numPairs * sizeof(Tcl_Size);
+    mapPtr->nextPair = (Tcl_Size *) area;
+    area += numPairs * sizeof(Tcl_Size);
+    mapPtr->firstChars = (Tcl_UniChar *) area;
+    chars = mapPtr->firstChars + numPairs;
+    area = (char *) (chars + total);
+
+    mapPtr->refCount = 0;
+    mapPtr->nocase = nocase;
+    mapPtr->numPairs = numPairs;
+    mapPtr->asciiKeys = 1;
+    mapPtr->otherPairs = -1;
+    for (index = 0; index < 128; index++) {
+	mapPtr->asciiPairs[index] = -1;
+	asciiLast[index] = -1;
+    }
+
+    for (pair = 0; pair < numPairs; pair++) {
+	ustring = Tcl_GetUnicodeFromObj(mapElemv[2*pair], &length);
+	mapPtr->keys[pair] = ustring;
+	mapPtr->keyLens[pair] = length;
+	if (copy) {
+	    memcpy(chars, ustring, length * sizeof(Tcl_UniChar));
+	    mapPtr->keys[pair] = chars;
+	    chars += length;
+	}
+	ustring = Tcl_GetUnicodeFromObj(mapElemv[2*pair+1], &length);
+	mapPtr->values[pair] = ustring;
+	mapPtr->valueLens[pair] = length;
+	if (copy) {
+	    memcpy(chars, ustring, length * sizeof(Tcl_UniChar));
+	    mapPtr->values[pair] = chars;
+	    chars += length;
+	}
+
+	bytes = TclGetStringFromObj(mapElemv[2*pair], &length);
+	mapPtr->keyBytes[pair] = (char *) bytes;
+	mapPtr->keyByteLens[pair] = length;
+	if (copy) {
+	    memcpy(area, bytes, length);
+	    mapPtr->keyBytes[pair] = area;
+	    area += length;
+	}
+	for (index = 0; index < length; index++) {
+	    if (UCHAR(bytes[index]) >= 0x80) {
+		mapPtr->asciiKeys = 0;
+	    }
+	}
+	bytes = TclGetStringFromObj(mapElemv[2*pair+1], &length);
+	mapPtr->valueBytes[pair] = (char *) bytes;
+	mapPtr->valueByteLens[pair] = length;
+	if (copy) {
+	    memcpy(area, bytes, length);
+	    mapPtr->valueBytes[pair] = area;
+	    area += length;
+	}
+	mapPtr->nextPair[pair] = -1;
+
+	/*
+	 * Chain the pair after the earlier ones whose keys start with the
+	 * same character. Empty keys never match.
+	 */
+
+	if (mapPtr->keyLens[pair] == 0) {
+	    mapPtr->firstChars[pair] = 0;
+	    continue;
+	}
+	ch = mapPtr->keys[pair][0];
+	if (nocase) {
+	    ch = (Tcl_UniChar) Tcl_UniCharToLower(ch);
+	}
+	mapPtr->firstChars[pair] = ch;
+	if (ch < 0x80) {
+	    if (asciiLast[ch] < 0) {
+		mapPtr->asciiPairs[ch] = pair;
+	    } else {
+		mapPtr->nextPair[asciiLast[ch]] = pair;
+	    }
+	    asciiLast[ch] = pair;
+	} else {
+	    if (otherLast < 0) {
+		mapPtr->otherPairs = pair;
+	    } else {
+		mapPtr->nextPair[otherLast] = pair;
+	    }
+	    otherLast = pair;
+	}
+    }
+    return mapPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ReleaseStringMap, FreeStringMapInternalRep, DupStringMapInternalRep --
+ *
+ *	Manage the references to a compiled [string map] mapping.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The mapping is freed when its last reference goes.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static void
+ReleaseStringMap(
+    StringMap *mapPtr)
+{
+    if (mapPtr->refCount-- <= 1) {
+	Tcl_Free(mapPtr);
+    }
+}
+
+static void
+FreeStringMapInternalRep(
+    Tcl_Obj *objPtr)
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(objPtr, &stringMapType);
+
+    ReleaseStringMap((StringMap *) irPtr->twoPtrValue.ptr1);
+}
+
+static void
+DupStringMapInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    const Tcl_ObjInternalRep *irPtr =
+	    TclFetchInternalRep(srcPtr, &stringMapType);
+    StringMap *mapPtr = (StringMap *) irPtr->twoPtrValue.ptr1;
+    Tcl_ObjInternalRep ir;
+
+    mapPtr->refCount++;
+    ir.twoPtrValue.ptr1 = mapPtr;
+    ir.twoPtrValue.ptr2 = NULL;
+    Tcl_StoreInternalRep(copyPtr, &stringMapType, &ir);
+}
+
 /*
  *---------------------------------------------------------------------------
  *
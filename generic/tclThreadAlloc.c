@@ -32,6 +32,13 @@
  * The following define the number of Tcl_Obj's to allocate/move at a time and
  * the high water mark to prune a per-thread cache. On a 32 bit system,
  * sizeof(Tcl_Obj) = 24 so 800 * 24 = ~16k.
+ *
+ * Free Tcl_Obj's travel between threads in magazines: chains of objects
+ * linked through internalRep.twoPtrValue.ptr1. The shared cache keeps a
+ * stack of whole magazines, linked through ptr2 of their first object, whose
+ * length field holds the number of objects in the magazine. Handing a
+ * magazine to or taking one from the shared cache is then a constant-time
+ * operation under objLockPtr.
  */
 
 #define NOBJALLOC	800
@@ -70,12 +77,19 @@ typedef union Block {
 
 /*
  * The following defines the minimum and and maximum block sizes and the number
- * of buckets in the bucket cache.
+ * of buckets in the bucket cache. Besides the powers of two from MINALLOC to
+ * MAXALLOC there is a bucket half way between each pair of them (48, 96,
+ * 192, ...), which roughly halves the space lost to rounding up requests.
+ * All block sizes are multiples of TCL_ALLOCALIGN, so the bucket for a
+ * request is found by indexing sizeBucket with its size in those units.
  */
 
 #define MINALLOC	((sizeof(Block) + 8 + (TCL_ALLOCALIGN-1)) & ~(TCL_ALLOCALIGN-1))
-#define NBUCKETS	(11 - (MINALLOC >> 5))
-#define MAXALLOC	(MINALLOC << (NBUCKETS - 1))
+#define NPOWERS		(11 - (MINALLOC >> 5))
+#define NBUCKETS	(2 * NPOWERS - 1)
+#define MAXALLOC	(MINALLOC << (NPOWERS - 1))
+#define SIZE2BUCKET(size) \
+	((int) sizeBucket[((size) - 1) / TCL_ALLOCALIGN])
 
 /*
  * The following structure defines a bucket of blocks with various accounting
@@ -107,8 +121,13 @@ typedef struct Cache {
     Tcl_ThreadId owner;		/* Which thread's cache is this? */
     Tcl_Obj *firstObjPtr;	/* List of free objects for thread */
     size_t numObjects;		/* Number of objects for thread */
-    Tcl_Obj *lastPtr;		/* Last object in this cache */
     size_t totalAssigned;	/* Total space assigned to thread */
+
+    /* Tcl_Obj accounting only */
+
+    size_t numObjGets;		/* Magazines taken from the shared cache */
+    size_t numObjPuts;		/* Magazines given to the shared cache */
+    size_t numObjAllocs;	/* Magazines allocated from the system */
     Bucket buckets[NBUCKETS];	/* The buckets for this thread */
 } Cache;
 
@@ -124,6 +143,13 @@ static struct {
     Tcl_Mutex *lockPtr;		/* Share bucket lock. */
 } bucketInfo[NBUCKETS];
 
+/*
+ * The following array maps request sizes, in units of TCL_ALLOCALIGN and
+ * including the Block overhead, to the smallest bucket that holds them.
+ */
+
+static unsigned char sizeBucket[MAXALLOC / TCL_ALLOCALIGN];
+
 /*
  * Static functions defined in this file.
  */
@@ -135,7 +161,7 @@ static void	PutBlocks(Cache *cachePtr, int bucket, size_t numMove);
 static int	GetBlocks(Cache *cachePtr, int bucket);
 static Block *	Ptr2Block(void *ptr);
 static void *	Block2Ptr(Block *blockPtr, int bucket, size_t reqSize);
-static void	MoveObjs(Cache *fromPtr, Cache *toPtr, size_t numMove);
+static Tcl_Obj *	GetObjs(void);
 static void	PutObjs(Cache *fromPtr, size_t numMove);
 
 /*
@@ -328,10 +354,7 @@ TclpAlloc(
 	    cachePtr->totalAssigned += reqSize;
 	}
     } else {
-	bucket = 0;
-	while (bucketInfo[bucket].blockSize < size) {
-	    bucket++;
-	}
+	bucket = SIZE2BUCKET(size);
 	if (cachePtr->buckets[bucket].numFree || GetBlocks(cachePtr, bucket)) {
 	    blockPtr = cachePtr->buckets[bucket].firstPtr;
 	    cachePtr->buckets[bucket].firstPtr = blockPtr->nextBlock;
@@ -523,16 +546,12 @@ TclThreadAllocObj(void)
     if (cachePtr->numObjects == 0) {
 	size_t numMove;
 
-	Tcl_MutexLock(objLockPtr);
-	numMove = sharedPtr->numObjects;
-	if (numMove > 0) {
-	    if (numMove > NOBJALLOC) {
-		numMove = NOBJALLOC;
-	    }
-	    MoveObjs(sharedPtr, cachePtr, numMove);
-	}
-	Tcl_MutexUnlock(objLockPtr);
-	if (cachePtr->numObjects == 0) {
+	objPtr = GetObjs();
+	if (objPtr != NULL) {
+	    cachePtr->firstObjPtr = objPtr;
+	    cachePtr->numObjects = objPtr->length;
+	    cachePtr->numObjGets++;
+	} else {
 	    Tcl_Obj *newObjsPtr;
 
 	    cachePtr->numObjects = numMove = NOBJALLOC;
@@ -540,13 +559,13 @@ TclThreadAllocObj(void)
 	    if (newObjsPtr == NULL) {
 		Tcl_Panic("alloc: could not allocate %" TCL_Z_MODIFIER "u new objects", numMove);
 	    }
-	    cachePtr->lastPtr = newObjsPtr + numMove - 1;
 	    objPtr = cachePtr->firstObjPtr;	/* NULL */
 	    while (numMove-- > 0) {
 		newObjsPtr[numMove].internalRep.twoPtrValue.ptr1 = objPtr;
 		objPtr = newObjsPtr + numMove;
 	    }
 	    cachePtr->firstObjPtr = newObjsPtr;
+	    cachePtr->numObjAllocs++;
 	}
     }
 
@@ -594,9 +613,6 @@ TclThreadFreeObj(
 
     objPtr->internalRep.twoPtrValue.ptr1 = cachePtr->firstObjPtr;
     cachePtr->firstObjPtr = objPtr;
-    if (cachePtr->numObjects == 0) {
-	cachePtr->lastPtr = objPtr;
-    }
     cachePtr->numObjects++;
 
     /*
@@ -614,7 +630,10 @@ TclThreadFreeObj(
  *
  * Tcl_GetMemoryInfo --
  *
- *	Return a list-of-lists of memory stats.
+ *	Return a list-of-lists of memory stats. Each cache contributes its
+ *	name, one element per bucket and a final "objs" element with the
+ *	number of free Tcl_Obj's and the counts of magazines taken from and
+ *	given to the shared cache and allocated from the system.
  *
  * Results:
  *	None.
@@ -654,6 +673,11 @@ Tcl_GetMemoryInfo(
 		    cachePtr->buckets[n].numLocks);
 	    Tcl_DStringAppendElement(dsPtr, buf);
 	}
+	snprintf(buf, sizeof(buf), "objs %" TCL_Z_MODIFIER "u %"
+		TCL_Z_MODIFIER "u %" TCL_Z_MODIFIER "u %" TCL_Z_MODIFIER "u",
+		cachePtr->numObjects, cachePtr->numObjGets,
+		cachePtr->numObjPuts, cachePtr->numObjAllocs);
+	Tcl_DStringAppendElement(dsPtr, buf);
 	Tcl_DStringEndSublist(dsPtr);
 	cachePtr = cachePtr->nextPtr;
     }
@@ -663,12 +687,13 @@ Tcl_GetMemoryInfo(
 /*
  *----------------------------------------------------------------------
  *
- * MoveObjs --
+ * GetObjs --
  *
- *	Move Tcl_Obj's between caches.
+ *	Take a magazine of free Tcl_Obj's from the shared cache.
  *
  * Results:
- *	None.
+ *	The first object of the magazine, whose length field holds the number
+ *	of objects in it, or NULL if the shared cache is empty.
  *
  * Side effects:
  *	None.
@@ -676,36 +701,19 @@ Tcl_GetMemoryInfo(
  *----------------------------------------------------------------------
  */
 
-static void
-MoveObjs(
-    Cache *fromPtr,
-    Cache *toPtr,
-    size_t numMove)
+static Tcl_Obj *
+GetObjs(void)
 {
-    Tcl_Obj *objPtr = fromPtr->firstObjPtr;
-    Tcl_Obj *fromFirstObjPtr = objPtr;
-
-    toPtr->numObjects += numMove;
-    fromPtr->numObjects -= numMove;
-
-    /*
-     * Find the last object to be moved; set the next one (the first one not
-     * to be moved) as the first object in the 'from' cache.
-     */
+    Tcl_Obj *objPtr;
 
-    while (numMove-- > 1) {
-	objPtr = (Tcl_Obj *)objPtr->internalRep.twoPtrValue.ptr1;
+    Tcl_MutexLock(objLockPtr);
+    objPtr = sharedPtr->firstObjPtr;
+    if (objPtr != NULL) {
+	sharedPtr->firstObjPtr = (Tcl_Obj *)objPtr->internalRep.twoPtrValue.ptr2;
+	sharedPtr->numObjects -= objPtr->length;
     }
-    fromPtr->firstObjPtr = (Tcl_Obj *)objPtr->internalRep.twoPtrValue.ptr1;
-
-    /*
-     * Move all objects as a block - they are already linked to each other, we
-     * just have to update the first and last.
-     */
-
-    toPtr->lastPtr = objPtr;
-    objPtr->internalRep.twoPtrValue.ptr1 = toPtr->firstObjPtr; /* NULL */
-    toPtr->firstObjPtr = fromFirstObjPtr;
+    Tcl_MutexUnlock(objLockPtr);
+    return objPtr;
 }
 
 /*
@@ -713,7 +721,7 @@ MoveObjs(
  *
  * PutObjs --
  *
- *	Move Tcl_Obj's from thread cache to shared cache.
+ *	Move Tcl_Obj's from thread cache to shared cache, as one magazine.
  *
  * Results:
  *	None.
@@ -730,7 +738,12 @@ PutObjs(
     size_t numMove)
 {
     size_t keep = fromPtr->numObjects - numMove;
-    Tcl_Obj *firstPtr, *lastPtr = NULL;
+    Tcl_Obj *firstPtr, *lastPtr;
+
+    /*
+     * Keep the most recently freed objects, which are at the front of the
+     * list, and cut the rest off to form the magazine.
+     */
 
     fromPtr->numObjects = keep;
     firstPtr = fromPtr->firstObjPtr;
@@ -743,22 +756,14 @@ PutObjs(
 	} while (keep-- > 1);
 	lastPtr->internalRep.twoPtrValue.ptr1 = NULL;
     }
-
-    /*
-     * Move all objects as a block - they are already linked to each other, we
-     * just have to update the first and last.
-     */
+    firstPtr->length = numMove;
+    fromPtr->numObjPuts++;
 
     Tcl_MutexLock(objLockPtr);
-    fromPtr->lastPtr->internalRep.twoPtrValue.ptr1 = sharedPtr->firstObjPtr;
+    firstPtr->internalRep.twoPtrValue.ptr2 = sharedPtr->firstObjPtr;
     sharedPtr->firstObjPtr = firstPtr;
-    if (sharedPtr->numObjects == 0) {
-	sharedPtr->lastPtr = fromPtr->lastPtr;
-    }
     sharedPtr->numObjects += numMove;
     Tcl_MutexUnlock(objLockPtr);
-
-    fromPtr->lastPtr = lastPtr;
 }
 
 /*
@@ -983,14 +988,15 @@ GetBlocks(
 
 	/*
 	 * If no blocks could be moved from shared, first look for a larger
-	 * block in this cache to split up.
+	 * block in this cache that splits up without a remainder.
 	 */
 
 	blockPtr = NULL;
 	n = NBUCKETS;
 	size = 0;
 	while (n-- > (size_t)bucket + 1) {
-	    if (cachePtr->buckets[n].numFree > 0) {
+	    if (cachePtr->buckets[n].numFree > 0 && bucketInfo[n].blockSize
+		    % bucketInfo[bucket].blockSize == 0) {
 		size = bucketInfo[n].blockSize;
 		blockPtr = cachePtr->buckets[n].firstPtr;
 		cachePtr->buckets[n].firstPtr = blockPtr->nextBlock;
@@ -1000,11 +1006,13 @@ GetBlocks(
 	}
 
 	/*
-	 * Otherwise, allocate a big new block directly.
+	 * Otherwise, allocate a big new block directly, sized to a whole
+	 * number of blocks of this bucket.
 	 */
 
 	if (blockPtr == NULL) {
-	    size = MAXALLOC;
+	    size = bucketInfo[bucket].blockSize
+		    * (MAXALLOC / bucketInfo[bucket].blockSize);
 	    blockPtr = (Block*)TclpSysAlloc(size);
 	    if (blockPtr == NULL) {
 		return 0;
@@ -1050,16 +1058,34 @@ void
 TclInitThreadAlloc(void)
 {
     unsigned int i;
+    size_t size;
 
     listLockPtr = TclpNewAllocMutex();
     objLockPtr = TclpNewAllocMutex();
     for (i = 0; i < NBUCKETS; ++i) {
-	bucketInfo[i].blockSize = MINALLOC << i;
-	bucketInfo[i].maxBlocks = ((size_t)1) << (NBUCKETS - 1 - i);
-	bucketInfo[i].numMove = i < NBUCKETS - 1 ?
-		(size_t)1 << (NBUCKETS - 2 - i) : 1;
+	size = MINALLOC << (i / 2);
+	if (i & 1) {
+	    size += size / 2;
+	}
+
+	/*
+	 * A thread keeps up to MAXALLOC bytes worth of free blocks in each
+	 * bucket before handing half of them over to the shared cache.
+	 */
+
+	bucketInfo[i].blockSize = size;
+	bucketInfo[i].maxBlocks = MAXALLOC / size;
+	bucketInfo[i].numMove = bucketInfo[i].maxBlocks > 1 ?
+		bucketInfo[i].maxBlocks / 2 : 1;
 	bucketInfo[i].lockPtr = TclpNewAllocMutex();
     }
+    for (i = 0, size = TCL_ALLOCALIGN; size <= MAXALLOC;
+	    size += TCL_ALLOCALIGN) {
+	while (bucketInfo[i].blockSize < size) {
+	    i++;
+	}
+	sizeBucket[(size - 1) / TCL_ALLOCALIGN] = (unsigned char) i;
+    }
     TclpInitAllocCache();
 }
 
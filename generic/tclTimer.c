@@ -14,8 +14,10 @@
 
 /*
  * For each timer callback that's pending there is one record of the following
- * type. The normal handlers (created by Tcl_CreateTimerHandler) are chained
- * together in a list sorted by time (earliest event first).
+ * type. The normal handlers (created by Tcl_CreateTimerHandler) are kept in a
+ * binary min-heap ordered by time (earliest event first), and by creation
+ * order among handlers with the same time. This keeps creating and deleting
+ * handlers logarithmic in the number of pending ones.
  */
 
 typedef struct TimerHandler {
@@ -23,9 +25,7 @@ typedef struct TimerHandler {
     Tcl_TimerProc *proc;	/* Function to call. */
     void *clientData;	/* Argument to pass to proc. */
     Tcl_TimerToken token;	/* Identifies handler so it can be deleted. */
-    struct TimerHandler *nextPtr;
-				/* Next event in queue, or NULL for end of
-				 * queue. */
+    size_t heapIndex;		/* Position of the handler in the heap. */
 } TimerHandler;
 
 /*
@@ -49,6 +49,8 @@ typedef struct AfterInfo {
 				 * rather than a timer handler. */
     struct AfterInfo *nextPtr;	/* Next in list of all "after" commands for
 				 * this interpreter. */
+    struct AfterInfo *prevPtr;	/* Previous in that list, or NULL for the
+				 * first one. */
 } AfterInfo;
 
 /*
@@ -63,6 +65,8 @@ typedef struct AfterAssocData {
     AfterInfo *firstAfterPtr;	/* First in list of all "after" commands still
 				 * pending for this interpreter, or NULL if
 				 * none. */
+    Tcl_HashTable afterTable;	/* Maps the identifiers of the pending "after"
+				 * commands to their AfterInfo. */
 } AfterAssocData;
 
 /*
@@ -92,7 +96,13 @@ typedef struct IdleHandler {
  */
 
 typedef struct {
-    TimerHandler *firstTimerHandlerPtr;	/* First event in queue. */
+    TimerHandler **timerHeap;	/* Pending timer handlers, as a binary
+				 * min-heap. The first one is the next to
+				 * fire. */
+    size_t numTimers;		/* Number of handlers in the heap. */
+    size_t timerHeapSize;	/* Number of slots allocated for the heap. */
+    Tcl_HashTable timerTable;	/* Maps timer tokens to their handler. */
+    int timerTableInit;		/* 1 if timerTable is initialized. */
     int lastTimerId;		/* Timer identifier of most recently created
 				 * timer. */
     int timerPending;		/* 1 if a timer event is in the queue. */
@@ -131,6 +141,25 @@ static Tcl_ThreadDataKey dataKey;
     (1000*((Tcl_WideInt)(t1).sec - (Tcl_WideInt)(t2).sec) + \
 	    ((t1).usec - (t2).usec + 999)/1000)
 
+/*
+ * Ordering of timer handlers in the heap. Handlers with the same time are
+ * ordered by token, so that they fire in the order they were created. Tokens
+ * are compared by difference, to cope with the identifiers wrapping around.
+ */
+
+#define TIMER_BEFORE(t1Ptr, t2Ptr) \
+    (TCL_TIME_BEFORE((t1Ptr)->time, (t2Ptr)->time) \
+	|| ((t1Ptr)->time.sec == (t2Ptr)->time.sec \
+	    && (t1Ptr)->time.usec == (t2Ptr)->time.usec \
+	    && (int)((unsigned) PTR2INT((t1Ptr)->token) \
+		- (unsigned) PTR2INT((t2Ptr)->token)) < 0))
+
+/*
+ * Initial number of slots in the timer heap.
+ */
+
+#define TIMER_HEAP_INITIAL 16
+
 /*
  * Sleeps under that number of milliseconds don't get double-checked
  * and are done in exactly one Tcl_Sleep(). This to limit gettimeofday()s.
@@ -162,6 +191,15 @@ static void		TimerExitProc(void *clientData);
 static int		TimerHandlerEventProc(Tcl_Event *evPtr, int flags);
 static void		TimerCheckProc(void *clientData, int flags);
 static void		TimerSetupProc(void *clientData, int flags);
+static void		TimerHeapInsert(ThreadSpecificData *tsdPtr,
+			    TimerHandler *timerHandlerPtr);
+static void		TimerHeapRemove(ThreadSpecificData *tsdPtr,
+			    TimerHandler *timerHandlerPtr);
+static void		TimerHeapSift(ThreadSpecificData *tsdPtr,
+			    size_t index);
+static void		AfterLink(AfterAssocData *assocPtr,
+			    AfterInfo *afterPtr);
+static void		AfterUnlink(AfterInfo *afterPtr);
 
 /*
  *----------------------------------------------------------------------
@@ -189,6 +227,10 @@ InitTimer(void)
 	Tcl_CreateEventSource(TimerSetupProc, TimerCheckProc, NULL);
 	Tcl_CreateThreadExitHandler(TimerExitProc, NULL);
     }
+    if (!tsdPtr->timerTableInit) {
+	Tcl_InitHashTable(&tsdPtr->timerTable, TCL_ONE_WORD_KEYS);
+	tsdPtr->timerTableInit = 1;
+    }
     return tsdPtr;
 }
 
@@ -217,14 +259,103 @@ TimerExitProc(
 
     Tcl_DeleteEventSource(TimerSetupProc, TimerCheckProc, NULL);
     if (tsdPtr != NULL) {
-	TimerHandler *timerHandlerPtr;
+	while (tsdPtr->numTimers > 0) {
+	    Tcl_Free(tsdPtr->timerHeap[--tsdPtr->numTimers]);
+	}
+	if (tsdPtr->timerHeap != NULL) {
+	    Tcl_Free(tsdPtr->timerHeap);
+	    tsdPtr->timerHeap = NULL;
+	    tsdPtr->timerHeapSize = 0;
+	}
+	if (tsdPtr->timerTableInit) {
+	    Tcl_DeleteHashTable(&tsdPtr->timerTable);
+	    tsdPtr->timerTableInit = 0;
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TimerHeapInsert, TimerHeapRemove, TimerHeapSift --
+ *
+ *	Maintain the heap of pending timer handlers. TimerHeapSift moves the
+ *	handler at the given index up or down until the heap order holds
+ *	again.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May grow the heap. Updates the heapIndex of all moved handlers.
+ *
+ *----------------------------------------------------------------------
+ */
 
-	timerHandlerPtr = tsdPtr->firstTimerHandlerPtr;
-	while (timerHandlerPtr != NULL) {
-	    tsdPtr->firstTimerHandlerPtr = timerHandlerPtr->nextPtr;
-	    Tcl_Free(timerHandlerPtr);
-	    timerHandlerPtr = tsdPtr->firstTimerHandlerPtr;
+static void
+TimerHeapSift(
+    ThreadSpecificData *tsdPtr,
+    size_t index)
+{
+    TimerHandler **heap = tsdPtr->timerHeap;
+    TimerHandler *timerHandlerPtr = heap[index];
+
+    while (index > 0) {
+	size_t parent = (index - 1) / 2;
+
+	if (!TIMER_BEFORE(timerHandlerPtr, heap[parent])) {
+	    break;
+	}
+	heap[index] = heap[parent];
+	heap[index]->heapIndex = index;
+	index = parent;
+    }
+    while (1) {
+	size_t child = 2 * index + 1;
+
+	if (child >= tsdPtr->numTimers) {
+	    break;
 	}
+	if (child + 1 < tsdPtr->numTimers
+		&& TIMER_BEFORE(heap[child + 1], heap[child])) {
+	    child++;
+	}
+	if (!TIMER_BEFORE(heap[child], timerHandlerPtr)) {
+	    break;
+	}
+	heap[index] = heap[child];
+	heap[index]->heapIndex = index;
+	index = child;
+    }
+    heap[index] = timerHandlerPtr;
+    timerHandlerPtr->heapIndex = index;
+}
+
+static void
+TimerHeapInsert(
+    ThreadSpecificData *tsdPtr,
+    TimerHandler *timerHandlerPtr)
+{
+    if (tsdPtr->numTimers == tsdPtr->timerHeapSize) {
+	tsdPtr->timerHeapSize = (tsdPtr->timerHeapSize == 0)
+		? TIMER_HEAP_INITIAL : 2 * tsdPtr->timerHeapSize;
+	tsdPtr->timerHeap = (TimerHandler **)Tcl_Realloc(tsdPtr->timerHeap,
+		tsdPtr->timerHeapSize * sizeof(TimerHandler *));
+    }
+    tsdPtr->timerHeap[tsdPtr->numTimers] = timerHandlerPtr;
+    TimerHeapSift(tsdPtr, tsdPtr->numTimers++);
+}
+
+static void
+TimerHeapRemove(
+    ThreadSpecificData *tsdPtr,
+    TimerHandler *timerHandlerPtr)
+{
+    size_t index = timerHandlerPtr->heapIndex;
+
+    if (index != --tsdPtr->numTimers) {
+	tsdPtr->timerHeap[index] = tsdPtr->timerHeap[tsdPtr->numTimers];
+	TimerHeapSift(tsdPtr, index);
     }
 }
 
@@ -294,8 +425,10 @@ TclCreateAbsoluteTimerHandler(
     Tcl_TimerProc *proc,
     void *clientData)
 {
-    TimerHandler *timerHandlerPtr, *tPtr2, *prevPtr;
+    TimerHandler *timerHandlerPtr;
     ThreadSpecificData *tsdPtr = InitTimer();
+    Tcl_HashEntry *hPtr;
+    int isNew;
 
     timerHandlerPtr = (TimerHandler *)Tcl_Alloc(sizeof(TimerHandler));
 
@@ -310,22 +443,14 @@ TclCreateAbsoluteTimerHandler(
     timerHandlerPtr->token = (Tcl_TimerToken) INT2PTR(tsdPtr->lastTimerId);
 
     /*
-     * Add the event to the queue in the correct position (ordered by event
-     * firing time).
+     * Add the event to the heap, and remember it under its token so that it
+     * can be deleted without searching.
      */
 
-    for (tPtr2 = tsdPtr->firstTimerHandlerPtr, prevPtr = NULL; tPtr2 != NULL;
-	    prevPtr = tPtr2, tPtr2 = tPtr2->nextPtr) {
-	if (TCL_TIME_BEFORE(timerHandlerPtr->time, tPtr2->time)) {
-	    break;
-	}
-    }
-    timerHandlerPtr->nextPtr = tPtr2;
-    if (prevPtr == NULL) {
-	tsdPtr->firstTimerHandlerPtr = timerHandlerPtr;
-    } else {
-	prevPtr->nextPtr = timerHandlerPtr;
-    }
+    TimerHeapInsert(tsdPtr, timerHandlerPtr);
+    hPtr = Tcl_CreateHashEntry(&tsdPtr->timerTable, timerHandlerPtr->token,
+	    &isNew);
+    Tcl_SetHashValue(hPtr, timerHandlerPtr);
 
     TimerSetupProc(NULL, TCL_ALL_EVENTS);
 
@@ -355,27 +480,22 @@ Tcl_DeleteTimerHandler(
     Tcl_TimerToken token)	/* Result previously returned by
 				 * Tcl_DeleteTimerHandler. */
 {
-    TimerHandler *timerHandlerPtr, *prevPtr;
+    TimerHandler *timerHandlerPtr;
     ThreadSpecificData *tsdPtr = InitTimer();
+    Tcl_HashEntry *hPtr;
 
     if (token == NULL) {
 	return;
     }
 
-    for (timerHandlerPtr = tsdPtr->firstTimerHandlerPtr, prevPtr = NULL;
-	    timerHandlerPtr != NULL; prevPtr = timerHandlerPtr,
-	    timerHandlerPtr = timerHandlerPtr->nextPtr) {
-	if (timerHandlerPtr->token != token) {
-	    continue;
-	}
-	if (prevPtr == NULL) {
-	    tsdPtr->firstTimerHandlerPtr = timerHandlerPtr->nextPtr;
-	} else {
-	    prevPtr->nextPtr = timerHandlerPtr->nextPtr;
-	}
-	Tcl_Free(timerHandlerPtr);
+    hPtr = Tcl_FindHashEntry(&tsdPtr->timerTable, token);
+    if (hPtr == NULL) {
 	return;
     }
+    timerHandlerPtr = (TimerHandler *)Tcl_GetHashValue(hPtr);
+    Tcl_DeleteHashEntry(hPtr);
+    TimerHeapRemove(tsdPtr, timerHandlerPtr);
+    Tcl_Free(timerHandlerPtr);
 }
 
 /*
@@ -412,15 +532,14 @@ TimerSetupProc(
 
 	blockTime.sec = 0;
 	blockTime.usec = 0;
-    } else if ((flags & TCL_TIMER_EVENTS) && tsdPtr->firstTimerHandlerPtr) {
+    } else if ((flags & TCL_TIMER_EVENTS) && tsdPtr->numTimers) {
 	/*
 	 * Compute the timeout for the next timer on the list.
 	 */
 
 	Tcl_GetTime(&blockTime);
-	blockTime.sec = tsdPtr->firstTimerHandlerPtr->time.sec - blockTime.sec;
-	blockTime.usec = tsdPtr->firstTimerHandlerPtr->time.usec -
-		blockTime.usec;
+	blockTime.sec = tsdPtr->timerHeap[0]->time.sec - blockTime.sec;
+	blockTime.usec = tsdPtr->timerHeap[0]->time.usec - blockTime.usec;
 	if (blockTime.usec < 0) {
 	    blockTime.sec -= 1;
 	    blockTime.usec += 1000000;
@@ -463,15 +582,14 @@ TimerCheckProc(
     Tcl_Time blockTime;
     ThreadSpecificData *tsdPtr = InitTimer();
 
-    if ((flags & TCL_TIMER_EVENTS) && tsdPtr->firstTimerHandlerPtr) {
+    if ((flags & TCL_TIMER_EVENTS) && tsdPtr->numTimers) {
 	/*
 	 * Compute the timeout for the next timer on the list.
 	 */
 
 	Tcl_GetTime(&blockTime);
-	blockTime.sec = tsdPtr->firstTimerHandlerPtr->time.sec - blockTime.sec;
-	blockTime.usec = tsdPtr->firstTimerHandlerPtr->time.usec -
-		blockTime.usec;
+	blockTime.sec = tsdPtr->timerHeap[0]->time.sec - blockTime.sec;
+	blockTime.usec = tsdPtr->timerHeap[0]->time.usec - blockTime.usec;
 	if (blockTime.usec < 0) {
 	    blockTime.sec -= 1;
 	    blockTime.usec += 1000000;
@@ -522,9 +640,10 @@ TimerHandlerEventProc(
     int flags)			/* Flags that indicate what events to handle,
 				 * such as TCL_FILE_EVENTS. */
 {
-    TimerHandler *timerHandlerPtr, **nextPtrPtr;
+    TimerHandler *timerHandlerPtr;
     Tcl_Time time;
     int currentTimerId;
+    long long start;
     ThreadSpecificData *tsdPtr = InitTimer();
 
     /*
@@ -556,21 +675,17 @@ TimerHandlerEventProc(
      *	  only way a new timer will even be considered runnable is if its
      *	  expiration time is within the same millisecond as the current time.
      *	  This is fairly likely on Windows, since it has a course granularity
-     *	  clock. Since timers are placed on the queue in time order with the
-     *	  most recently created handler appearing after earlier ones with the
-     *	  same expiration time, we don't have to worry about newer generation
-     *	  timers appearing before later ones.
+     *	  clock. Since timers are ordered by time, with the most recently
+     *	  created handler coming after earlier ones with the same expiration
+     *	  time, we don't have to worry about newer generation timers
+     *	  appearing before later ones.
      */
 
     tsdPtr->timerPending = 0;
     currentTimerId = tsdPtr->lastTimerId;
     Tcl_GetTime(&time);
-    while (1) {
-	nextPtrPtr = &tsdPtr->firstTimerHandlerPtr;
-	timerHandlerPtr = tsdPtr->firstTimerHandlerPtr;
-	if (timerHandlerPtr == NULL) {
-	    break;
-	}
+    while (tsdPtr->numTimers > 0) {
+	timerHandlerPtr = tsdPtr->timerHeap[0];
 
 	if (TCL_TIME_BEFORE(time, timerHandlerPtr->time)) {
 	    break;
@@ -589,8 +704,12 @@ TimerHandlerEventProc(
 	 * potential reentrancy problems.
 	 */
 
-	*nextPtrPtr = timerHandlerPtr->nextPtr;
+	Tcl_DeleteHashEntry(Tcl_FindHashEntry(&tsdPtr->timerTable,
+		timerHandlerPtr->token));
+	TimerHeapRemove(tsdPtr, timerHandlerPtr);
+	start = TclEventStatsStart();
 	timerHandlerPtr->proc(timerHandlerPtr->clientData);
+	TclEventStatsRecord(TCL_EVSTATS_TIMER, start);
 	Tcl_Free(timerHandlerPtr);
     }
     TimerSetupProc(NULL, TCL_TIMER_EVENTS);
@@ -714,11 +833,21 @@ TclServiceIdle(void)
     IdleHandler *idlePtr;
     int oldGeneration;
     Tcl_Time blockTime;
+    long long start;
     ThreadSpecificData *tsdPtr = InitTimer();
 
     if (tsdPtr->idleList == NULL) {
 	return 0;
     }
+    if (TclEventStatsEnabled()) {
+	Tcl_Size backlog = 0;
+
+	for (idlePtr = tsdPtr->idleList; idlePtr != NULL;
+		idlePtr = idlePtr->nextPtr) {
+	    backlog++;
+	}
+	TclEventStatsIdle(backlog);
+    }
 
     oldGeneration = tsdPtr->idleGeneration;
     tsdPtr->idleGeneration++;
@@ -748,7 +877,9 @@ TclServiceIdle(void)
 	if (tsdPtr->idleList == NULL) {
 	    tsdPtr->lastIdlePtr = NULL;
 	}
+	start = TclEventStatsStart();
 	idlePtr->proc(idlePtr->clientData);
+	TclEventStatsRecord(TCL_EVSTATS_IDLE, start);
 	Tcl_Free(idlePtr);
     }
     if (tsdPtr->idleList) {
@@ -810,6 +941,7 @@ Tcl_AfterObjCmd(
 	assocPtr = (AfterAssocData *)Tcl_Alloc(sizeof(AfterAssocData));
 	assocPtr->interp = interp;
 	assocPtr->firstAfterPtr = NULL;
+	Tcl_InitHashTable(&assocPtr->afterTable, TCL_ONE_WORD_KEYS);
 	Tcl_SetAssocData(interp, "tclAfter", AfterCleanupProc, assocPtr);
     }
 
@@ -874,8 +1006,7 @@ Tcl_AfterObjCmd(
 	}
 	afterPtr->token = TclCreateAbsoluteTimerHandler(&wakeup,
 		AfterProc, afterPtr);
-	afterPtr->nextPtr = assocPtr->firstAfterPtr;
-	assocPtr->firstAfterPtr = afterPtr;
+	AfterLink(assocPtr, afterPtr);
 	Tcl_SetObjResult(interp, Tcl_ObjPrintf("after#%d", afterPtr->id));
 	return TCL_OK;
     }
@@ -893,6 +1024,7 @@ Tcl_AfterObjCmd(
 	} else {
 	    commandPtr = Tcl_ConcatObj(objc-2, objv+2);
 	}
+
 	command = TclGetStringFromObj(commandPtr, &length);
 	for (afterPtr = assocPtr->firstAfterPtr;  afterPtr != NULL;
 		afterPtr = afterPtr->nextPtr) {
@@ -935,8 +1067,7 @@ Tcl_AfterObjCmd(
 	afterPtr->id = tsdPtr->afterId;
 	tsdPtr->afterId += 1;
 	afterPtr->token = NULL;
-	afterPtr->nextPtr = assocPtr->firstAfterPtr;
-	assocPtr->firstAfterPtr = afterPtr;
+	AfterLink(assocPtr, afterPtr);
 	Tcl_DoWhenIdle(AfterProc, afterPtr);
 	Tcl_SetObjResult(interp, Tcl_ObjPrintf("after#%d", afterPtr->id));
 	break;
@@ -1106,7 +1237,7 @@ GetAfterEvent(
 {
     const char *cmdString;	/* Textual identifier for after event, such as
 				 * "after#6". */
-    AfterInfo *afterPtr;
+    Tcl_HashEntry *hPtr;
     int id;
     char *end;
 
@@ -1119,13 +1250,68 @@ GetAfterEvent(
     if ((end == cmdString) || (*end != 0)) {
 	return NULL;
     }
-    for (afterPtr = assocPtr->firstAfterPtr; afterPtr != NULL;
-	    afterPtr = afterPtr->nextPtr) {
-	if (afterPtr->id == id) {
-	    return afterPtr;
-	}
+    hPtr = Tcl_FindHashEntry(&assocPtr->afterTable, INT2PTR(id));
+    if (hPtr == NULL) {
+	return NULL;
+    }
+    return (AfterInfo *)Tcl_GetHashValue(hPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AfterLink, AfterUnlink --
+ *
+ *	Add an "after" command to, or remove it from, the list and table of
+ *	pending commands of its interpreter.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	See above.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+AfterLink(
+    AfterAssocData *assocPtr,
+    AfterInfo *afterPtr)
+{
+    Tcl_HashEntry *hPtr;
+    int isNew;
+
+    afterPtr->prevPtr = NULL;
+    afterPtr->nextPtr = assocPtr->firstAfterPtr;
+    if (afterPtr->nextPtr != NULL) {
+	afterPtr->nextPtr->prevPtr = afterPtr;
+    }
+    assocPtr->firstAfterPtr = afterPtr;
+    hPtr = Tcl_CreateHashEntry(&assocPtr->afterTable, INT2PTR(afterPtr->id),
+	    &isNew);
+    Tcl_SetHashValue(hPtr, afterPtr);
+}
+
+static void
+AfterUnlink(
+    AfterInfo *afterPtr)
+{
+    AfterAssocData *assocPtr = afterPtr->assocPtr;
+    Tcl_HashEntry *hPtr;
+
+    if (afterPtr->prevPtr == NULL) {
+	assocPtr->firstAfterPtr = afterPtr->nextPtr;
+    } else {
+	afterPtr->prevPtr->nextPtr = afterPtr->nextPtr;
+    }
+    if (afterPtr->nextPtr != NULL) {
+	afterPtr->nextPtr->prevPtr = afterPtr->prevPtr;
+    }
+    hPtr = Tcl_FindHashEntry(&assocPtr->afterTable, INT2PTR(afterPtr->id));
+    if ((hPtr != NULL) && (Tcl_GetHashValue(hPtr) == afterPtr)) {
+	Tcl_DeleteHashEntry(hPtr);
     }
-    return NULL;
 }
 
 /*
@@ -1153,7 +1339,6 @@ AfterProc(
 {
     AfterInfo *afterPtr = (AfterInfo *)clientData;
     AfterAssocData *assocPtr = afterPtr->assocPtr;
-    AfterInfo *prevPtr;
     int result;
     Tcl_Interp *interp;
 
@@ -1163,15 +1348,7 @@ AfterProc(
      * a core dump.
      */
 
-    if (assocPtr->firstAfterPtr == afterPtr) {
-	assocPtr->firstAfterPtr = afterPtr->nextPtr;
-    } else {
-	for (prevPtr = assocPtr->firstAfterPtr; prevPtr->nextPtr != afterPtr;
-		prevPtr = prevPtr->nextPtr) {
-	    /* Empty loop body. */
-	}
-	prevPtr->nextPtr = afterPtr->nextPtr;
-    }
+    AfterUnlink(afterPtr);
 
     /*
      * Execute the callback.
@@ -1179,6 +1356,7 @@ AfterProc(
 
     interp = assocPtr->interp;
     Tcl_Preserve(interp);
+    TclEventStatsScript(afterPtr->commandPtr);
     result = Tcl_EvalObjEx(interp, afterPtr->commandPtr, TCL_EVAL_GLOBAL);
     if (result != TCL_OK) {
 	Tcl_AddErrorInfo(interp, "\n    (\"after\" script)");
@@ -1216,18 +1394,7 @@ static void
 FreeAfterPtr(
     AfterInfo *afterPtr)		/* Command to be deleted. */
 {
-    AfterInfo *prevPtr;
-    AfterAssocData *assocPtr = afterPtr->assocPtr;
-
-    if (assocPtr->firstAfterPtr == afterPtr) {
-	assocPtr->firstAfterPtr = afterPtr->nextPtr;
-    } else {
-	for (prevPtr = assocPtr->firstAfterPtr; prevPtr->nextPtr != afterPtr;
-		prevPtr = prevPtr->nextPtr) {
-	    /* Empty loop body. */
-	}
-	prevPtr->nextPtr = afterPtr->nextPtr;
-    }
+    AfterUnlink(afterPtr);
     Tcl_DecrRefCount(afterPtr->commandPtr);
     Tcl_Free(afterPtr);
 }
@@ -1269,6 +1436,7 @@ AfterCleanupProc(
 	Tcl_DecrRefCount(afterPtr->commandPtr);
 	Tcl_Free(afterPtr);
     }
+    Tcl_DeleteHashTable(&assocPtr->afterTable);
     Tcl_Free(assocPtr);
 }
 
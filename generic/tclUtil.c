@@ -3281,7 +3281,8 @@ TclNeedSpace(
  *	to ensure that enough storage is available. This procedure has the
  *	effect of sprintf(buffer, "%ld", n) but is faster as proven in
  *	benchmarks.  This is key to UpdateStringOfInt, which is a common path
- *	for a lot of code (e.g. int-indexed arrays).
+ *	for a lot of code (e.g. int-indexed arrays). The digits are produced
+ *	two at a time, halving the number of divisions.
  *
  * Results:
  *	An integer representing the number of characters formatted, not
@@ -3301,37 +3302,45 @@ TclFormatInt(
     Tcl_WideInt n)			/* The integer to format. */
 {
     Tcl_WideUInt intVal;
-    int i = 0, numFormatted, j;
-    static const char digits[] = "0123456789";
+    char digits[TCL_INTEGER_SPACE], *p = digits + sizeof(digits);
+    Tcl_Size numFormatted;
+    unsigned pair;
+    static const char digitPairs[] =
+	    "00010203040506070809101112131415161718192021222324"
+	    "25262728293031323334353637383940414243444546474849"
+	    "50515253545556575859606162636465666768697071727374"
+	    "75767778798081828384858687888990919293949596979899";
 
     /*
-     * Generate the characters of the result backwards in the buffer.
+     * Generate the characters of the result backwards in a local buffer,
+     * then copy them out.
      */
 
     intVal = (n < 0 ? -(Tcl_WideUInt)n : (Tcl_WideUInt)n);
-    do {
-	buffer[i++] = digits[intVal % 10];
-	intVal = intVal / 10;
-    } while (intVal > 0);
-    if (n < 0) {
-	buffer[i++] = '-';
+    while (intVal >= 100) {
+	pair = (unsigned) (intVal % 100) * 2;
+	intVal /= 100;
+	p -= 2;
+	p[0] = digitPairs[pair];
+	p[1] = digitPairs[pair + 1];
     }
-    buffer[i] = '\0';
-    numFormatted = i--;
-
-    /*
-     * Now reverse the characters.
-     */
-
-    for (j = 0;  j < i;  j++, i--) {
-	char tmp = buffer[i];
-
-	buffer[i] = buffer[j];
-	buffer[j] = tmp;
+    if (intVal >= 10) {
+	pair = (unsigned) intVal * 2;
+	p -= 2;
+	p[0] = digitPairs[pair];
+	p[1] = digitPairs[pair + 1];
+    } else {
+	*--p = (char) ('0' + intVal);
+    }
+    if (n < 0) {
+	*--p = '-';
     }
+    numFormatted = digits + sizeof(digits) - p;
+    memcpy(buffer, p, numFormatted);
+    buffer[numFormatted] = '\0';
     return numFormatted;
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
@@ -42,6 +42,8 @@ static inline Var *	VarHashCreateVar(TclVarHashTable *tablePtr,
 static inline Var *	VarHashFirstVar(TclVarHashTable *tablePtr,
 			    Tcl_HashSearch *searchPtr);
 static inline Var *	VarHashNextVar(Tcl_HashSearch *searchPtr);
+static inline Var *	VarHashResumeVar(TclVarHashTable *tablePtr,
+			    Tcl_HashSearch *searchPtr, Tcl_Size *indexPtr);
 static inline void	CleanupVar(Var *varPtr, Var *arrayPtr);
 
 #define VarHashGetValue(hPtr) \
@@ -108,6 +110,37 @@ VarHashNextVar(
     return VarHashGetValue(hPtr);
 }
 
+/*
+ * VarHashResumeVar is VarHashFirstVar for loops that delete the variable
+ * they find before looking for the next one. Instead of scanning from the
+ * first bucket every time, which is quadratic in the size of the table, it
+ * resumes at the bucket of the previous find (*indexPtr). Only when nothing
+ * is left from there on is the whole table scanned again, so variables that
+ * traces create in earlier buckets are still found.
+ */
+
+static inline Var *
+VarHashResumeVar(
+    TclVarHashTable *tablePtr,
+    Tcl_HashSearch *searchPtr,
+    Tcl_Size *indexPtr)
+{
+    Tcl_HashEntry *hPtr;
+
+    searchPtr->tablePtr = &tablePtr->table;
+    searchPtr->nextIndex = *indexPtr;
+    searchPtr->nextEntryPtr = NULL;
+    hPtr = Tcl_NextHashEntry(searchPtr);
+    if (!hPtr && *indexPtr > 0) {
+	hPtr = VarHashFirstEntry(tablePtr, searchPtr);
+    }
+    if (!hPtr) {
+	return NULL;
+    }
+    *indexPtr = searchPtr->nextIndex - 1;
+    return VarHashGetValue(hPtr);
+}
+
 #define VarHashDeleteTable(tablePtr) \
     Tcl_DeleteHashTable(&(tablePtr)->table)
 
@@ -5382,6 +5415,7 @@ TclDeleteNamespaceVars(
     Tcl_Interp *interp = nsPtr->interp;
     Interp *iPtr = (Interp *)interp;
     Tcl_HashSearch search;
+    Tcl_Size index = 0;
     int flags = 0;
     Var *varPtr;
 
@@ -5395,8 +5429,9 @@ TclDeleteNamespaceVars(
 	flags = TCL_NAMESPACE_ONLY;
     }
 
-    for (varPtr = VarHashFirstVar(tablePtr, &search);  varPtr != NULL;
-	    varPtr = VarHashFirstVar(tablePtr, &search)) {
+    for (varPtr = VarHashResumeVar(tablePtr, &search, &index);
+	    varPtr != NULL;
+	    varPtr = VarHashResumeVar(tablePtr, &search, &index)) {
 	Tcl_Obj *objPtr;
 	TclNewObj(objPtr);
 	VarHashRefCount(varPtr)++;	/* Make sure we get to remove from
@@ -5480,6 +5515,7 @@ TclDeleteVars(
 {
     Tcl_Interp *interp = (Tcl_Interp *) iPtr;
     Tcl_HashSearch search;
+    Tcl_Size index = 0;
     Var *varPtr;
     int flags;
     Namespace *currNsPtr = (Namespace *) TclGetCurrentNamespace(interp);
@@ -5495,8 +5531,9 @@ TclDeleteVars(
 	flags |= TCL_NAMESPACE_ONLY;
     }
 
-    for (varPtr = VarHashFirstVar(tablePtr, &search); varPtr != NULL;
-	    varPtr = VarHashFirstVar(tablePtr, &search)) {
+    for (varPtr = VarHashResumeVar(tablePtr, &search, &index);
+	    varPtr != NULL;
+	    varPtr = VarHashResumeVar(tablePtr, &search, &index)) {
 	UnsetVarStruct(varPtr, NULL, iPtr, VarHashGetKey(varPtr), NULL, flags,
 		-1);
 	VarHashDeleteEntry(varPtr);
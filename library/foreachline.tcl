@@ -13,8 +13,18 @@ proc foreachLine {varName filename body} {
     upvar 1 $varName line
     set f [open $filename "r"]
     try {
-	while {[gets $f line] >= 0} {
-	    uplevel 1 $body
+	# Lines are fetched in batches, as that is much cheaper than a [gets]
+	# per line; a [break] in the body must still end the outer loop.
+	set done 0
+	while {!$done && [llength [set lines [chan readlines $f 256]]]} {
+	    foreach line $lines {
+		try {
+		    uplevel 1 $body
+		} on break {} {
+		    set done 1
+		    break
+		}
+	    }
 	}
     } on return {msg opt} {
 	dict incr opt -level
@@ -75,8 +75,70 @@ proc test-read-regress {{reptime {50000 10}}} {
   }
 }
 
+proc _get_test_lines_chan {{bufSize 4096}} {
+  lassign [chan pipe] ch wch;
+  fconfigure $ch -translation auto -encoding utf-8 -buffersize $bufSize -buffering full
+  fconfigure $wch -translation binary -encoding utf-8 -buffersize $bufSize -buffering full
+
+  exec [info nameofexecutable] -- $bufSize >@$wch << {
+    set bufSize [lindex $::argv end]
+    fconfigure stdout -translation binary -encoding utf-8 -buffersize $bufSize -buffering full
+    # write 1M short lines (~ 40MB):
+    set i 0; while {$i < 1000000} {
+      puts stdout "line $i\tsome short payload of a log record"
+      incr i
+    }
+  } &
+  close $wch
+  return $ch
+}
+
+# line-oriented reading, [gets] per line vs. [chan readlines] in batches:
+proc test-read-lines {{reptime {50000 1}}} {
+  _test_run -no-result $reptime {
+    setup   { set ch [::tclTestPerf-Chan::_get_test_lines_chan]; fconfigure $ch -buffersize }
+    # 1M lines with gets:
+    {set n 0; while {[gets $ch line] >= 0} {incr n}; set n}
+    cleanup { close $ch }
+
+    setup   { set ch [::tclTestPerf-Chan::_get_test_lines_chan]; fconfigure $ch -buffersize }
+    # 1M lines with chan readlines (batches of 1000 lines):
+    {set n 0; while {[llength [set lines [chan readlines $ch 1000]]]} {incr n [llength $lines]}; set n}
+    cleanup { close $ch }
+
+    setup   { set ch [::tclTestPerf-Chan::_get_test_lines_chan]; fconfigure $ch -buffersize }
+    # 1M lines with chan readlines (all at once):
+    {llength [chan readlines $ch]}
+    cleanup { close $ch }
+  }
+}
+
+# text-mode throughput for ASCII payloads in the common encodings:
+proc test-ascii-text {{reptime {50000 5}}} {
+  set ::data [string repeat "GET /index.html HTTP/1.1\tHost: example.com\n" 50000]
+  _test_run -no-result $reptime {
+    setup   { set ch [file tempfile]; fconfigure $ch -encoding utf-8 }
+    # write 2MB ASCII as utf-8:
+    {seek $ch 0; puts -nonewline $ch $::data; flush $ch}
+    # read 2MB ASCII as utf-8:
+    {seek $ch 0; string length [read $ch]}
+    # gets 2MB ASCII as utf-8:
+    {seek $ch 0; set n 0; while {[gets $ch line] >= 0} {incr n}; set n}
+    cleanup { close $ch }
+
+    setup   { set ch [file tempfile]; fconfigure $ch -encoding iso8859-1 }
+    # write 2MB ASCII as iso8859-1:
+    {seek $ch 0; puts -nonewline $ch $::data; flush $ch}
+    # read 2MB ASCII as iso8859-1:
+    {seek $ch 0; string length [read $ch]}
+    cleanup { close $ch; unset ::data }
+  }
+}
+
 proc test {{reptime 1000}} {
   test-read-regress
+  test-read-lines
+  test-ascii-text
 
   puts \n**OK**
 }
@@ -0,0 +1,78 @@
+#!/usr/bin/tclsh
+
+# ------------------------------------------------------------------------
+#
+# string.perf.tcl --
+#
+#  This file provides performance tests for comparison of tcl-speed
+#  of string facilities.
+#
+# ------------------------------------------------------------------------
+#
+# See the file "license.terms" for information on usage and redistribution
+# of this file.
+#
+
+
+if {![namespace exists ::tclTestPerf]} {
+  source [file join [file dirname [info script]] test-performance.tcl]
+}
+
+
+namespace eval ::tclTestPerf-String {
+
+namespace path {::tclTestPerf}
+
+proc test-first-last {{reptime 1000}} {
+  _test_run -no-result $reptime {
+    # 200KB strings, ASCII and with some multibyte chars, needle at the end:
+    setup   { set a [string repeat "lorem ipsum dolor sit amet " 8000]; set u [string map {o ö} $a]; append a needle; append u needle; string length $u }
+
+    { string first needle $a }
+    { string first needle $u }
+    { string first needle [string range $a 1 end] }
+    { string first needle [string range $u 1 end] }
+    { string first needle $a 100000 }
+    { string last lorem $a }
+    { string last lorem $u }
+    { string last lorem $a 100000 }
+    { string first nope $a }
+    { string last nope $a }
+  }
+}
+
+proc test-map {{reptime 1000}} {
+  _test_run -no-result $reptime {
+    # 200KB strings, escaping maps of different sizes:
+    setup   { set s [string repeat {<a href="x?a=1&b=2">it's "quoted"</a>, } 5000]; string length $s }
+    setup   { set html {& &amp; < &lt; > &gt; \" &quot; ' &#39;} }
+    setup   { set sql {' '' \\ \\\\ \0 \\0} }
+    setup   { set csv {\" \"\" , \\, \n \\n \r \\r} }
+    setup   { set big {}; for {set i 0} {$i < 200} {incr i} { lappend big key$i val$i }; lappend big href HREF }
+
+    { string map $html $s }
+    { string map $sql $s }
+    { string map $csv $s }
+    { string map $big $s }
+    { string map -nocase {A X HREF Y} $s }
+    { string map {"" x} $s }
+  }
+}
+
+proc test {{reptime 1000}} {
+  test-first-last $reptime
+  test-map $reptime
+
+  puts \n**OK**
+}
+
+}; # end of ::tclTestPerf-String
+
+# ------------------------------------------------------------------------
+
+# if calling direct:
+if {[info exists ::argv0] && [file tail $::argv0] eq [file tail [info script]]} {
+  array set in {-time 500}
+  array set in $argv
+  ::tclTestPerf-String::test $in(-time)
+}
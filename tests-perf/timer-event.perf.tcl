@@ -101,6 +101,10 @@ proc test-access {{reptime {1000 5000}}} {
     setup {set i -1; timerate {set ev([incr i]) [after 0 {}]} {*}$reptime}
     {after info $ev([expr {int(rand()*$i)}])}
     cleanup {update; unset -nocomplain ev}
+    # event random access: after with scattered delays + after cancel (by $howmuch events)
+    setup {set i -1; timerate {set ev([incr i]) [after [expr {int(rand()*1000000)}] {}]} {*}$reptime}
+    {after cancel $ev([expr {int(rand()*$i)}])}
+    cleanup {foreach i [after info] {after cancel $i}; unset -nocomplain ev}
 
     # end $howmuch events.
     cleanup {if [llength [after info]] {error "unexpected: [llength [after info]] events are still there."}}
@@ -43,7 +43,6 @@ typedef struct FileHandler {
     Tcl_FileProc *proc;		/* Function to call, in the style of
 				 * Tcl_CreateFileHandler. */
     void *clientData;	/* Argument to pass to proc. */
-    struct FileHandler *nextPtr;/* Next in list of all files we care about. */
     LIST_ENTRY(FileHandler) readyNode;
 				/* Next/previous in list of FileHandlers asso-
 				 * ciated with regular files (S_IFREG) that are
@@ -80,6 +79,16 @@ typedef struct {
 				 * the event is queued). */
 } FileHandlerEvent;
 
+/*
+ * Bounds on the number of epoll_events fetched by a single epoll_wait(2).
+ * The array starts at READY_EVENTS_INITIAL and is doubled each time a wait
+ * fills it, so a thread watching many busy fds collects them all in as few
+ * system calls as possible.
+ */
+
+#define READY_EVENTS_INITIAL	512
+#define READY_EVENTS_MAX	65536
+
 /*
  * The following static structure contains the state information for the
  * epoll based implementation of the Tcl notifier. One of these structures is
@@ -89,8 +98,11 @@ typedef struct {
 LIST_HEAD(PlatformReadyFileHandlerList, FileHandler);
 typedef struct ThreadSpecificData {
     FileHandler *triggerFilePtr;
-    FileHandler *firstFileHandlerPtr;
-				/* Pointer to head of file handler list. */
+    Tcl_HashTable fileHandlerTable;
+				/* Maps fds to the FileHandlers of all files
+				 * we care about. Lets queued file events
+				 * find their handler without walking a
+				 * list. */
     struct PlatformReadyFileHandlerList firstReadyFileHandlerPtr;
 				/* Pointer to head of list of FileHandlers
 				 * associated with regular files (S_IFREG)
@@ -267,6 +279,7 @@ PlatformEventsControl(
  *	- The per-thread eventfd(2) is closed, if non-zero, and set to -1.
  *	- The per-thread epoll(7) fd is closed, if non-zero, and set to 0.
  *	- The per-thread epoll_event structs are freed, if any, and set to 0.
+ *	- The per-thread table mapping fds to FileHandlers is deleted.
  *
  *	tsdPtr->notifierMutex is destroyed.
  *
@@ -303,8 +316,10 @@ TclpFinalizeNotifier(
     }
     if (tsdPtr->readyEvents) {
 	Tcl_Free(tsdPtr->readyEvents);
+	tsdPtr->readyEvents = NULL;
 	tsdPtr->maxReadyEvents = 0;
     }
+    Tcl_DeleteHashTable(&tsdPtr->fileHandlerTable);
     pthread_mutex_unlock(&tsdPtr->notifierMutex);
     if ((errno = pthread_mutex_destroy(&tsdPtr->notifierMutex))) {
 	Tcl_Panic("pthread_mutex_destroy: %s", strerror(errno));
@@ -331,8 +346,9 @@ TclpFinalizeNotifier(
  *	- A FileHandler struct is allocated and initialised for the
  *	  eventfd(2), registering interest for TCL_READABLE on it via
  *	  PlatformEventsControl().
- *	- readyEvents and maxReadyEvents are initialised with 512
- *	  epoll_events.
+ *	- readyEvents and maxReadyEvents are initialised with
+ *	  READY_EVENTS_INITIAL epoll_events.
+ *	- The table mapping fds to FileHandlers is initialised.
  *
  *----------------------------------------------------------------------
  */
@@ -367,11 +383,12 @@ PlatformEventsInit(void)
     filePtr->mask = TCL_READABLE;
     PlatformEventsControl(filePtr, tsdPtr, EPOLL_CTL_ADD, 1);
     if (!tsdPtr->readyEvents) {
-        tsdPtr->maxReadyEvents = 512;
+	tsdPtr->maxReadyEvents = READY_EVENTS_INITIAL;
 	tsdPtr->readyEvents = (struct epoll_event *) Tcl_Alloc(
 		tsdPtr->maxReadyEvents * sizeof(tsdPtr->readyEvents[0]));
     }
     LIST_INIT(&tsdPtr->firstReadyFileHandlerPtr);
+    Tcl_InitHashTable(&tsdPtr->fileHandlerTable, TCL_ONE_WORD_KEYS);
 }
 
 /*
@@ -516,15 +533,18 @@ TclpCreateFileHandler(
     void *clientData)	/* Arbitrary data to pass to proc. */
 {
     ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
-    FileHandler *filePtr = LookUpFileHandler(tsdPtr, fd, NULL);
-    int isNew = (filePtr == NULL);
+    FileHandler *filePtr;
+    int isNew;
+    Tcl_HashEntry *hPtr = Tcl_CreateHashEntry(&tsdPtr->fileHandlerTable,
+	    INT2PTR(fd), &isNew);
 
     if (isNew) {
 	filePtr = (FileHandler *) Tcl_Alloc(sizeof(FileHandler));
 	filePtr->fd = fd;
 	filePtr->readyMask = 0;
-	filePtr->nextPtr = tsdPtr->firstFileHandlerPtr;
-	tsdPtr->firstFileHandlerPtr = filePtr;
+	Tcl_SetHashValue(hPtr, filePtr);
+    } else {
+	filePtr = (FileHandler *) Tcl_GetHashValue(hPtr);
     }
     filePtr->proc = proc;
     filePtr->clientData = clientData;
@@ -559,17 +579,19 @@ TclpDeleteFileHandler(
     int fd)			/* Stream id for which to remove callback
 				 * function. */
 {
-    FileHandler *filePtr, *prevPtr;
+    FileHandler *filePtr;
+    Tcl_HashEntry *hPtr;
     ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
 
     /*
      * Find the entry for the given file (and return if there isn't one).
      */
 
-    filePtr = LookUpFileHandler(tsdPtr, fd, &prevPtr);
-    if (filePtr == NULL) {
+    hPtr = Tcl_FindHashEntry(&tsdPtr->fileHandlerTable, INT2PTR(fd));
+    if (hPtr == NULL) {
 	return;
     }
+    filePtr = (FileHandler *) Tcl_GetHashValue(hPtr);
 
     /*
      * Update the check masks for this file.
@@ -584,11 +606,7 @@ TclpDeleteFileHandler(
      * Clean up information in the callback record.
      */
 
-    if (prevPtr == NULL) {
-	tsdPtr->firstFileHandlerPtr = filePtr->nextPtr;
-    } else {
-	prevPtr->nextPtr = filePtr->nextPtr;
-    }
+    Tcl_DeleteHashEntry(hPtr);
     Tcl_Free(filePtr);
 }
 
@@ -608,7 +626,8 @@ TclpDeleteFileHandler(
  *	returns 0.
  *
  * Side effects:
- *	Queues file events that are detected by PlatformEventsWait().
+ *	Queues file events that are detected by PlatformEventsWait(). Grows
+ *	readyEvents when a single wait fills it.
  *
  *----------------------------------------------------------------------
  */
@@ -767,6 +786,19 @@ TclpWaitForEvent(
 	}
 	filePtr->readyMask = mask;
     }
+
+    /*
+     * A full array means that more fds may have been ready than could be
+     * returned. Grow it so that the next wait can collect them all at once.
+     */
+
+    if (numFound == (int) tsdPtr->maxReadyEvents
+	    && tsdPtr->maxReadyEvents < READY_EVENTS_MAX) {
+	tsdPtr->maxReadyEvents *= 2;
+	tsdPtr->readyEvents = (struct epoll_event *) Tcl_Realloc(
+		tsdPtr->readyEvents,
+		tsdPtr->maxReadyEvents * sizeof(tsdPtr->readyEvents[0]));
+    }
     return 0;
 }
 
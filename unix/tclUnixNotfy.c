@@ -148,7 +148,9 @@ TclpAlertNotifier(
  * LookUpFileHandler --
  *
  *	Look up the file handler structure (and optionally the previous one in
- *	the chain) associated with a file descriptor.
+ *	the chain) associated with a file descriptor. The epoll notifier keeps
+ *	its file handlers in a hash table keyed by fd rather than in a chain,
+ *	so there the previous one is always reported as NULL.
  *
  * Returns:
  *	A pointer to the file handler, or NULL if it can't be found.
@@ -167,6 +169,18 @@ LookUpFileHandler(
     FileHandler **prevPtrPtr)	/* If non-NULL, where to report the previous
 				 * pointer. */
 {
+#ifdef NOTIFIER_EPOLL
+    Tcl_HashEntry *hPtr = Tcl_FindHashEntry(&tsdPtr->fileHandlerTable,
+	    INT2PTR(fd));
+
+    if (hPtr == NULL) {
+	return NULL;
+    }
+    if (prevPtrPtr) {
+	*prevPtrPtr = NULL;
+    }
+    return (FileHandler *) Tcl_GetHashValue(hPtr);
+#else /* !NOTIFIER_EPOLL */
     FileHandler *filePtr, *prevPtr;
 
     /*
@@ -191,6 +205,7 @@ LookUpFileHandler(
 	*prevPtrPtr = prevPtr;
     }
     return filePtr;
+#endif /* NOTIFIER_EPOLL */
 }
 
 /*
@@ -290,20 +305,15 @@ FileHandlerEventProc(
     }
 
     /*
-     * Search through the file handlers to find the one whose handle matches
-     * the event. We do this rather than keeping a pointer to the file handler
-     * directly in the event, so that the handler can be deleted while the
-     * event is queued without leaving a dangling pointer.
+     * Look up the file handler whose handle matches the event. We do this
+     * rather than keeping a pointer to the file handler directly in the
+     * event, so that the handler can be deleted while the event is queued
+     * without leaving a dangling pointer.
      */
 
     tsdPtr = TCL_TSD_INIT(&dataKey);
-
-    for (filePtr = tsdPtr->firstFileHandlerPtr; filePtr != NULL;
-	    filePtr = filePtr->nextPtr) {
-	if (filePtr->fd != fileEvPtr->fd) {
-	    continue;
-	}
-
+    filePtr = LookUpFileHandler(tsdPtr, fileEvPtr->fd, NULL);
+    if (filePtr != NULL) {
 	/*
 	 * The code is tricky for two reasons:
 	 * 1. The file handler's desired events could have changed since the
@@ -321,7 +331,6 @@ FileHandlerEventProc(
 	if (mask != 0) {
 	    filePtr->proc(filePtr->clientData, mask);
 	}
-	break;
     }
     return 1;
 }
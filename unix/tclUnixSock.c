@@ -1728,6 +1728,15 @@ Tcl_OpenTcpServerEx(
 
 	fcntl(sock, F_SETFD, FD_CLOEXEC);
 
+	/*
+	 * Make the listening socket non-blocking. A connection that is reset
+	 * after the socket was reported readable, or that is taken by another
+	 * process sharing the socket, must not leave TcpAccept blocked in
+	 * accept() and with it the whole event loop of this thread.
+	 */
+
+	(void) TclUnixSetBlockingMode(sock, TCL_MODE_NONBLOCKING);
+
 	/*
 	 * Set kernel space buffering
 	 */
@@ -1924,6 +1933,13 @@ TcpAccept(
 
     (void) fcntl(newsock, F_SETFD, FD_CLOEXEC);
 
+    /*
+     * Some platforms pass the non-blocking mode of the listening socket on
+     * to accepted ones, but client channels always start out blocking.
+     */
+
+    (void) TclUnixSetBlockingMode(newsock, TCL_MODE_BLOCKING);
+
     newSockState = (TcpState *)Tcl_Alloc(sizeof(TcpState));
     memset(newSockState, 0, sizeof(TcpState));
     newSockState->flags = 0;